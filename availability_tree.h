@@ -0,0 +1,145 @@
+#ifndef AVAILABILITY_TREE_H
+#define AVAILABILITY_TREE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
+
+// Max tree over per-train availability, for "first train from k with at least n seats" and
+// "the k trains with the most seats" without scanning every train.
+//
+// The tree summarizes an external array of state words (signed seats in the high 32 bits, like
+// train_state). Its bottom nodes each cover BLOCK consecutive trains, one cache line of words,
+// so the tree holds about 2 * trains / BLOCK nodes and is log2(trains / BLOCK) levels deep.
+// Node i has children 2i and 2i + 1; bottom node b is node `bottom + b`.
+//
+// Every node is a 64-bit word: the maximum seats below it in the high 32 bits and a version in
+// the low 32 that every store bumps, so a refresh commits with one CAS and cannot be fooled by
+// a value changing away and back (ABA). After a word changes, update() refreshes the nodes on
+// its path to the root. Each refresh loads the node, recomputes it from its children and CASes
+// it, and is attempted twice (Jayanti's f-array): if both CASes fail, another thread's refresh
+// succeeded after the first failure and so read children that already include this change.
+// Updates are therefore wait-free, lock-free on concurrent bookings and never lost, at the cost
+// of one or two CASes per level, the root's on every update.
+//
+// Queries run concurrently with updates and see the availability of some recent moment: a
+// node may briefly claim more seats than its trains have, so candidates are checked against
+// the words themselves and the search resumes past a stale block.
+class AvailabilityTree {
+public:
+    static constexpr std::size_t BLOCK = 8;
+
+    // Builds the tree over words[0, count). Not concurrent with update() or queries.
+    void build(const std::atomic<std::uint64_t>* state_words, std::size_t count) {
+        words = state_words;
+        num_words = count;
+        std::size_t blocks = std::max<std::size_t>(1, (count + BLOCK - 1) / BLOCK);
+        bottom = 1;
+        while (bottom < blocks) bottom <<= 1;
+        nodes.reset(new std::atomic<std::uint64_t>[2 * bottom]);
+        nodes[0].store(pack(EMPTY, 0), std::memory_order_relaxed); // Unused
+        for (std::size_t node = 2 * bottom - 1; node >= 1; node--) {
+            int seats = node >= bottom ? block_max(node - bottom) : std::max(seats_of(node * 2), seats_of(node * 2 + 1));
+            nodes[node].store(pack(seats, 0), std::memory_order_relaxed);
+        }
+    }
+
+    // Call after words[index] changed.
+    void update(std::size_t index) {
+        for (std::size_t node = bottom + index / BLOCK; node >= 1; node >>= 1) {
+            if (!refresh(node)) refresh(node);
+        }
+    }
+
+    int max_seats() const { return seats_of(1); }
+
+    // The first index >= from whose word has at least `seats` seats, or -1.
+    long next_with_space(std::size_t from, int seats) const {
+        while (from < num_words) {
+            std::size_t block = from / BLOCK;
+            std::size_t end = std::min(num_words, (block + 1) * BLOCK);
+            for (std::size_t i = from; i < end; i++) {
+                if (word_seats(i) >= seats) return static_cast<long>(i);
+            }
+            // Climb until a right sibling has room, then descend along the leftmost such path
+            std::size_t node = bottom + block;
+            while (true) {
+                if (node == 1) return -1;
+                if ((node & 1) == 0 && seats_of(node + 1) >= seats) break;
+                node >>= 1;
+            }
+            node++;
+            while (node < bottom) node = seats_of(node * 2) >= seats ? node * 2 : node * 2 + 1;
+            from = (node - bottom) * BLOCK; // A stale block simply fails the scan above
+        }
+        return -1;
+    }
+
+    // The (up to) k indexes with the most seats, most first, as (seats, index) pairs. Best-first
+    // walk: a node is opened only while it can still beat what has been found.
+    void top_k(std::size_t k, std::vector<std::pair<int, std::uint32_t>>& out) const {
+        out.clear();
+        // (seats, id): ids below 2 * bottom are nodes, the rest are words (id - 2 * bottom)
+        typedef std::pair<int, std::size_t> Entry;
+        std::priority_queue<Entry> frontier;
+        frontier.push(Entry(seats_of(1), 1));
+        while (!frontier.empty() && out.size() < k) {
+            Entry top = frontier.top();
+            frontier.pop();
+            std::size_t id = top.second;
+            if (top.first == EMPTY) break;
+            if (id >= 2 * bottom) {
+                out.push_back(std::make_pair(top.first, static_cast<std::uint32_t>(id - 2 * bottom)));
+            } else if (id >= bottom) {
+                std::size_t first = (id - bottom) * BLOCK;
+                for (std::size_t i = first; i < std::min(num_words, first + BLOCK); i++) {
+                    frontier.push(Entry(word_seats(i), 2 * bottom + i));
+                }
+            } else {
+                frontier.push(Entry(seats_of(id * 2), id * 2));
+                frontier.push(Entry(seats_of(id * 2 + 1), id * 2 + 1));
+            }
+        }
+    }
+
+    std::size_t bytes() const { return 2 * bottom * sizeof(std::uint64_t); }
+
+private:
+    static constexpr int EMPTY = INT32_MIN; // Max of a block past the last word
+
+    static std::uint64_t pack(int seats, std::uint32_t version) {
+        return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(seats)) << 32) | version;
+    }
+    static int unpack_seats(std::uint64_t word) { return static_cast<std::int32_t>(word >> 32); }
+
+    int word_seats(std::size_t index) const { return unpack_seats(words[index].load(std::memory_order_acquire)); }
+    int seats_of(std::size_t node) const { return unpack_seats(nodes[node].load(std::memory_order_acquire)); }
+
+    int block_max(std::size_t block) const {
+        int best = EMPTY;
+        for (std::size_t i = block * BLOCK; i < std::min(num_words, (block + 1) * BLOCK); i++) {
+            best = std::max(best, word_seats(i));
+        }
+        return best;
+    }
+
+    // Recomputes one node from what lies below it; false if another refresh got there first.
+    bool refresh(std::size_t node) {
+        std::uint64_t old = nodes[node].load(std::memory_order_acquire);
+        int seats = node >= bottom ? block_max(node - bottom) : std::max(seats_of(node * 2), seats_of(node * 2 + 1));
+        return nodes[node].compare_exchange_strong(old, pack(seats, static_cast<std::uint32_t>(old) + 1),
+                                                   std::memory_order_acq_rel, std::memory_order_acquire);
+    }
+
+    const std::atomic<std::uint64_t>* words = nullptr;
+    std::size_t num_words = 0;
+    std::size_t bottom = 1; // Bottom nodes, a power of two
+    std::unique_ptr<std::atomic<std::uint64_t>[]> nodes;
+};
+
+#endif // AVAILABILITY_TREE_H
@@ -0,0 +1,241 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CRC32C_X86 1
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+// CRC-32C (Castagnoli, reflected polynomial 0x82F63B78), the checksum used by every persisted
+// format in this project.
+//
+// crc32c(data, size) checksums one buffer; crc32c_extend(crc, data, size) continues a running
+// checksum, so crc32c_extend(crc32c(a), b) == crc32c(a followed by b).
+//
+// Three implementations, picked once at run time from CPUID:
+//   CRC32C_SSE42_PCLMUL  SSE4.2 crc32 on three independent streams, so the instruction's 3-cycle
+//                        latency is hidden, with the three partial CRCs folded together by a
+//                        carry-less multiply (PCLMULQDQ) per stream boundary.
+//   CRC32C_SSE42         SSE4.2 crc32, one 8-byte word after the other.
+//   CRC32C_TABLE         Portable slice-by-8 tables.
+// The x86 paths are compiled through function target attributes, so no -msse4.2 is needed and
+// the binary still runs on CPUs without them.
+
+enum Crc32cImplementation {
+    CRC32C_TABLE,
+    CRC32C_SSE42,
+    CRC32C_SSE42_PCLMUL
+};
+
+namespace crc32c_detail {
+
+const std::uint32_t POLY = 0x82F63B78u;
+
+struct Tables {
+    std::uint32_t t[8][256];
+
+    Tables() {
+        for (std::uint32_t i = 0; i < 256; i++) {
+            std::uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (POLY & (0u - (crc & 1u)));
+            t[0][i] = crc;
+        }
+        for (std::uint32_t i = 0; i < 256; i++) {
+            for (int k = 1; k < 8; k++) t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+        }
+    }
+};
+
+inline const Tables& tables() {
+    static const Tables instance;
+    return instance;
+}
+
+// The extend_* functions work on the raw CRC register (no pre/post inversion).
+inline std::uint32_t extend_table(std::uint32_t crc, const unsigned char* p, std::size_t size) {
+    const Tables& tab = tables();
+
+    // Bytes until 8-byte alignment, then 8 bytes per step, then the tail
+    while (size > 0 && (reinterpret_cast<std::uintptr_t>(p) & 7) != 0) {
+        crc = (crc >> 8) ^ tab.t[0][(crc ^ *p++) & 0xFF];
+        size--;
+    }
+    while (size >= 8) {
+        std::uint32_t low = crc ^ (std::uint32_t(p[0]) | std::uint32_t(p[1]) << 8 |
+                                   std::uint32_t(p[2]) << 16 | std::uint32_t(p[3]) << 24);
+        crc = tab.t[7][low & 0xFF] ^ tab.t[6][(low >> 8) & 0xFF] ^
+              tab.t[5][(low >> 16) & 0xFF] ^ tab.t[4][low >> 24] ^
+              tab.t[3][p[4]] ^ tab.t[2][p[5]] ^ tab.t[1][p[6]] ^ tab.t[0][p[7]];
+        p += 8;
+        size -= 8;
+    }
+    while (size > 0) {
+        crc = (crc >> 8) ^ tab.t[0][(crc ^ *p++) & 0xFF];
+        size--;
+    }
+    return crc;
+}
+
+#ifdef CRC32C_X86
+
+// Stream lengths for the three-way split: long streams amortize the fold, short ones catch
+// medium-sized buffers. Multiples of 8.
+const std::size_t LONG_STREAM = 2048;
+const std::size_t SHORT_STREAM = 256;
+
+// x^e mod P in the reflected representation (bit 31 is x^0).
+inline std::uint32_t x_pow_mod(std::uint64_t e) {
+    std::uint32_t r = 0x80000000u;
+    while (e-- > 0) r = (r >> 1) ^ (POLY & (0u - (r & 1u)));
+    return r;
+}
+
+// Multipliers that advance a CRC register over 1 or 2 streams of zeros. A 32x32 carry-less
+// product of the register and x^(8n-33) is a 63-bit polynomial that crc32 of the product
+// (which multiplies by x^32 and reduces) turns into register * x^(8n) mod P.
+struct FoldConstants {
+    std::uint32_t long1, long2, short1, short2;
+
+    FoldConstants()
+        : long1(x_pow_mod(8 * LONG_STREAM - 33)), long2(x_pow_mod(8 * 2 * LONG_STREAM - 33)),
+          short1(x_pow_mod(8 * SHORT_STREAM - 33)), short2(x_pow_mod(8 * 2 * SHORT_STREAM - 33)) {}
+};
+
+inline const FoldConstants& fold_constants() {
+    static const FoldConstants instance;
+    return instance;
+}
+
+inline std::uint64_t load64(const unsigned char* p) {
+    std::uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+__attribute__((target("sse4.2")))
+inline std::uint32_t extend_sse42(std::uint32_t crc, const unsigned char* p, std::size_t size) {
+    while (size > 0 && (reinterpret_cast<std::uintptr_t>(p) & 7) != 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+        size--;
+    }
+    std::uint64_t crc64 = crc;
+    while (size >= 8) {
+        crc64 = _mm_crc32_u64(crc64, load64(p));
+        p += 8;
+        size -= 8;
+    }
+    crc = static_cast<std::uint32_t>(crc64);
+    while (size > 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+        size--;
+    }
+    return crc;
+}
+
+__attribute__((target("sse4.2,pclmul")))
+inline std::uint64_t shift_register(std::uint64_t crc, std::uint32_t multiplier) {
+    __m128i product = _mm_clmulepi64_si128(_mm_cvtsi64_si128(static_cast<long long>(crc)),
+                                           _mm_cvtsi32_si128(static_cast<int>(multiplier)), 0x00);
+    return _mm_crc32_u64(0, static_cast<std::uint64_t>(_mm_cvtsi128_si64(product)));
+}
+
+__attribute__((target("sse4.2,pclmul")))
+inline std::uint32_t extend_sse42_pclmul(std::uint32_t crc, const unsigned char* p, std::size_t size) {
+    const FoldConstants& k = fold_constants();
+    while (size > 0 && (reinterpret_cast<std::uintptr_t>(p) & 7) != 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+        size--;
+    }
+    std::uint64_t crc0 = crc;
+    const std::size_t streams[2] = {LONG_STREAM, SHORT_STREAM};
+    const std::uint32_t one_stream[2] = {k.long1, k.short1};
+    const std::uint32_t two_streams[2] = {k.long2, k.short2};
+    for (int s = 0; s < 2; s++) {
+        std::size_t stream = streams[s];
+        while (size >= 3 * stream) {
+            // crc(A B C) = crc0(A) * x^(2 streams) ^ crc1(B) * x^(1 stream) ^ crc2(C)
+            std::uint64_t crc1 = 0, crc2 = 0;
+            for (const unsigned char* end = p + stream; p < end; p += 8) {
+                crc0 = _mm_crc32_u64(crc0, load64(p));
+                crc1 = _mm_crc32_u64(crc1, load64(p + stream));
+                crc2 = _mm_crc32_u64(crc2, load64(p + 2 * stream));
+            }
+            crc0 = shift_register(crc0, two_streams[s]) ^ shift_register(crc1, one_stream[s]) ^ crc2;
+            p += 2 * stream;
+            size -= 3 * stream;
+        }
+    }
+    while (size >= 8) {
+        crc0 = _mm_crc32_u64(crc0, load64(p));
+        p += 8;
+        size -= 8;
+    }
+    crc = static_cast<std::uint32_t>(crc0);
+    while (size > 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+        size--;
+    }
+    return crc;
+}
+
+#endif // CRC32C_X86
+
+inline Crc32cImplementation detect() {
+#ifdef CRC32C_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        return __builtin_cpu_supports("pclmul") ? CRC32C_SSE42_PCLMUL : CRC32C_SSE42;
+    }
+#endif
+    return CRC32C_TABLE;
+}
+
+} // namespace crc32c_detail
+
+// The fastest implementation this CPU supports.
+inline Crc32cImplementation crc32c_best_implementation() {
+    static const Crc32cImplementation best = crc32c_detail::detect();
+    return best;
+}
+
+inline const char* crc32c_implementation_name(Crc32cImplementation implementation) {
+    switch (implementation) {
+        case CRC32C_TABLE: return "table";
+        case CRC32C_SSE42: return "sse4.2";
+        case CRC32C_SSE42_PCLMUL: return "sse4.2+pclmul";
+    }
+    return "?";
+}
+
+// crc32c_extend with an explicit implementation; for benchmarks and cross-checks. Asking for an
+// implementation the CPU lacks falls back to the table.
+inline std::uint32_t crc32c_extend_with(Crc32cImplementation implementation, std::uint32_t crc,
+                                        const void* data, std::size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+#ifdef CRC32C_X86
+    if (implementation > crc32c_best_implementation()) implementation = CRC32C_TABLE;
+    // Below three short streams there is nothing to fold; skip the constants lookup
+    if (implementation == CRC32C_SSE42_PCLMUL && size >= 3 * crc32c_detail::SHORT_STREAM) {
+        return ~crc32c_detail::extend_sse42_pclmul(~crc, p, size);
+    }
+    if (implementation >= CRC32C_SSE42) return ~crc32c_detail::extend_sse42(~crc, p, size);
+#else
+    (void)implementation;
+#endif
+    return ~crc32c_detail::extend_table(~crc, p, size);
+}
+
+inline std::uint32_t crc32c_extend(std::uint32_t crc, const void* data, std::size_t size) {
+    return crc32c_extend_with(crc32c_best_implementation(), crc, data, size);
+}
+
+inline std::uint32_t crc32c(const void* data, std::size_t size) {
+    return crc32c_extend(0, data, size);
+}
+
+#endif // CRC32C_H
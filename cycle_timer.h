@@ -0,0 +1,48 @@
+#ifndef CYCLE_TIMER_H
+#define CYCLE_TIMER_H
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CYCLE_TIMER_TSC 1
+#include <x86intrin.h>
+#endif
+
+// Cycle counter for microbenchmarks.
+//
+// On x86-64 cycle_now() reads the time-stamp counter behind an lfence, so it is not reordered
+// above the loads it is meant to follow. Invariant TSCs tick at a constant reference rate, not
+// the core's current clock, so a "cycle" is a reference cycle: comparable across runs on one
+// machine even while the core boosts or throttles. Elsewhere it falls back to steady_clock
+// nanoseconds, and cycles_per_ns() is 1.
+//
+// A single rdtsc costs ~20-40 cycles; time batches of operations and divide rather than
+// timing each one.
+
+inline std::uint64_t cycle_now() {
+#ifdef CYCLE_TIMER_TSC
+    _mm_lfence();
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Counter ticks per nanosecond, measured once against steady_clock over ~50 ms.
+inline double cycles_per_ns() {
+    static const double rate = [] {
+        auto wall_start = std::chrono::steady_clock::now();
+        std::uint64_t start = cycle_now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        std::uint64_t end = cycle_now();
+        double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - wall_start).count());
+        return ns > 0 ? static_cast<double>(end - start) / ns : 1.0;
+    }();
+    return rate;
+}
+
+#endif // CYCLE_TIMER_H
@@ -0,0 +1,318 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "crc32c.h"
+
+// Compact binary log of simulation events, replacing one English line (~60 bytes) per event
+// with a few bytes that a decoder turns back into the same line.
+//
+// Event encoding: one byte (kind in the low nibble, aux in the high nibble), the time since the
+// previous event in microseconds, then the kind's fields, all as unsigned LEB128 varints.
+// Which fields a kind carries is fixed by EVENT_FIELDS below, so nothing is tagged per field.
+//
+// Events are framed in blocks of up to EVENT_BLOCK_BYTES payload:
+//   magic "RSVE" (u32), event count (u32), payload bytes (u32), CRC32C (u32), base time (u64 us)
+// The CRC covers the header (with the CRC field zero) and the payload. Each block restarts its
+// time deltas from its base time, so a damaged block costs only its own events.
+//
+// Writers are not thread-safe: the simulation serializes them with print_mutex, as it does cout.
+
+enum EventKind : std::uint8_t {
+    EVENT_WAITING = 0,        // aux: query type
+    EVENT_GAINED,             // aux: query type
+    EVENT_INQUIRY,            // count: seats available
+    EVENT_BOOKED,
+    EVENT_FAILED,             // aux: query type (booking or hold)
+    EVENT_CANCELLED,
+    EVENT_NOTHING_TO_CANCEL,
+    EVENT_HELD,
+    EVENT_CONFIRMED,
+    EVENT_HOLD_UNPAID,        // Hold expired before payment arrived
+    EVENT_RELEASED,
+    EVENT_PROMOTED,           // other: thread whose waitlisted request was served
+    EVENT_WAITLISTED,         // remaining: position in the waitlist
+    EVENT_WAITLIST_FULL,
+    EVENT_ITINERARY_BOOKED,   // aux: leg count; count: seats; legs: (train, seats left)
+    EVENT_ITINERARY_FAILED,   // count: retries
+    EVENT_NUM_KINDS
+};
+
+const int EVENT_MAX_LEGS = 15; // Leg count lives in the aux nibble
+const int EVENT_ACTOR_HOLD_EXPIRY = -1; // Actor of releases and promotions by the expiry service
+
+struct Event {
+    std::uint64_t time_us = 0;   // Since the log was opened
+    std::uint8_t kind = 0;       // EventKind
+    std::uint8_t aux = 0;        // 0..15
+    std::int32_t actor = 0;      // Thread number, or EVENT_ACTOR_HOLD_EXPIRY
+    std::int32_t train_num = 0;
+    std::int32_t count = 0;      // Seats moved (see EventKind for exceptions)
+    std::int32_t remaining = 0;  // Seats left afterwards
+    std::int32_t other = 0;
+    std::int32_t legs[EVENT_MAX_LEGS][2];
+};
+
+namespace event_log_detail {
+
+const std::uint32_t MAGIC = 0x45565352u; // "RSVE"
+const std::size_t EVENT_BLOCK_BYTES = 64 * 1024;
+const std::size_t MAX_EVENT_BYTES = 2 + 10 + 5 * 7 + EVENT_MAX_LEGS * 2 * 5;
+
+enum Field : std::uint8_t {
+    F_ACTOR = 1, F_TRAIN = 2, F_COUNT = 4, F_REMAINING = 8, F_OTHER = 16, F_LEGS = 32
+};
+
+const std::uint8_t EVENT_FIELDS[EVENT_NUM_KINDS] = {
+    F_ACTOR | F_TRAIN,                                    // WAITING
+    F_ACTOR | F_TRAIN,                                    // GAINED
+    F_ACTOR | F_TRAIN | F_COUNT,                          // INQUIRY
+    F_ACTOR | F_TRAIN | F_COUNT | F_REMAINING,            // BOOKED
+    F_ACTOR | F_TRAIN,                                    // FAILED
+    F_ACTOR | F_TRAIN | F_COUNT | F_REMAINING,            // CANCELLED
+    F_ACTOR | F_TRAIN,                                    // NOTHING_TO_CANCEL
+    F_ACTOR | F_TRAIN | F_COUNT | F_REMAINING,            // HELD
+    F_ACTOR | F_TRAIN,                                    // CONFIRMED
+    F_ACTOR | F_TRAIN,                                    // HOLD_UNPAID
+    F_ACTOR | F_TRAIN | F_COUNT | F_REMAINING,            // RELEASED
+    F_ACTOR | F_TRAIN | F_COUNT | F_REMAINING | F_OTHER,  // PROMOTED
+    F_ACTOR | F_TRAIN | F_COUNT | F_REMAINING,            // WAITLISTED
+    F_ACTOR | F_TRAIN,                                    // WAITLIST_FULL
+    F_ACTOR | F_COUNT | F_LEGS,                           // ITINERARY_BOOKED
+    F_ACTOR | F_TRAIN | F_COUNT,                          // ITINERARY_FAILED
+};
+
+struct BlockHeader {
+    std::uint32_t magic;
+    std::uint32_t events;
+    std::uint32_t payload_bytes;
+    std::uint32_t crc;
+    std::uint64_t base_us;
+};
+static_assert(sizeof(BlockHeader) == 24, "BlockHeader is an on-disk format");
+
+inline std::uint32_t block_crc(BlockHeader header, const unsigned char* payload) {
+    header.crc = 0;
+    return crc32c_extend(crc32c(&header, sizeof(header)), payload, header.payload_bytes);
+}
+
+inline unsigned char* put_varint(unsigned char* p, std::uint64_t value) {
+    while (value >= 0x80) {
+        *p++ = static_cast<unsigned char>(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = static_cast<unsigned char>(value);
+    return p;
+}
+
+// Returns nullptr if the varint runs past `end` or is longer than 10 bytes.
+inline const unsigned char* get_varint(const unsigned char* p, const unsigned char* end, std::uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        unsigned char byte = *p++;
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return p;
+    }
+    return nullptr;
+}
+
+// Actor -1 (hold expiry) is stored as 0, thread n as n + 1.
+inline std::uint64_t encode_actor(std::int32_t actor) { return static_cast<std::uint64_t>(actor + 1); }
+inline std::int32_t decode_actor(std::uint64_t value) { return static_cast<std::int32_t>(value) - 1; }
+
+} // namespace event_log_detail
+
+class EventLogWriter {
+public:
+    EventLogWriter() = default;
+    EventLogWriter(const EventLogWriter&) = delete;
+    EventLogWriter& operator=(const EventLogWriter&) = delete;
+    ~EventLogWriter() { close(); }
+
+    bool open(const std::string& path) {
+        file = std::fopen(path.c_str(), "wb");
+        payload.reserve(event_log_detail::EVENT_BLOCK_BYTES + event_log_detail::MAX_EVENT_BYTES);
+        return file != nullptr;
+    }
+
+    // Writes the last partial block. Returns false if any write failed.
+    bool close() {
+        if (file == nullptr) return ok;
+        flush_block();
+        ok = std::fclose(file) == 0 && ok;
+        file = nullptr;
+        return ok;
+    }
+
+    bool is_open() const { return file != nullptr; }
+
+    // Appends one event; time_us must not go backwards.
+    void append(const Event& event) {
+        using namespace event_log_detail;
+        if (block_events == 0) block_base_us = last_us = event.time_us;
+        std::size_t used = payload.size();
+        payload.resize(used + MAX_EVENT_BYTES);
+        unsigned char* start = payload.data() + used;
+        unsigned char* p = start;
+        *p++ = static_cast<unsigned char>((event.kind & 0x0F) | (event.aux << 4));
+        p = put_varint(p, event.time_us - last_us);
+        std::uint8_t fields = EVENT_FIELDS[event.kind & 0x0F];
+        if (fields & F_ACTOR) p = put_varint(p, encode_actor(event.actor));
+        if (fields & F_TRAIN) p = put_varint(p, static_cast<std::uint32_t>(event.train_num));
+        if (fields & F_COUNT) p = put_varint(p, static_cast<std::uint32_t>(event.count));
+        if (fields & F_REMAINING) p = put_varint(p, static_cast<std::uint32_t>(event.remaining));
+        if (fields & F_OTHER) p = put_varint(p, static_cast<std::uint32_t>(event.other));
+        if (fields & F_LEGS) {
+            for (int i = 0; i < (event.aux & 0x0F); i++) {
+                p = put_varint(p, static_cast<std::uint32_t>(event.legs[i][0]));
+                p = put_varint(p, static_cast<std::uint32_t>(event.legs[i][1]));
+            }
+        }
+        payload.resize(used + static_cast<std::size_t>(p - start));
+        last_us = event.time_us;
+        block_events++;
+        total_events++;
+        if (payload.size() >= EVENT_BLOCK_BYTES) flush_block();
+    }
+
+    long long events() const { return total_events; }
+    long long bytes() const { return total_bytes; }
+    long long blocks() const { return total_blocks; }
+
+private:
+    void flush_block() {
+        using namespace event_log_detail;
+        if (block_events == 0) return;
+        BlockHeader header;
+        header.magic = MAGIC;
+        header.events = block_events;
+        header.payload_bytes = static_cast<std::uint32_t>(payload.size());
+        header.base_us = block_base_us;
+        header.crc = block_crc(header, payload.data());
+        ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+             std::fwrite(payload.data(), 1, payload.size(), file) == payload.size() && ok;
+        total_bytes += static_cast<long long>(sizeof(header) + payload.size());
+        total_blocks++;
+        payload.clear();
+        block_events = 0;
+    }
+
+    FILE* file = nullptr;
+    bool ok = true;
+    std::vector<unsigned char> payload;
+    std::uint32_t block_events = 0;
+    std::uint64_t block_base_us = 0;
+    std::uint64_t last_us = 0;
+    long long total_events = 0;
+    long long total_bytes = 0;
+    long long total_blocks = 0;
+};
+
+// Streams events back out of a log, one block in memory at a time. Blocks that fail their CRC or
+// do not decode are skipped and counted; a damaged header ends the stream.
+class EventLogReader {
+public:
+    EventLogReader() = default;
+    EventLogReader(const EventLogReader&) = delete;
+    EventLogReader& operator=(const EventLogReader&) = delete;
+    ~EventLogReader() {
+        if (file != nullptr) std::fclose(file);
+    }
+
+    bool open(const std::string& path) {
+        file = std::fopen(path.c_str(), "rb");
+        return file != nullptr;
+    }
+
+    // Fills `event` with the next event. Returns false at the end of the log.
+    bool next(Event& event) {
+        using namespace event_log_detail;
+        while (events_left == 0) {
+            if (!load_block()) return false;
+        }
+        std::uint64_t value;
+        if (cursor >= end) return skip_rest(event);
+        unsigned char head = *cursor++;
+        event.kind = head & 0x0F;
+        event.aux = head >> 4;
+        if ((cursor = get_varint(cursor, end, value)) == nullptr) return skip_rest(event);
+        last_us += value;
+        event.time_us = last_us;
+        std::uint8_t fields = EVENT_FIELDS[event.kind];
+        std::int32_t* targets[] = {&event.actor, &event.train_num, &event.count, &event.remaining, &event.other};
+        for (int f = 0; f < 5; f++) {
+            if ((fields & (1 << f)) == 0) continue;
+            if ((cursor = get_varint(cursor, end, value)) == nullptr) return skip_rest(event);
+            *targets[f] = f == 0 ? decode_actor(value) : static_cast<std::int32_t>(value);
+        }
+        if (fields & F_LEGS) {
+            for (int i = 0; i < event.aux; i++) {
+                for (int j = 0; j < 2; j++) {
+                    if ((cursor = get_varint(cursor, end, value)) == nullptr) return skip_rest(event);
+                    event.legs[i][j] = static_cast<std::int32_t>(value);
+                }
+            }
+        }
+        events_left--;
+        total_events++;
+        return true;
+    }
+
+    long long events() const { return total_events; }
+    long long blocks() const { return total_blocks; }
+    long long corrupt_blocks() const { return total_corrupt; }
+    long long bytes() const { return total_bytes; }
+
+private:
+    bool load_block() {
+        using namespace event_log_detail;
+        BlockHeader header;
+        if (std::fread(&header, sizeof(header), 1, file) != 1) return false;
+        if (header.magic != MAGIC || header.payload_bytes > EVENT_BLOCK_BYTES + MAX_EVENT_BYTES) {
+            total_corrupt++;
+            return false;
+        }
+        block.resize(header.payload_bytes);
+        if (std::fread(block.data(), 1, block.size(), file) != block.size()) {
+            total_corrupt++; // Truncated tail
+            return false;
+        }
+        total_bytes += static_cast<long long>(sizeof(header) + block.size());
+        if (block_crc(header, block.data()) != header.crc) {
+            total_corrupt++;
+            return true; // Skip this block, try the next one
+        }
+        cursor = block.data();
+        end = cursor + block.size();
+        events_left = header.events;
+        last_us = header.base_us;
+        total_blocks++;
+        return true;
+    }
+
+    // A block that passed its CRC but does not decode: drop its remaining events.
+    bool skip_rest(Event& event) {
+        total_corrupt++;
+        events_left = 0;
+        return next(event);
+    }
+
+    FILE* file = nullptr;
+    std::vector<unsigned char> block;
+    const unsigned char* cursor = nullptr;
+    const unsigned char* end = nullptr;
+    std::uint32_t events_left = 0;
+    std::uint64_t last_us = 0;
+    long long total_events = 0;
+    long long total_blocks = 0;
+    long long total_corrupt = 0;
+    long long total_bytes = 0;
+};
+
+#endif // EVENT_LOG_H
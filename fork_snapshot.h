@@ -0,0 +1,145 @@
+#ifndef FORK_SNAPSHOT_H
+#define FORK_SNAPSHOT_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "crc32c.h"
+
+// Online snapshots through fork(): the child gets a copy-on-write image of the parent's memory
+// frozen at the fork, writes the requested region to disk and exits, while the parent keeps
+// running. The parent pays for fork() itself (copying page tables) and for a minor page fault
+// the first time it writes to each page shared with the child.
+//
+// Only private memory is frozen: MAP_SHARED regions stay live in the child.
+//
+// The child may only use async-signal-safe calls: other threads of the parent can hold locks
+// (including malloc's) at the moment of the fork. It therefore writes straight from the frozen
+// region with write()/fsync() and never allocates. Call crc32c() once before the first snapshot
+// so its lazily initialized state (CPU detection, tables) is not built inside the child.
+//
+// Snapshot file: magic "RSVSNAP1", payload size (u64), payload, CRC32C of the payload (u32).
+
+struct ForkSnapshotResult {
+    bool ok = false;
+    long long fork_ns = 0;       // Time the calling thread spent inside fork()
+    long long child_ns = 0;      // Serialization time measured by the child
+    long long total_ns = 0;      // fork() until the child was reaped
+    long long parent_minor_faults = 0; // Minor faults of the parent while the child was alive
+};
+
+namespace fork_snapshot_detail {
+
+const char MAGIC[8] = {'R', 'S', 'V', 'S', 'N', 'A', 'P', '1'};
+
+inline long long minor_faults() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+inline long long now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline bool write_all(int fd, const void* data, std::size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = ::write(fd, p, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+// Runs in the child. Writes to tmp_path, syncs, renames over path.
+inline bool write_snapshot_file(const void* data, std::size_t bytes, const char* tmp_path, const char* path) {
+    int fd = ::open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    std::uint64_t size = bytes;
+    std::uint32_t crc = crc32c(data, bytes);
+    bool ok = write_all(fd, MAGIC, sizeof(MAGIC)) && write_all(fd, &size, sizeof(size)) &&
+              write_all(fd, data, bytes) && write_all(fd, &crc, sizeof(crc)) && ::fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    return ok && ::rename(tmp_path, path) == 0;
+}
+
+} // namespace fork_snapshot_detail
+
+// Snapshots `bytes` bytes at `data` into `path`. Blocks the calling thread (not the process)
+// until the child is done.
+inline ForkSnapshotResult fork_snapshot(const void* data, std::size_t bytes, const std::string& path) {
+    using namespace fork_snapshot_detail;
+    ForkSnapshotResult result;
+    std::string tmp_path = path + ".tmp"; // Built before fork: the child must not allocate
+    int report[2];
+    if (::pipe(report) != 0) return result;
+
+    long long faults_before = minor_faults();
+    long long start = now_ns();
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        ::close(report[0]);
+        long long child_start = now_ns();
+        bool ok = write_snapshot_file(data, bytes, tmp_path.c_str(), path.c_str());
+        long long child_ns = ok ? now_ns() - child_start : -1;
+        write_all(report[1], &child_ns, sizeof(child_ns));
+        ::_exit(ok ? 0 : 1);
+    }
+    result.fork_ns = now_ns() - start;
+    ::close(report[1]);
+    if (pid < 0) {
+        ::close(report[0]);
+        return result;
+    }
+
+    long long child_ns = -1;
+    ssize_t got = ::read(report[0], &child_ns, sizeof(child_ns));
+    ::close(report[0]);
+    int status = 0;
+    while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    result.total_ns = now_ns() - start;
+    result.parent_minor_faults = minor_faults() - faults_before;
+    result.child_ns = child_ns;
+    result.ok = got == static_cast<ssize_t>(sizeof(child_ns)) && child_ns >= 0 &&
+                WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    return result;
+}
+
+// Reads a snapshot file back. Returns false on I/O errors, bad magic or checksum mismatch.
+inline bool load_snapshot(const std::string& path, std::vector<unsigned char>& payload) {
+    using namespace fork_snapshot_detail;
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) return false;
+    char magic[sizeof(MAGIC)];
+    std::uint64_t size = 0;
+    std::uint32_t crc = 0;
+    bool ok = std::fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+              std::string(magic, sizeof(magic)) == std::string(MAGIC, sizeof(MAGIC)) &&
+              std::fread(&size, sizeof(size), 1, file) == 1;
+    if (ok) {
+        payload.resize(static_cast<std::size_t>(size));
+        ok = std::fread(payload.data(), 1, payload.size(), file) == payload.size() &&
+             std::fread(&crc, sizeof(crc), 1, file) == 1 && crc == crc32c(payload.data(), payload.size());
+    }
+    std::fclose(file);
+    return ok;
+}
+
+#endif // FORK_SNAPSHOT_H
@@ -0,0 +1,202 @@
+// Load generator for the booking server (main --serve=PORT).
+//
+// Build: g++ -std=c++17 -O2 -pthread loadgen.cpp -o loadgen
+// Usage: loadgen [port] [connections] [pipeline depth] [seconds] [trains]
+//
+// Every connection has its own thread and keeps `pipeline depth` requests in flight: it sends
+// that many at once, then one new request for every response that comes back, batching the
+// sends of one read into a single write. Latency is measured per request from its send to its
+// response. The mix is half inquiries, a quarter bookings and a quarter cancellations of
+// BOOK_MIN..BOOK_MAX seats on random trains.
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cerrno>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "protocol.h"
+
+using namespace std;
+
+// --- DEFINITIONS ---
+#define BOOK_MIN 5
+#define BOOK_MAX 10
+#define INQUIRY_PERCENT 50
+#define BOOK_PERCENT 25 // The rest are cancellations
+
+struct ConnectionResult {
+    bool ok = true;
+    std::string error;
+    long long responses = 0;
+    long long by_status[RESP_NOT_DURABLE + 1] = {};
+    std::vector<long long> latencies_ns;
+};
+
+// --- CONNECTION THREAD ---
+int connect_to_server(int port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<std::uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+bool send_all(int fd, const unsigned char* data, std::size_t size) {
+    while (size > 0) {
+        ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += sent;
+        size -= static_cast<std::size_t>(sent);
+    }
+    return true;
+}
+
+void run_connection(int port, int depth, int seconds, int trains, unsigned seed, ConnectionResult& result) {
+    typedef std::chrono::steady_clock clock;
+    int fd = connect_to_server(port);
+    if (fd < 0) {
+        result.ok = false;
+        result.error = std::string("connect: ") + std::strerror(errno);
+        return;
+    }
+    std::mt19937 rng(seed);
+    std::vector<clock::time_point> sent_at(depth); // By request_id % depth: at most depth in flight
+    std::uint32_t next_id = 0;
+    std::uint32_t expected_id = 0;
+    std::vector<unsigned char> out;
+    auto queue_request = [&](clock::time_point now) {
+        Request request;
+        int kind = static_cast<int>(rng() % 100);
+        request.op = kind < INQUIRY_PERCENT ? REQ_INQUIRY : kind < INQUIRY_PERCENT + BOOK_PERCENT ? REQ_BOOK : REQ_CANCEL;
+        request.request_id = next_id;
+        request.train_num = static_cast<std::uint32_t>(rng() % trains);
+        request.seats = static_cast<std::uint16_t>(BOOK_MIN + rng() % (BOOK_MAX - BOOK_MIN + 1));
+        std::size_t at = out.size();
+        out.resize(at + REQUEST_FRAME_BYTES);
+        encode_request(request, out.data() + at);
+        sent_at[next_id % depth] = now;
+        next_id++;
+    };
+
+    auto deadline = clock::now() + std::chrono::seconds(seconds);
+    for (int i = 0; i < depth; i++) queue_request(clock::now());
+    std::vector<unsigned char> in;
+    bool sending = true;
+    while (result.ok && (sending || expected_id != next_id)) {
+        if (!out.empty()) {
+            if (!send_all(fd, out.data(), out.size())) {
+                result.ok = false;
+                result.error = std::string("send: ") + std::strerror(errno);
+                break;
+            }
+            out.clear();
+        }
+        std::size_t old_size = in.size();
+        in.resize(old_size + 65536);
+        ssize_t got = ::recv(fd, in.data() + old_size, 65536, 0);
+        if (got <= 0) {
+            if (got < 0 && errno == EINTR) {
+                in.resize(old_size);
+                continue;
+            }
+            result.ok = false;
+            result.error = got == 0 ? "server closed the connection" : std::string("recv: ") + std::strerror(errno);
+            break;
+        }
+        in.resize(old_size + static_cast<std::size_t>(got));
+
+        clock::time_point now = clock::now();
+        if (now >= deadline) sending = false;
+        std::size_t consumed = 0;
+        while (true) {
+            Response response;
+            long used = decode_response(in.data() + consumed, in.size() - consumed, response);
+            if (used < 0 || (used > 0 && response.request_id != expected_id)) {
+                result.ok = false;
+                result.error = used < 0 ? "malformed response" : "response out of order";
+                break;
+            }
+            if (used == 0) break;
+            consumed += static_cast<std::size_t>(used);
+            result.latencies_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                now - sent_at[expected_id % depth]).count());
+            if (response.status <= RESP_NOT_DURABLE) result.by_status[response.status]++;
+            result.responses++;
+            expected_id++;
+            if (sending) queue_request(now);
+        }
+        in.erase(in.begin(), in.begin() + static_cast<std::ptrdiff_t>(consumed));
+    }
+    ::close(fd);
+}
+
+// --- MAIN FUNCTION ---
+int main(int argc, char* argv[]) {
+    int port = argc > 1 ? std::atoi(argv[1]) : 7070;
+    int connections = argc > 2 ? std::atoi(argv[2]) : 8;
+    int depth = argc > 3 ? std::atoi(argv[3]) : 16;
+    int seconds = argc > 4 ? std::atoi(argv[4]) : 5;
+    int trains = argc > 5 ? std::atoi(argv[5]) : 100;
+    if (port <= 0 || connections <= 0 || depth <= 0 || seconds <= 0 || trains <= 0) {
+        cerr << "Usage: " << argv[0] << " [port] [connections] [pipeline depth] [seconds] [trains]" << endl;
+        return 1;
+    }
+
+    cout << "--- Load: 127.0.0.1:" << port << ", " << connections << " connections x " << depth
+         << " in flight, " << seconds << " s ---\n";
+    std::vector<ConnectionResult> results(connections);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < connections; i++) {
+        threads.emplace_back(run_connection, port, depth, seconds, trains, 1234u + i, std::ref(results[i]));
+    }
+    for (std::thread& thread : threads) thread.join();
+    double elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count() / 1e6;
+
+    std::vector<long long> all;
+    long long by_status[RESP_NOT_DURABLE + 1] = {};
+    int failed = 0;
+    for (const ConnectionResult& result : results) {
+        all.insert(all.end(), result.latencies_ns.begin(), result.latencies_ns.end());
+        for (int status = 0; status <= RESP_NOT_DURABLE; status++) by_status[status] += result.by_status[status];
+        if (!result.ok) {
+            if (failed++ == 0) cerr << "Connection failed: " << result.error << endl;
+        }
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&](double p) {
+        return all.empty() ? 0 : all[std::min(all.size() - 1, static_cast<std::size_t>(p * all.size()))];
+    };
+    cout << "Responses:             " << all.size() << " (" << by_status[RESP_OK] << " ok, "
+         << by_status[RESP_REJECTED] << " rejected, " << by_status[RESP_BAD_REQUEST] << " bad, "
+         << by_status[RESP_NOT_DURABLE] << " not durable)" << endl;
+    cout << "Throughput:            " << static_cast<long long>(all.size() / elapsed) << " requests/s" << endl;
+    cout << "Latency:               p50 " << percentile(0.50) / 1000 << " us, p99 " << percentile(0.99) / 1000
+         << " us, p99.9 " << percentile(0.999) / 1000 << " us, max " << (all.empty() ? 0 : all.back() / 1000)
+         << " us" << endl;
+    if (failed > 0) cout << "WARNING: " << failed << " of " << connections << " connections failed" << endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -4,12 +4,63 @@
 #include <condition_variable>
 #include <chrono>
 #include <cstdlib>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <new>
+#include <csignal>
+#include <unordered_map>
+#include <functional>
+#include <cmath>
+#include <memory>
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ring_buffer.h"
+#include "timer_wheel.h"
+#include "wal.h"
+#include "seat_store.h"
+#include "fork_snapshot.h"
+#include "event_log.h"
+#include "shm_table.h"
+#include "protocol.h"
+#include "cycle_timer.h"
+#include "reservation_engine.h"
+#include "packed_inventory.h"
+#include "seat_search.h"
+#include "availability_tree.h"
+#include "sharded_counters.h"
+#include "single_flight.h"
 
 using namespace std;
 using namespace std::chrono;
 
 // --- DEFINITIONS ---
-#define MAX_TRAINS 100
+#define DEFAULT_TRAINS 100 // --trains=N
+#define MAX_TRAINS (1 << 24)
+#define DEFAULT_MAX_LOCK_STRIPES 4096 // Beyond this many trains, trains share locks (--lock-stripes=N)
 #define CAPACITY 500
 #define BOOK_MIN 5
 #define BOOK_MAX 10
@@ -17,16 +68,241 @@ using namespace std::chrono;
 // GLOBAL CONSTRAINT: Max number of threads allowed to enter the booking system logic
 #define MAX_CONCURRENT_ACCESS 5
 #define MAX_TIME 1 // mins
+// Waitlist: bounded per-train FIFO (power of two) and the share of failed bookings that opt in
+#define WAITLIST_CAPACITY 32
+#define WAITLIST_OPT_IN_PERCENT 50
+// Temporary holds: lifetime, expiry-wheel resolution and what holders do after the hold
+#define HOLD_TTL_MS 2000
+#define HOLD_TICK_MS 10
+#define HOLD_CONFIRM_PERCENT 70 // Pay and confirm
+#define HOLD_RELEASE_PERCENT 15 // Cancel the hold explicitly; the rest walk away and let it expire
+// Itineraries: connecting journeys of up to ITINERARY_MAX_LEGS trains, booked all-or-nothing
+#define ITINERARY_MAX_LEGS 3
+#define ITINERARY_MAX_RETRIES 2 // Alternative connections tried after an abort
+// Memory-mapped seat store (--store=PATH): checkpoint period and days of inventory per train
+#define STORE_CHECKPOINT_MS 5000
+#define STORE_DAYS 1
+
+#define RECOVERY_MAX_THREADS 8
+#define TORTURE_CHECKPOINT_MS 20 // Crash torture checkpoints often so kills land around them
+// Journal segments (with --wal) and their background compaction into a per-train checkpoint
+#define JOURNAL_SEGMENT_BYTES (4 << 20)
+#define COMPACTION_INTERVAL_MS 1000
+#define COMPACTION_MAX_MB_PER_S 32 // Read budget that keeps the compactor out of the workers' way
+#define TORTURE_SEGMENT_BYTES (64 << 10) // Crash torture rolls and compacts segments constantly
+#define TORTURE_COMPACTION_MS 30
+// Online fork() snapshots of train_state (--snapshot=PATH)
+#define SNAPSHOT_INTERVAL_MS 5000
+// Consistent live availability reports (--live-report): period and validation passes before giving up
+#define LIVE_REPORT_MS 2000
+#define CONSISTENT_READ_MAX_PASSES 64
+// TCP booking server (--serve=PORT): a connection whose unsent responses exceed this is not read
+#define SERVER_MAX_OUTPUT_BYTES (1 << 20)
+// Query types: 1 Inquiry, 2 Booking, 3 Cancellation, 4 Hold, 5 Itinerary
+#define NUM_QUERY_TYPES 5
+
+#define INVENTORY_CLASSES 4 // Travel classes per train in the inventory layout benchmark
 
 // --- GLOBAL SHARED RESOURCES ---
+// The train table is sized at startup (--trains=N) by allocate_train_table(); every per-train
+// array below has num_trains entries.
+int num_trains = DEFAULT_TRAINS;
+
 // 1. Mutexes for Data Integrity (Fine-grained locking)
-std::mutex train_mutex[MAX_TRAINS];
-int available_seats[MAX_TRAINS];
+// pthread mutexes behind a pointer, like train_state below: with --shm both point into a shared
+// table where the locks are robust and process-shared.
+// Lock striping: a pthread mutex is 40 bytes, more than the rest of a train's state together, so
+// there are lock_stripes locks (a power of two) and each guards every train whose low bits match
+// its index. Up to DEFAULT_MAX_LOCK_STRIPES trains, every train has a lock of its own.
+std::unique_ptr<RobustMutex[]> train_mutex_memory;
+RobustMutex* train_mutex = nullptr;
+int lock_stripes = 0; // --lock-stripes=N, rounded up to a power of two
+
+inline int lock_stripe_of(int train_num) { return train_num & (lock_stripes - 1); }
+inline RobustMutex& train_mutex_of(int train_num) { return train_mutex[lock_stripe_of(train_num)]; }
+
+// Per-train state word: available seats (signed, high 32 bits) and a version (low 32 bits)
+// that every change bumps. Packing both lets the lock-free engines validate and commit with
+// one CAS. Every writer, locked or not, goes through the CAS helpers below, so lock-holding
+// paths stay correct while lock-free bookings run on the same train.
+// Points at train_state_memory, or at the live region of the memory-mapped store (--store=PATH).
+std::unique_ptr<std::atomic<std::uint64_t>[]> train_state_memory;
+std::atomic<std::uint64_t>* train_state = nullptr;
+
+// Booking engine used by Inquiry, Booking and Cancellation queries (--engine=...).
+// Holds, waitlist promotions and itineraries always take train_mutex: they are multi-step.
+enum EngineMode {
+    ENGINE_MUTEX,  // Hold train_mutex for the whole request (the original design)
+    ENGINE_ATOMIC, // Bookings: fetch_add, compensated on overshoot (CAS with --wal); cancellations: CAS
+    ENGINE_OCC     // Read version + seats without locking, commit with a CAS, retry on conflict
+};
+EngineMode engine_mode = ENGINE_MUTEX;
+
+// Seats a plain-atomic booking has taken out of its train's word but not settled yet (kept, or
+// compensated because it overshot). Raised before the take and lowered once it settles, so a
+// cancellation that counts them back in never gives back seats that only look booked.
+std::unique_ptr<std::atomic<int>[]> booking_seats_memory;
+std::atomic<int>* booking_seats = nullptr; // Shared table's counters with --shm
+
+// Plain counters so benchmark threads can keep private copies; the simulation merges into
+// engine_totals after every query.
+struct EngineStats {
+    long long operations = 0;    // Bookings and cancellations handled by the engine
+    long long conflicts = 0;     // Mutex: contended train lock; OCC: failed CAS that was retried
+    long long compensations = 0; // Atomic: optimistic update undone because it overshot
+    long long lock_wait_ns = 0;  // Mutex: time spent blocked on a contended train lock
+};
+std::mutex engine_stats_mutex;
+EngineStats engine_totals;
+
+// Durable booking journal (--wal=PATH). Every change of a train_state word is appended as one
+// fixed-size record carrying the resulting (seats, version), so replay per train is simply
+// "the record with the newest version wins" and needs no ordering across trains.
+enum JournalOp : std::uint8_t {
+    JOURNAL_BOOK = 1,
+    JOURNAL_CANCEL,
+    JOURNAL_HOLD,
+    JOURNAL_HOLD_CONFIRM, // No seat change and no state word; only ends the hold
+    JOURNAL_HOLD_RELEASE,
+    JOURNAL_HOLD_EXPIRE,
+    JOURNAL_PROMOTE,      // Waitlist promotion
+    JOURNAL_ITINERARY,    // One leg of an itinerary
+    JOURNAL_COMPENSATE    // Undo of an optimistic update (itinerary rollback)
+};
+
+struct JournalRecord {
+    std::uint64_t hold_id;       // Hold records only, else 0
+    std::int32_t train_num;
+    std::int32_t seats;          // Seats moved by the operation
+    std::int32_t seats_after;    // train_state right after the change
+    std::uint32_t version_after;
+    std::uint8_t op;             // JournalOp
+    std::uint8_t reserved[3];
+    std::uint32_t crc;           // CRC32C of every byte above; catches torn and stray writes
+};
+static_assert(sizeof(JournalRecord) == 32, "JournalRecord is an on-disk format");
+
+inline std::uint32_t journal_record_crc(const JournalRecord& record) {
+    return crc32c(&record, offsetof(JournalRecord, crc));
+}
+
+WalWriter journal;
+WalWriter::IoMode journal_io_mode = WalWriter::IO_WRITE; // --wal-io=write|pwritev|uring
+bool journal_enabled = false;
+thread_local std::uint64_t journal_last_seq = 0; // Newest record this thread still has to wait for
+// The newest state-bearing record this thread appended, as its client is told once it is durable
+struct JournalAck {
+    std::uint32_t train_num;
+    std::uint32_t reserved;
+    std::uint64_t state_after;
+};
+thread_local JournalAck journal_last_ack = {0, 0, 0};
+
+// Newest state word per store slot whose journal record is known to be on disk, advanced by the
+// journal's durable hook. Checkpoints image these rather than the live words: a live word can
+// belong to a commit whose record is still in flight, and an image holding it would run ahead
+// of the journal it is later recovered with.
+std::unique_ptr<std::atomic<std::uint64_t>[]> durable_state; // num_trains * STORE_DAYS
+
+// Memory-mapped seat store (--store=PATH) and its periodic checkpointer
+SeatStore seat_store;
+bool store_enabled = false;
+std::mutex checkpointer_mutex;
+std::condition_variable checkpointer_cond; // Wakes the checkpointer early at shutdown
+bool checkpointer_running = false;
+std::thread checkpointer_thread;
+int checkpoint_interval_ms = STORE_CHECKPOINT_MS;
+std::atomic<long long> checkpoints_taken{0};
+std::atomic<long long> checkpoint_ns_max{0};
+
+// Online snapshots (--snapshot=PATH): a forked child writes a point-in-time copy of
+// train_state while workers keep booking. Only the snapshotter thread touches snapshot_totals.
+std::string snapshot_path;
+std::mutex snapshotter_mutex;
+std::condition_variable snapshotter_cond;
+bool snapshotter_running = false;
+std::thread snapshotter_thread;
+struct SnapshotTotals {
+    long long taken = 0;
+    long long failed = 0;
+    long long fork_ns_total = 0;
+    long long fork_ns_max = 0;
+    long long child_ns_total = 0;
+    long long window_ns_total = 0;   // Time a child was alive
+    long long window_faults = 0;     // Parent minor faults while a child was alive
+};
+SnapshotTotals snapshot_totals;
+
+// Consistent availability reads without locks. Single-train changes bump that train's version;
+// multi-train commits (itineraries) additionally advance this global commit epoch, begun on
+// entry and done on exit. A reader whose collect overlapped no multi-train commit
+// (begun == done seen across it) and whose validation pass saw no version change has read
+// every train at one common instant.
+std::atomic<std::uint64_t> multi_commits_begun{0};
+std::atomic<std::uint64_t> multi_commits_done{0};
+
+struct ConsistentReadStats {
+    long long reads = 0;
+    long long passes = 0;        // Full validation passes over all trains
+    long long train_rereads = 0; // Trains whose version moved during a pass
+    long long epoch_retries = 0; // Restarts because a multi-train commit overlapped
+    long long gave_up = 0;       // Not validated within CONSISTENT_READ_MAX_PASSES
+};
+std::mutex consistent_read_mutex; // Protects consistent_read_totals
+ConsistentReadStats consistent_read_totals;
+
+bool live_report_enabled = false;
+std::mutex live_report_mutex;
+std::condition_variable live_report_cond;
+bool live_report_running = false;
+std::thread live_report_thread;
+
+// Max tree over train_state's seats (--availability-tree), refreshed after every committed
+// change, so "next train with space" and "emptiest trains" walk log(trains) nodes instead of
+// every train.
+bool availability_tree_enabled = false;
+AvailabilityTree availability_tree;
+
+// System-wide occupancy, kept current by every train_state and held_seats writer through
+// per-thread shards and summed on read (read_occupancy), so polling it never walks the trains
+// or takes a train_mutex. Sold out means no seat available (transiently negative with the atomic
+// engine counts too).
+enum OccupancyField {
+    OCCUPANCY_AVAILABLE_SEATS,
+    OCCUPANCY_HELD_SEATS,
+    OCCUPANCY_SOLD_OUT_TRAINS,
+    OCCUPANCY_FIELDS
+};
+ShardedCounters<OCCUPANCY_FIELDS> occupancy;
+
+// Inquiry coalescing (--coalesce-inquiries): inquiries on a train that arrive while another
+// inquiry on it still waits for admission or the train lock share that inquiry's read and skip
+// the gate and the lock themselves (see single_flight.h).
+bool coalesce_inquiries = false;
+SingleFlight<int> inquiry_flights;
+typedef SingleFlight<int>::Ticket InquiryTicket;
+struct CoalescingStats {
+    std::atomic<long long> inquiries{0};
+    std::atomic<long long> coalesced{0}; // Answered by another inquiry's read
+};
+CoalescingStats coalescing_stats;
+
+struct OccupancySummary {
+    long long available = 0;
+    long long held = 0;
+    long long booked = 0; // Neither available nor held
+    long long sold_out = 0;
+    double load_factor = 0; // (booked + held) / total capacity
+};
 
 // 2. Resources for Global Load Management (Condition Variable Logic)
 std::mutex access_mutex; // Protects the access_count
 std::condition_variable access_cond; // Signals when an access slot is freed
 int active_access_count = 0; // Current number of threads inside the critical region
+// With --shm=NAME train_state, train_mutex and the admission limit live in a shared-memory
+// table that several simulation processes book against at once.
+SharedTrainTable shared_table;
+bool shared_enabled = false;
 
 // 3. Thread Management Variables
 std::thread threads[MAX_THREADS];
@@ -35,142 +311,4521 @@ int num_threads = 0;
 // 4. Output Control
 std::mutex print_mutex;
 
+// Binary event log (--event-log=PATH): each event is encoded instead of printed as a line;
+// --decode-events PATH renders the lines afterwards. Protected by print_mutex, like cout.
+EventLogWriter event_log;
+const std::chrono::steady_clock::time_point event_epoch = std::chrono::steady_clock::now();
+
+// 5. Waitlists (one per train, protected by the train's lock). Allocated on first use: a ring is
+// ~0.5 KiB, and most trains never have anyone waiting.
+struct WaitlistEntry {
+    int thread_num;   // Requesting thread, for the log line on promotion
+    int seats;        // Seats still wanted
+    std::chrono::steady_clock::time_point enqueued_at;
+};
+typedef BoundedRing<WaitlistEntry, WAITLIST_CAPACITY> Waitlist;
+std::unique_ptr<std::unique_ptr<Waitlist>[]> waitlist;
+std::unique_ptr<std::atomic<int>[]> waitlist_depth; // Lock-free hint: lets cancellations skip empty waitlists
+std::atomic<long long> waitlists_allocated{0};
+
+// Waitlist instrumentation. Updated under different train locks, hence atomics.
+struct WaitlistStats {
+    std::atomic<long long> enqueued{0};
+    std::atomic<long long> rejected_full{0};   // Opted in but the ring was full
+    std::atomic<long long> promoted{0};
+    std::atomic<long long> promotion_ns_total{0};
+    std::atomic<long long> promotion_ns_max{0};
+    std::atomic<long long> depth_max{0};
+};
+WaitlistStats waitlist_stats;
+
+// 6. Temporary seat holds (hold -> pay -> confirm)
+// Held seats are already taken out of train_state; held_seats tracks them so that
+// cancellations never "cancel" seats that are merely on hold. Atomic because lock-free
+// cancellations read it; it is raised before seats are taken and lowered after they come
+// back, so a racing reader can only under-estimate what may be cancelled.
+std::unique_ptr<std::atomic<int>[]> held_seats_memory;
+std::atomic<int>* held_seats = nullptr; // Shared table's counters with --shm
+
+typedef std::uint64_t HoldId; // (generation << 32) | (slot + 1); 0 means "no hold"
+struct Hold {
+    int train_num;
+    int seats;
+    std::uint32_t generation;
+    bool active;
+    TimerWheel::TimerId timer;
+};
+
+// Lock order: train_mutex -> print_mutex -> hold_mutex. Expiry drops hold_mutex before
+// taking any train_mutex, so it never nests the other way round.
+std::mutex hold_mutex; // Protects hold_table, hold_free_slots and hold_wheel
+std::vector<Hold> hold_table;
+std::vector<std::uint32_t> hold_free_slots;
+TimerWheel hold_wheel;
+const std::chrono::steady_clock::time_point hold_epoch = std::chrono::steady_clock::now();
+
+std::atomic<bool> hold_expiry_running{false};
+std::thread hold_expiry_thread;
+
+struct HoldStats {
+    std::atomic<long long> placed{0};
+    std::atomic<long long> rejected{0};      // Not enough seats to hold
+    std::atomic<long long> confirmed{0};
+    std::atomic<long long> released{0};      // Cancelled explicitly by the holder
+    std::atomic<long long> expired{0};       // Released by the timer wheel
+    std::atomic<long long> late_confirms{0}; // Payment arrived after the hold expired
+    std::atomic<long long> outstanding_max{0};
+};
+HoldStats hold_stats;
+
+// 7. Multi-train itineraries
+struct ItineraryLeg {
+    int train_num;
+    int seats;
+    int remaining; // Filled in on commit: seats left on that train afterwards
+};
+
+// Plain counters so benchmark threads can keep private copies; the simulation merges into
+// itinerary_totals after every query.
+struct ItineraryStats {
+    long long attempts = 0;
+    long long committed = 0;
+    long long aborted = 0;           // Some leg lacked seats; nothing was reserved
+    long long retries = 0;           // Alternative connections tried after an abort
+    long long cancel_rejected = 0;   // A train could not take its seats back, or a lock-free engine; still booked
+    long long lock_acquisitions = 0;
+    long long lock_contended = 0;    // try_lock failed and the thread had to block
+};
+std::mutex itinerary_stats_mutex;
+ItineraryStats itinerary_totals;
+
 // --- HELPER FUNCTIONS (Unchanged) ---
 int get_random_train() {
-    return std::rand() % MAX_TRAINS;
+    return std::rand() % num_trains;
 }
 
 int get_random_bookings() {
     return std::rand() % (BOOK_MAX - BOOK_MIN + 1) + BOOK_MIN;
 }
 
-void print_query(int thread_num, int type, int train_num, const string& action) {
+void print_actor(std::ostream& out, int actor) {
+    if (actor == EVENT_ACTOR_HOLD_EXPIRY) out << "Hold expiry";
+    else out << "Thread " << actor;
+}
+
+// Renders an event as the line the simulation prints for it (without the newline).
+void render_event(std::ostream& out, const Event& e) {
+    print_actor(out, e.actor);
+    out << ": ";
+    switch (e.kind) {
+        case EVENT_WAITING:
+        case EVENT_GAINED:
+            out << (e.kind == EVENT_WAITING ? "WAITING for system access." : "GAINED system access.");
+            if (e.aux == 1) out << " Inquiry";
+            else if (e.aux == 2) out << " Booking";
+            else if (e.aux == 3) out << " Cancellation";
+            else if (e.aux == 4) out << " Hold";
+            else if (e.aux == 5) out << " Itinerary";
+            out << " on Train " << e.train_num;
+            break;
+        case EVENT_INQUIRY:
+            out << "Train " << e.train_num << " has " << e.count << " seats available.";
+            break;
+        case EVENT_BOOKED:
+            out << "SUCCESSFULLY BOOKED " << e.count << " seats in Train " << e.train_num
+                << ". Remaining: " << e.remaining;
+            break;
+        case EVENT_FAILED:
+            out << "FAILED to " << (e.aux == 4 ? "hold" : "book") << " in Train " << e.train_num << ".";
+            break;
+        case EVENT_CANCELLED:
+            out << "SUCCESSFULLY CANCELLED " << e.count << " seats in Train " << e.train_num
+                << ". Remaining: " << e.remaining;
+            break;
+        case EVENT_NOTHING_TO_CANCEL:
+            out << "Train " << e.train_num << " has no bookings to cancel.";
+            break;
+        case EVENT_HELD:
+            out << "HELD " << e.count << " seats in Train " << e.train_num << " for " << HOLD_TTL_MS
+                << " ms. Remaining: " << e.remaining;
+            break;
+        case EVENT_CONFIRMED:
+            out << "CONFIRMED held seats in Train " << e.train_num << ".";
+            break;
+        case EVENT_HOLD_UNPAID:
+            out << "Hold in Train " << e.train_num << " EXPIRED before payment.";
+            break;
+        case EVENT_RELEASED:
+            out << "RELEASED " << e.count << " held seats in Train " << e.train_num << ". Remaining: " << e.remaining;
+            break;
+        case EVENT_PROMOTED:
+            out << "PROMOTED waitlisted request of Thread " << e.other << " (" << e.count << " seats) in Train "
+                << e.train_num << ". Remaining: " << e.remaining;
+            break;
+        case EVENT_WAITLISTED:
+            out << "WAITLISTED " << e.count << " seats in Train " << e.train_num << " at position "
+                << e.remaining << ".";
+            break;
+        case EVENT_WAITLIST_FULL:
+            out << "Waitlist for Train " << e.train_num << " is full.";
+            break;
+        case EVENT_ITINERARY_BOOKED:
+            out << "SUCCESSFULLY BOOKED itinerary of " << e.count << " seats on Trains";
+            for (int i = 0; i < e.aux; i++) {
+                out << (i > 0 ? " ->" : "") << " " << e.legs[i][0] << " (" << e.legs[i][1] << " left)";
+            }
+            break;
+        case EVENT_ITINERARY_FAILED:
+            out << "FAILED to book itinerary from Train " << e.train_num << " after " << e.count << " retries.";
+            break;
+    }
+}
+
+Event make_event(EventKind kind, int actor, int train_num, int count = 0, int remaining = 0) {
+    Event event;
+    event.kind = kind;
+    event.actor = actor;
+    event.train_num = train_num;
+    event.count = count;
+    event.remaining = remaining;
+    return event;
+}
+
+// Caller holds print_mutex. Prints the event's line, or logs it in binary with --event-log.
+void emit_event(Event event) {
+    if (event_log.is_open()) {
+        event.time_us = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - event_epoch).count());
+        event_log.append(event);
+    } else {
+        render_event(cout, event);
+        cout << endl;
+    }
+}
+
+void print_query(int thread_num, int type, int train_num, EventKind kind) {
     lock_guard<std::mutex> lock(print_mutex);
-    cout << "Thread " << thread_num << ": " << action;
-    if (type == 1) cout << " Inquiry";
-    else if (type == 2) cout << " Booking";
-    else if (type == 3) cout << " Cancellation";
-    cout << " on Train " << train_num << endl;
+    Event event = make_event(kind, thread_num, train_num);
+    event.aux = static_cast<std::uint8_t>(type);
+    emit_event(event);
 }
 
-// --- WORKER THREAD (FIXED) ---
-void worker_thread(int thread_num) {
-    auto start = std::chrono::steady_clock::now();
+// Lock-free running maximum for the instrumentation counters.
+void atomic_store_max(std::atomic<long long>& target, long long value) {
+    long long current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+// --- SEAT STATE AND ENGINES ---
+inline std::uint64_t pack_state(int seats, std::uint32_t version) {
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(seats)) << 32) | version;
+}
+inline int state_seats(std::uint64_t state) { return static_cast<std::int32_t>(state >> 32); }
+inline std::uint32_t state_version(std::uint64_t state) { return static_cast<std::uint32_t>(state); }
+
+// Serial-number comparison, so versions keep ordering correctly across a wrap.
+inline bool version_at_least(std::uint32_t version, std::uint32_t than) {
+    return static_cast<std::int32_t>(version - than) >= 0;
+}
+
+int seats_available(int train_num) {
+    return state_seats(train_state[train_num].load(std::memory_order_acquire));
+}
+
+// Called by every train_state writer below once its change has committed.
+inline void seats_changed(int train_num, int before, int after) {
+    occupancy.add(OCCUPANCY_AVAILABLE_SEATS, after - before);
+    if ((before <= 0) != (after <= 0)) occupancy.add(OCCUPANCY_SOLD_OUT_TRAINS, after <= 0 ? 1 : -1);
+    if (availability_tree_enabled) availability_tree.update(static_cast<std::size_t>(train_num));
+}
+
+// Every change of held_seats goes through here.
+inline void adjust_held_seats(int train_num, int delta) {
+    held_seats[train_num].fetch_add(delta, std::memory_order_acq_rel);
+    occupancy.add(OCCUPANCY_HELD_SEATS, delta);
+}
+
+// Recounts the occupancy aggregates from train_state and held_seats, after they were loaded or
+// reset in bulk. Not concurrent with writers.
+void recount_occupancy() {
+    long long initial[OCCUPANCY_FIELDS] = {};
+    for (int i = 0; i < num_trains; i++) {
+        int seats = seats_available(i);
+        initial[OCCUPANCY_AVAILABLE_SEATS] += seats;
+        initial[OCCUPANCY_HELD_SEATS] += held_seats[i].load(std::memory_order_relaxed);
+        if (seats <= 0) initial[OCCUPANCY_SOLD_OUT_TRAINS]++;
+    }
+    occupancy.reset(initial);
+}
+
+void finish_occupancy(OccupancySummary& summary) {
+    long long capacity = static_cast<long long>(num_trains) * CAPACITY;
+    summary.booked = capacity - summary.available - summary.held;
+    summary.load_factor = static_cast<double>(summary.booked + summary.held) / capacity;
+}
+
+// The same figures the slow way, from every train.
+OccupancySummary walk_occupancy() {
+    OccupancySummary summary;
+    for (int i = 0; i < num_trains; i++) {
+        int seats = seats_available(i);
+        summary.available += seats;
+        summary.held += held_seats[i].load(std::memory_order_acquire);
+        if (seats <= 0) summary.sold_out++;
+    }
+    finish_occupancy(summary);
+    return summary;
+}
+
+// Every process of a --shm table books against the same train_state, so there the aggregates
+// would only see this process's share; walk the table instead.
+OccupancySummary read_occupancy() {
+    if (shared_enabled) return walk_occupancy();
+    long long totals[OCCUPANCY_FIELDS];
+    occupancy.sum_all(totals);
+    OccupancySummary summary;
+    summary.available = totals[OCCUPANCY_AVAILABLE_SEATS];
+    summary.held = totals[OCCUPANCY_HELD_SEATS];
+    summary.sold_out = totals[OCCUPANCY_SOLD_OUT_TRAINS];
+    finish_occupancy(summary);
+    return summary;
+}
+
+void append_journal_record(JournalOp op, int train_num, int seats, std::uint64_t state_after, std::uint64_t hold_id) {
+    // Built in place in the journal's batch buffer. Every record has the same size, so each
+    // one stays 32-byte aligned in the page-aligned buffer.
+    journal_last_seq = journal.append_in_place(sizeof(JournalRecord), [&](char* dst) {
+        JournalRecord* record = new (dst) JournalRecord();
+        record->hold_id = hold_id;
+        record->train_num = train_num;
+        record->seats = seats;
+        record->seats_after = state_seats(state_after);
+        record->version_after = state_version(state_after);
+        record->op = op;
+        record->crc = journal_record_crc(*record);
+    });
+}
+
+// Appends one journal record for a state change that just committed. Cheap no-op without --wal.
+void journal_state(JournalOp op, int train_num, int seats, std::uint64_t state_after, std::uint64_t hold_id = 0) {
+    if (!journal_enabled) return;
+    append_journal_record(op, train_num, seats, state_after, hold_id);
+    journal_last_ack = {static_cast<std::uint32_t>(train_num), 0, state_after};
+}
+
+// Appends a record that changes no train_state word (HOLD_CONFIRM). Its state word is left zero
+// and replay never applies it, so whatever the live word holds meanwhile cannot reach recovery.
+void journal_bookkeeping(JournalOp op, int train_num, int seats, std::uint64_t hold_id) {
+    if (!journal_enabled) return;
+    append_journal_record(op, train_num, seats, 0, hold_id);
+}
+
+// Replay rule shared by recovery and the durable hook: a record replaces its train's word unless
+// the word is newer. Every journaled change is a CAS that bumps the version by one, so a
+// train's records never share a version within 2^32 changes.
+inline bool apply_state_word(std::atomic<std::uint64_t>& word, std::uint64_t state) {
+    std::uint64_t current = word.load(std::memory_order_relaxed);
+    if (!version_at_least(state_version(state), state_version(current))) return false;
+    word.store(state, std::memory_order_relaxed);
+    return true;
+}
+inline bool apply_journal_record(std::atomic<std::uint64_t>& word, const JournalRecord& record) {
+    if (record.op == JOURNAL_HOLD_CONFIRM) return false; // Bookkeeping only, no state word
+    return apply_state_word(word, pack_state(record.seats_after, record.version_after));
+}
+
+// WAL durable hook (writer thread): moves durable_state past every record of a synced batch.
+void journal_durable_hook(const char* data, std::size_t size) {
+    for (std::size_t offset = 0; offset + sizeof(JournalRecord) <= size; offset += sizeof(JournalRecord)) {
+        JournalRecord record;
+        std::memcpy(&record, data + offset, sizeof(record));
+        apply_journal_record(durable_state[record.train_num], record);
+    }
+}
+
+// Blocks until every record this thread appended is durable. Called with no locks held, so
+// all threads committing meanwhile share one fdatasync. False if the journal failed: the
+// requests behind those records must be rejected, not acknowledged.
+bool journal_wait() {
+    if (journal_last_seq == 0) return true;
+    bool durable = journal.wait_durable(journal_last_seq);
+    journal_last_seq = 0;
+    return durable;
+}
+
+void print_journal_stats() {
+    WalWriter::Stats stats = journal.stats();
+    long long batches = stats.batches > 0 ? stats.batches : 1;
+    cout << "\n--- Journal Statistics (" << WalWriter::io_mode_name(journal.io_mode()) << ") ---\n";
+    cout << "Records:               " << stats.records << " (" << stats.bytes << " bytes)" << endl;
+    cout << "Group commits:         " << stats.batches << endl;
+    cout << "Batch size:            avg " << static_cast<double>(stats.records) / batches
+         << " records, max " << stats.batch_records_max << endl;
+    cout << "Flush latency:         avg " << stats.flush_ns_total / batches / 1000
+         << " us, max " << stats.flush_ns_max / 1000 << " us (write + data sync)" << endl;
+    cout << "Buffer-full waits:     " << stats.buffer_full_waits << endl;
+    if (journal.has_failed()) cout << "WARNING: journal write or fdatasync FAILED; bookings are not durable" << endl;
+}
+
+// Seats that may still be cancelled: neither available, nor on hold, nor in a booking that has
+// not settled.
+int seats_booked(int train_num) {
+    return CAPACITY - seats_available(train_num) - held_seats[train_num].load(std::memory_order_acquire) -
+           booking_seats[train_num].load(std::memory_order_acquire);
+}
 
+// Conditional take: succeeds only if at least `seats` are available when the CAS lands.
+// Under train_mutex with the mutex engine the first CAS always succeeds.
+bool try_take_seats(int train_num, int seats, JournalOp op, EngineStats* stats = nullptr,
+                    std::uint64_t hold_id = 0) {
+    std::uint64_t state = train_state[train_num].load(std::memory_order_acquire);
     while (true) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(std::rand() % 500));
-        int train_num = get_random_train();
-        int type = std::rand() % 3 + 1;
+        int available = state_seats(state);
+        if (available < seats) return false;
+        std::uint64_t next = pack_state(available - seats, state_version(state) + 1);
+        if (train_state[train_num].compare_exchange_strong(state, next, std::memory_order_acq_rel,
+                                                           std::memory_order_acquire)) {
+            journal_state(op, train_num, seats, next, hold_id);
+            seats_changed(train_num, available, available - seats);
+            return true;
+        }
+        if (stats != nullptr) stats->conflicts++;
+    }
+}
 
-        // Check time limit before starting a new request
-        auto now = std::chrono::steady_clock::now();
-        auto elapsed_seconds = std::chrono::duration_cast<std::chrono::seconds>(now - start);
-        if (elapsed_seconds.count() >= MAX_TIME * 60) {
-            break;
+// Conditional give-back: succeeds only while the seats are still booked, i.e. the train would
+// not end up with more than CAPACITY minus held seats available once every unsettled
+// plain-atomic take is counted back in. Those are read after the word, so the count covers
+// every take inside it (takes that settled since then changed the word, and the CAS retries);
+// takes not in the word yet only make the check stricter.
+bool try_return_seats(int train_num, int seats, JournalOp op, EngineStats* stats = nullptr) {
+    std::uint64_t state = train_state[train_num].load(std::memory_order_acquire);
+    while (true) {
+        int available = state_seats(state) + booking_seats[train_num].load(std::memory_order_acquire);
+        if (available + seats > CAPACITY - held_seats[train_num].load(std::memory_order_acquire)) return false;
+        available = state_seats(state);
+        std::uint64_t next = pack_state(available + seats, state_version(state) + 1);
+        if (train_state[train_num].compare_exchange_strong(state, next, std::memory_order_acq_rel,
+                                                           std::memory_order_acquire)) {
+            journal_state(op, train_num, seats, next);
+            seats_changed(train_num, available, available + seats);
+            return true;
         }
+        if (stats != nullptr) stats->conflicts++;
+    }
+}
 
-        // --- PHASE 1: GLOBAL LOAD CONTROL (Using Condition Variable) ---
-        { // Start a new scope for unique_lock
-            print_query(thread_num, type, train_num, "WAITING for system access.");
+// Unconditional give-back of seats the caller took earlier (held seats, a rolled-back leg),
+// committed and journaled with a CAS like the conditional changes above.
+void give_back_seats(int train_num, int seats, JournalOp op, std::uint64_t hold_id = 0) {
+    std::uint64_t state = train_state[train_num].load(std::memory_order_acquire);
+    while (true) {
+        int available = state_seats(state);
+        std::uint64_t next = pack_state(available + seats, state_version(state) + 1);
+        if (train_state[train_num].compare_exchange_strong(state, next, std::memory_order_acq_rel,
+                                                           std::memory_order_acquire)) {
+            journal_state(op, train_num, seats, next, hold_id);
+            seats_changed(train_num, available, available + seats);
+            return;
+        }
+    }
+}
 
-            // Acquire access_mutex
-            std::unique_lock<std::mutex> load_lock(access_mutex);
+// Seat adjustment for the plain-atomic engine's bookings: one fetch_add moves the seat field by
+// `delta` and bumps the version. Returns the state before the add.
+//
+// Never journaled, and only used without a journal. A booking's speculative take can sit inside
+// any word read until it is compensated, a non-negative one included, so no word it might have
+// touched is a state recovery may restore.
+std::uint64_t fetch_add_seats(int train_num, int delta) {
+    std::uint64_t addend = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(delta)) << 32) + 1;
+    std::uint64_t before = train_state[train_num].fetch_add(addend, std::memory_order_acq_rel);
+    seats_changed(train_num, state_seats(before), state_seats(before + addend));
+    if (state_version(before) == UINT32_MAX) {
+        // The version wrapped and carried one into the seat field; take it back out.
+        std::uint64_t carry = std::uint64_t(1) << 32;
+        std::uint64_t fixed = train_state[train_num].fetch_sub(carry, std::memory_order_acq_rel) - carry;
+        seats_changed(train_num, state_seats(fixed + carry), state_seats(fixed));
+    }
+    return before;
+}
 
-            // Wait until an access slot is free (releases lock while waiting)
-            access_cond.wait(load_lock, [&]{
-                return active_access_count < MAX_CONCURRENT_ACCESS;
-            });
+// Engine entry points for one booking / cancellation. Return false when the request cannot
+// be served (not enough seats / not that many booked seats).
+bool engine_book(EngineMode mode, int train_num, int seats, EngineStats& stats) {
+    stats.operations++;
+    switch (mode) {
+        case ENGINE_MUTEX: {
+            std::unique_lock<RobustMutex> lock(train_mutex_of(train_num), std::try_to_lock);
+            if (!lock.owns_lock()) {
+                stats.conflicts++;
+                auto wait_start = std::chrono::steady_clock::now();
+                lock.lock();
+                stats.lock_wait_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - wait_start).count();
+            }
+            return try_take_seats(train_num, seats, JOURNAL_BOOK);
+        }
+        case ENGINE_ATOMIC: {
+            // With a journal every change must be a state worth recovering: commit with a CAS
+            if (journal_enabled) return try_take_seats(train_num, seats, JOURNAL_BOOK, &stats);
+            // Take first, check afterwards: a transient negative count is visible to readers.
+            booking_seats[train_num].fetch_add(seats, std::memory_order_acq_rel);
+            bool booked = state_seats(fetch_add_seats(train_num, -seats)) >= seats;
+            if (!booked) {
+                fetch_add_seats(train_num, seats);
+                stats.compensations++;
+            }
+            booking_seats[train_num].fetch_sub(seats, std::memory_order_acq_rel);
+            return booked;
+        }
+        case ENGINE_OCC:
+            return try_take_seats(train_num, seats, JOURNAL_BOOK, &stats);
+    }
+    return false;
+}
 
-            // Lock re-acquired, condition met.
-            active_access_count++; // Claim the slot
+bool engine_cancel(EngineMode mode, int train_num, int seats, EngineStats& stats) {
+    stats.operations++;
+    switch (mode) {
+        case ENGINE_MUTEX: {
+            std::unique_lock<RobustMutex> lock(train_mutex_of(train_num), std::try_to_lock);
+            if (!lock.owns_lock()) {
+                stats.conflicts++;
+                auto wait_start = std::chrono::steady_clock::now();
+                lock.lock();
+                stats.lock_wait_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - wait_start).count();
+            }
+            return try_return_seats(train_num, seats, JOURNAL_CANCEL);
+        }
+        // A speculative give-back would briefly create seats that bookings could take, so the
+        // plain-atomic engine cancels with the bounded CAS as well
+        case ENGINE_ATOMIC:
+        case ENGINE_OCC:
+            return try_return_seats(train_num, seats, JOURNAL_CANCEL, &stats);
+    }
+    return false;
+}
 
-            // load_lock is released here when scope ends, ensuring active_access_count is protected.
-        } // End of scope: load_lock releases access_mutex automatically.
+const char* engine_name(EngineMode mode) {
+    switch (mode) {
+        case ENGINE_MUTEX: return "mutex";
+        case ENGINE_ATOMIC: return "atomic";
+        case ENGINE_OCC: return "occ";
+    }
+    return "?";
+}
 
-        print_query(thread_num, type, train_num, "GAINED system access.");
+bool parse_wal_io(const char* name, WalWriter::IoMode& mode) {
+    if (std::strcmp(name, "write") == 0) mode = WalWriter::IO_WRITE;
+    else if (std::strcmp(name, "pwritev") == 0) mode = WalWriter::IO_PWRITEV;
+    else if (std::strcmp(name, "uring") == 0) mode = WalWriter::IO_URING;
+    else return false;
+    return true;
+}
 
-        // --- PHASE 2: LOCAL DATA INTEGRITY (Using Train Mutex) ---
+bool parse_engine(const char* name, EngineMode& mode) {
+    const EngineMode modes[] = {ENGINE_MUTEX, ENGINE_ATOMIC, ENGINE_OCC};
+    for (EngineMode candidate : modes) {
+        if (std::strcmp(name, engine_name(candidate)) == 0) {
+            mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void merge_engine_stats(EngineStats& total, const EngineStats& stats) {
+    total.operations += stats.operations;
+    total.conflicts += stats.conflicts;
+    total.compensations += stats.compensations;
+    total.lock_wait_ns += stats.lock_wait_ns;
+}
 
-        // Acquire lock for the specific train to ensure data integrity
-        std::lock_guard<std::mutex> train_lock(train_mutex[train_num]);
+void print_engine_stats(const EngineStats& stats) {
+    double operations = stats.operations > 0 ? static_cast<double>(stats.operations) : 1.0;
+    cout << "Operations:            " << stats.operations << endl;
+    cout << "Conflicts:             " << stats.conflicts << " (" << 100.0 * stats.conflicts / operations << "%)" << endl;
+    cout << "Compensations:         " << stats.compensations << " (" << 100.0 * stats.compensations / operations
+         << "%)" << endl;
+    cout << "Lock wait:             " << stats.lock_wait_ns / 1000000 << " ms" << endl;
+}
 
-        // Execute Query (Critical Section for data)
-        lock_guard<std::mutex> print_lock(print_mutex);
+// --- TRAIN TABLE ---
+// Sizes the train table for `trains` trains at full capacity, guarded by `stripes` locks rounded
+// up to a power of two (0: one per train, at most DEFAULT_MAX_LOCK_STRIPES). Replaces any
+// previous table, so only while no other thread is using it.
+void allocate_train_table(int trains, int stripes) {
+    num_trains = trains;
+    if (stripes <= 0) stripes = std::min(trains, DEFAULT_MAX_LOCK_STRIPES);
+    lock_stripes = 1;
+    while (lock_stripes < stripes) lock_stripes <<= 1;
+    train_mutex_memory.reset(new RobustMutex[lock_stripes]);
+    train_mutex = train_mutex_memory.get();
+    train_state_memory.reset(new std::atomic<std::uint64_t>[trains]);
+    train_state = train_state_memory.get();
+    for (int i = 0; i < trains; i++) train_state[i].store(pack_state(CAPACITY, 0), std::memory_order_relaxed);
+    held_seats_memory.reset(new std::atomic<int>[trains]());
+    held_seats = held_seats_memory.get();
+    booking_seats_memory.reset(new std::atomic<int>[trains]());
+    booking_seats = booking_seats_memory.get();
+    waitlist.reset(new std::unique_ptr<Waitlist>[trains]);
+    waitlist_depth.reset(new std::atomic<int>[trains]());
+    waitlists_allocated = 0;
+    durable_state.reset(new std::atomic<std::uint64_t>[static_cast<std::size_t>(trains) * STORE_DAYS]());
+}
 
-        switch (type) {
-            case 1: { // Inquiry (Read)
-                cout << "Thread " << thread_num << ": Train " << train_num
-                     << " has " << available_seats[train_num] << " seats available." << endl;
-                break;
-            }
-            case 2: { // Booking (Write)
-                int num_to_book = get_random_bookings();
-                if (available_seats[train_num] >= num_to_book) {
-                    available_seats[train_num] -= num_to_book;
-                    cout << "Thread " << thread_num << ": SUCCESSFULLY BOOKED " << num_to_book
-                         << " seats in Train " << train_num << ". Remaining: "
-                         << available_seats[train_num] << endl;
-                } else {
-                    cout << "Thread " << thread_num << ": FAILED to book in Train " << train_num << "." << endl;
-                }
-                break;
-            }
-            case 3: { // Cancellation (Write)
-                int booked_seats = CAPACITY - available_seats[train_num];
-                if (booked_seats > 0) {
-                    int num_to_cancel = std::rand() % booked_seats + 1;
-                    available_seats[train_num] += num_to_cancel;
-                    cout << "Thread " << thread_num << ": SUCCESSFULLY CANCELLED " << num_to_cancel
-                         << " seats in Train " << train_num << ". Remaining: "
-                         << available_seats[train_num] << endl;
-                } else {
-                    cout << "Thread " << thread_num << ": Train " << train_num
-                         << " has no bookings to cancel." << endl;
+// Bytes the train table takes right now, waitlists allocated so far included.
+std::size_t train_table_bytes() {
+    std::size_t per_train = sizeof(std::atomic<std::uint64_t>) * (1 + STORE_DAYS) + sizeof(std::atomic<int>) * 3 +
+                            sizeof(std::unique_ptr<Waitlist>);
+    return per_train * static_cast<std::size_t>(num_trains) + sizeof(RobustMutex) * static_cast<std::size_t>(lock_stripes) +
+           sizeof(Waitlist) * static_cast<std::size_t>(waitlists_allocated.load());
+}
+
+// --- SEAT STORE HELPERS ---
+// Checkpoints the store every checkpoint_interval_ms while bookings keep running. With a journal
+// the image is durable_state, so recovery never starts from a state the journal cannot explain.
+void checkpointer_loop() {
+    std::unique_lock<std::mutex> lock(checkpointer_mutex);
+    while (checkpointer_running) {
+        checkpointer_cond.wait_for(lock, std::chrono::milliseconds(checkpoint_interval_ms));
+        if (!checkpointer_running) break;
+        lock.unlock();
+        auto start = std::chrono::steady_clock::now();
+        if (seat_store.checkpoint(false, journal_enabled ? durable_state.get() : nullptr)) {
+            checkpoints_taken.fetch_add(1, std::memory_order_relaxed);
+            atomic_store_max(checkpoint_ns_max, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+        } else {
+            lock_guard<std::mutex> print_lock(print_mutex);
+            cerr << "Checkpoint failed: " << seat_store.last_error() << endl;
+        }
+        lock.lock();
+    }
+}
+
+// Takes one fork() snapshot of train_state into snapshot_path.
+void take_snapshot() {
+    ForkSnapshotResult result = fork_snapshot(static_cast<const void*>(train_state),
+                                              num_trains * sizeof(std::uint64_t), snapshot_path);
+    if (!result.ok) {
+        snapshot_totals.failed++;
+        return;
+    }
+    snapshot_totals.taken++;
+    snapshot_totals.fork_ns_total += result.fork_ns;
+    snapshot_totals.fork_ns_max = std::max(snapshot_totals.fork_ns_max, result.fork_ns);
+    snapshot_totals.child_ns_total += result.child_ns;
+    snapshot_totals.window_ns_total += result.total_ns;
+    snapshot_totals.window_faults += result.parent_minor_faults;
+}
+
+// Snapshots train_state every SNAPSHOT_INTERVAL_MS while bookings keep running.
+void snapshotter_loop() {
+    std::unique_lock<std::mutex> lock(snapshotter_mutex);
+    while (snapshotter_running) {
+        snapshotter_cond.wait_for(lock, std::chrono::milliseconds(SNAPSHOT_INTERVAL_MS));
+        if (!snapshotter_running) break;
+        lock.unlock();
+        take_snapshot();
+        lock.lock();
+    }
+}
+
+void print_snapshot_stats(long long run_ns, long long run_faults) {
+    const SnapshotTotals& totals = snapshot_totals;
+    long long taken = totals.taken > 0 ? totals.taken : 1;
+    cout << "\n--- Snapshot Statistics ---\n";
+    cout << "Snapshots:             " << totals.taken << " (" << totals.failed << " failed) -> " << snapshot_path << endl;
+    cout << "fork() pause:          avg " << totals.fork_ns_total / taken / 1000
+         << " us, max " << totals.fork_ns_max / 1000 << " us" << endl;
+    cout << "Snapshot duration:     avg " << totals.window_ns_total / taken / 1000 << " us (child serialization "
+         << totals.child_ns_total / taken / 1000 << " us)" << endl;
+
+    // Copy-on-write overhead: parent fault rate while a child was alive vs. the rest of the run
+    double window_s = totals.window_ns_total / 1e9;
+    double rest_s = (run_ns - totals.window_ns_total) / 1e9;
+    cout << "Parent minor faults:   " << totals.window_faults << " during snapshots";
+    if (window_s > 0 && rest_s > 0) {
+        cout << " (" << totals.window_faults / window_s << "/s vs " << (run_faults - totals.window_faults) / rest_s
+             << "/s otherwise)";
+    }
+    cout << endl;
+}
+
+// --show-snapshot PATH: renders a snapshot file as a reservation chart.
+int show_snapshot(const char* path) {
+    std::vector<unsigned char> payload;
+    if (!load_snapshot(path, payload)) {
+        cerr << "Cannot read snapshot " << path << " (missing, truncated or checksum mismatch)" << endl;
+        return 1;
+    }
+    std::size_t trains = payload.size() / sizeof(std::uint64_t);
+    cout << "--- Reservation Chart (snapshot " << path << ") ---\n";
+    cout << "    Train number    Available Seats\n";
+    for (std::size_t i = 0; i < trains; i++) {
+        std::uint64_t state;
+        std::memcpy(&state, payload.data() + i * sizeof(state), sizeof(state));
+        cout << "        " << i << "                " << state_seats(state) << endl;
+    }
+    return 0;
+}
+
+// Restart-time benchmark: creates a store of trains x days slots at `path`, then measures a
+// checkpoint, a clean restart (single mmap) and a restart after a simulated crash.
+int bench_store(const char* path, std::uint32_t trains, std::uint32_t days) {
+    typedef std::chrono::steady_clock clock;
+    auto ms_since = [](clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count() / 1000.0;
+    };
+    ::unlink(path);
+    cout << "--- Seat store benchmark: " << trains << " trains x " << days << " days ---\n";
+
+    clock::time_point start = clock::now();
+    SeatStore* store = new SeatStore();
+    if (store->open(path, trains, days, pack_state(CAPACITY, 0)) != SeatStore::STORE_CREATED) {
+        cerr << "Cannot create store: " << store->last_error() << endl;
+        return 1;
+    }
+    cout << "File size:             " << store->file_bytes() / (1024 * 1024) << " MiB" << endl;
+    cout << "Create + populate:     " << ms_since(start) << " ms" << endl;
+
+    // Touch every 7th slot so checkpoints do not see a uniform image
+    for (std::size_t i = 0; i < store->num_slots(); i += 7) store->slots()[i].store(pack_state(CAPACITY - 1, 1));
+    start = clock::now();
+    store->checkpoint(true);
+    cout << "Clean checkpoint:      " << ms_since(start) << " ms" << endl;
+    delete store;
+
+    start = clock::now();
+    store = new SeatStore();
+    SeatStore::OpenResult result = store->open(path, trains, days, 0);
+    double clean_ms = ms_since(start);
+    cout << "Clean restart:         " << clean_ms << " ms"
+         << (result == SeatStore::STORE_CLEAN ? "" : " (UNEXPECTED: not reused)") << endl;
+
+    // Crash: change the live region and drop the mapping without a clean checkpoint
+    for (std::size_t i = 0; i < store->num_slots(); i += 11) store->slots()[i].store(pack_state(0, 2));
+    delete store;
+
+    start = clock::now();
+    store = new SeatStore();
+    result = store->open(path, trains, days, 0);
+    cout << "Crash restart:         " << ms_since(start) << " ms"
+         << (result == SeatStore::STORE_RECOVERED ? "" : " (UNEXPECTED: not recovered)") << endl;
+    bool restored = state_seats(store->slots()[7].load()) == CAPACITY - 1 &&
+                    state_seats(store->slots()[11].load()) == CAPACITY;
+    cout << "Restored image:        " << (restored ? "matches last checkpoint" : "MISMATCH") << endl;
+    delete store;
+    ::unlink(path);
+    return restored ? 0 : 1;
+}
+
+// --- CONSISTENT SNAPSHOT HELPERS ---
+// Marks a multi-train commit for consistent readers; see multi_commits_begun.
+struct MultiTrainCommit {
+    MultiTrainCommit() { multi_commits_begun.fetch_add(1, std::memory_order_seq_cst); }
+    ~MultiTrainCommit() { multi_commits_done.fetch_add(1, std::memory_order_seq_cst); }
+};
+
+// Reads the state word of every train as of one instant, without taking any lock.
+// Double collect: a validation pass that finds every version unchanged proves that the
+// collected words coexisted. Trains that moved are re-read in place and validated again.
+// Returns false (with a best-effort result) if writers kept winning for too long.
+bool read_consistent_states(std::uint64_t* states, int num_trains, ConsistentReadStats& stats) {
+    stats.reads++;
+    int passes = 0;
+    while (passes < CONSISTENT_READ_MAX_PASSES) {
+        std::uint64_t done_before = multi_commits_done.load(std::memory_order_seq_cst);
+        for (int i = 0; i < num_trains; i++) states[i] = train_state[i].load(std::memory_order_seq_cst);
+
+        bool changed = true;
+        while (changed && passes < CONSISTENT_READ_MAX_PASSES) {
+            changed = false;
+            passes++;
+            stats.passes++;
+            for (int i = 0; i < num_trains; i++) {
+                std::uint64_t again = train_state[i].load(std::memory_order_seq_cst);
+                if (again != states[i]) {
+                    states[i] = again;
+                    stats.train_rereads++;
+                    changed = true;
                 }
-                break;
             }
         }
-        // train_lock and print_lock are released here.
+        if (changed) break; // Out of passes
 
-        // --- PHASE 3: RELEASE GLOBAL ACCESS (Signaling) ---
+        if (multi_commits_begun.load(std::memory_order_seq_cst) == done_before) return true;
+        stats.epoch_retries++;
+    }
+    stats.gave_up++;
+    return false;
+}
 
-        { // Start a new scope for load_lock
-            // Re-acquire the global load lock to safely decrement the counter
-            std::lock_guard<std::mutex> release_lock(access_mutex);
-            active_access_count--; // Release the slot
-        } // End of scope: release_lock releases access_mutex automatically.
+// "Which trains have at least min_seats seats": searches one consistent read of train_state
+// (see read_consistent_states) with the vectorized seat_search_words and leaves the matching
+// train numbers, ascending, in `trains`. `states` is scratch space the caller may reuse across
+// searches. Returns false if the read could not be validated; the result is then best-effort.
+bool find_trains_with_seats(int min_seats, std::vector<std::uint64_t>& states, std::vector<std::uint32_t>& trains,
+                            ConsistentReadStats& stats) {
+    states.resize(num_trains);
+    trains.resize(num_trains);
+    bool consistent = read_consistent_states(states.data(), num_trains, stats);
+    trains.resize(seat_search_words(states.data(), states.size(), min_seats, trains.data()));
+    return consistent;
+}
 
-        // Signal one waiting thread that a slot in the global access pool is free
-        access_cond.notify_one();
+// --live-report: prints system-wide availability from a consistent read every LIVE_REPORT_MS.
+void live_report_loop() {
+    std::vector<std::uint64_t> states(num_trains);
+    std::vector<std::pair<int, std::uint32_t>> emptiest;
+    std::unique_lock<std::mutex> lock(live_report_mutex);
+    while (live_report_running) {
+        live_report_cond.wait_for(lock, std::chrono::milliseconds(LIVE_REPORT_MS));
+        if (!live_report_running) break;
+        lock.unlock();
 
-        // Time check moved to the start of the loop for cleaner structure.
+        ConsistentReadStats stats;
+        bool consistent = read_consistent_states(states.data(), num_trains, stats);
+        long long available = 0;
+        int sold_out = 0;
+        for (std::uint64_t state : states) {
+            available += state_seats(state);
+            if (state_seats(state) <= 0) sold_out++; // Below 0: a plain-atomic overshoot not yet compensated
+        }
+        {
+            lock_guard<std::mutex> print_lock(print_mutex);
+            cout << "LIVE REPORT: " << available << " seats available across " << num_trains << " trains, "
+                 << sold_out << " sold out (" << (consistent ? "consistent" : "NOT validated") << ", "
+                 << stats.passes << " passes)" << endl;
+            OccupancySummary summary = read_occupancy();
+            cout << "LIVE REPORT: occupancy " << std::fixed << std::setprecision(1) << 100 * summary.load_factor
+                 << "% (" << summary.booked << " booked, " << summary.held << " held, " << summary.sold_out
+                 << " sold out; from the aggregates)" << std::defaultfloat << endl;
+            if (availability_tree_enabled) {
+                availability_tree.top_k(3, emptiest);
+                cout << "LIVE REPORT: emptiest trains:";
+                for (const std::pair<int, std::uint32_t>& train : emptiest) {
+                    cout << " " << train.second << " (" << train.first << " seats)";
+                }
+                cout << endl;
+            }
+        }
+        {
+            lock_guard<std::mutex> stats_lock(consistent_read_mutex);
+            consistent_read_totals.reads += stats.reads;
+            consistent_read_totals.passes += stats.passes;
+            consistent_read_totals.train_rereads += stats.train_rereads;
+            consistent_read_totals.epoch_retries += stats.epoch_retries;
+            consistent_read_totals.gave_up += stats.gave_up;
+        }
+        lock.lock();
     }
 }
 
-// --- MAIN FUNCTION (Unchanged) ---
-int main() {
-    std::srand(std::time(nullptr));
-    for (int i = 0; i < MAX_TRAINS; i++) {
-        available_seats[i] = CAPACITY;
+void print_consistent_read_stats(const ConsistentReadStats& stats) {
+    long long reads = stats.reads > 0 ? stats.reads : 1;
+    cout << "Consistent reads:      " << stats.reads << " (" << stats.gave_up << " not validated)" << endl;
+    cout << "Validation passes:     avg " << static_cast<double>(stats.passes) / reads << endl;
+    cout << "Train re-reads:        " << stats.train_rereads << endl;
+    cout << "Epoch retries:         " << stats.epoch_retries << endl;
+}
+
+// --- WAITLIST HELPERS ---
+// Caller holds train_mutex_of(train_num) and print_mutex.
+// Returns the 1-based queue position, or 0 when the waitlist is full.
+int enqueue_waitlist(int train_num, int thread_num, int seats) {
+    if (!waitlist[train_num]) {
+        waitlist[train_num].reset(new Waitlist());
+        waitlists_allocated.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!waitlist[train_num]->push({thread_num, seats, std::chrono::steady_clock::now()})) {
+        waitlist_stats.rejected_full.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+    int depth = static_cast<int>(waitlist[train_num]->size());
+    waitlist_depth[train_num].store(depth, std::memory_order_release);
+    waitlist_stats.enqueued.fetch_add(1, std::memory_order_relaxed);
+    atomic_store_max(waitlist_stats.depth_max, depth);
+    return depth;
+}
+
+// Caller holds train_mutex_of(train_num) and print_mutex.
+// Promotes waitlisted requests in strict FIFO order: stops at the first head that does not fit,
+// so a large early request is never overtaken by smaller later ones.
+// `actor` is whoever freed the seats (a thread, or EVENT_ACTOR_HOLD_EXPIRY) for the log line.
+void promote_waitlist(int train_num, int actor) {
+    if (!waitlist[train_num]) return;
+    Waitlist& queue = *waitlist[train_num];
+    while (!queue.empty() && try_take_seats(train_num, queue.front().seats, JOURNAL_PROMOTE)) {
+        const WaitlistEntry& entry = queue.front();
+
+        long long waited_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - entry.enqueued_at).count();
+        waitlist_stats.promoted.fetch_add(1, std::memory_order_relaxed);
+        waitlist_stats.promotion_ns_total.fetch_add(waited_ns, std::memory_order_relaxed);
+        atomic_store_max(waitlist_stats.promotion_ns_max, waited_ns);
+
+        Event event = make_event(EVENT_PROMOTED, actor, train_num, entry.seats, seats_available(train_num));
+        event.other = entry.thread_num;
+        emit_event(event);
+        queue.pop();
+        waitlist_depth[train_num].store(static_cast<int>(queue.size()), std::memory_order_release);
     }
+}
 
-    // Creating and running the worker threads
-    for (int i = 0; i < MAX_THREADS; i++) {
-        threads[i] = std::thread(worker_thread, i);
-        num_threads++;
+// Caller holds train_mutex_of(train_num) and print_mutex, right after a failed booking.
+// Lets the passenger opt in to the waitlist. A lock-free cancellation may have freed seats
+// between the failed booking and the enqueue, so the queue is promoted once more afterwards.
+void offer_waitlist(int train_num, int thread_num, int seats) {
+    if (std::rand() % 100 >= WAITLIST_OPT_IN_PERCENT) return;
+    int position = enqueue_waitlist(train_num, thread_num, seats);
+    if (position > 0) {
+        emit_event(make_event(EVENT_WAITLISTED, thread_num, train_num, seats, position));
+        promote_waitlist(train_num, thread_num);
+    } else {
+        emit_event(make_event(EVENT_WAITLIST_FULL, thread_num, train_num));
     }
+}
 
-    // Wait for all threads to finish
-    for (int i = 0; i < num_threads; i++) {
-        threads[i].join();
+void print_waitlist_stats() {
+    long long promoted = waitlist_stats.promoted.load();
+    long long still_waiting = 0;
+    for (int i = 0; i < num_trains; i++) {
+        if (waitlist[i]) still_waiting += static_cast<long long>(waitlist[i]->size());
     }
 
-    cout << "\n--- Final Reservation Chart ---\n";
-    cout << "    Train number    Available Seats\n";
-    for(int i = 0; i < MAX_TRAINS; i++){
-        cout << "        " << i << "                " << available_seats[i] << endl;
+    cout << "\n--- Waitlist Statistics ---\n";
+    cout << "Enqueued:              " << waitlist_stats.enqueued.load() << endl;
+    cout << "Rejected (queue full): " << waitlist_stats.rejected_full.load() << endl;
+    cout << "Promoted:              " << promoted << endl;
+    cout << "Still waiting:         " << still_waiting << endl;
+    cout << "Max waitlist depth:    " << waitlist_stats.depth_max.load() << endl;
+    if (promoted > 0) {
+        cout << "Promotion latency:     avg " << waitlist_stats.promotion_ns_total.load() / promoted / 1000000
+             << " ms, max " << waitlist_stats.promotion_ns_max.load() / 1000000 << " ms" << endl;
     }
-    cout << "Thanks for using our services!!!\n";
+}
 
-    return 0;
+// --- HOLD HELPERS ---
+std::uint64_t hold_current_tick() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - hold_epoch).count() / HOLD_TICK_MS);
+}
+
+// Caller holds hold_mutex. Returns the slot to the free list and invalidates its HoldId.
+void free_hold_slot(std::uint32_t slot) {
+    hold_table[slot].active = false;
+    hold_table[slot].generation++;
+    hold_free_slots.push_back(slot);
+}
+
+// Caller holds hold_mutex. Looks up an active hold, or returns nullptr for stale ids.
+Hold* find_hold(HoldId id) {
+    std::uint32_t low = static_cast<std::uint32_t>(id);
+    if (low == 0 || low > hold_table.size()) return nullptr;
+    Hold& hold = hold_table[low - 1];
+    if (!hold.active || hold.generation != static_cast<std::uint32_t>(id >> 32)) return nullptr;
+    return &hold;
+}
+
+// Caller holds train_mutex_of(train_num).
+// Takes `seats` out of train_state for at most ttl_ms; returns 0 if they are not available.
+HoldId place_hold(int train_num, int seats, int ttl_ms) {
+    std::lock_guard<std::mutex> lock(hold_mutex);
+    std::uint32_t slot;
+    if (!hold_free_slots.empty()) {
+        slot = hold_free_slots.back();
+        hold_free_slots.pop_back();
+    } else {
+        slot = static_cast<std::uint32_t>(hold_table.size());
+        hold_table.push_back(Hold{0, 0, 0, false, TimerWheel::INVALID_TIMER});
+    }
+    HoldId id = (std::uint64_t(hold_table[slot].generation) << 32) | (std::uint64_t(slot) + 1);
+
+    // Seats are counted as held before they leave train_state (see held_seats)
+    adjust_held_seats(train_num, seats);
+    if (!try_take_seats(train_num, seats, JOURNAL_HOLD, nullptr, id)) {
+        adjust_held_seats(train_num, -seats);
+        hold_free_slots.push_back(slot);
+        hold_stats.rejected.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    // The wheel may lag real time by up to one tick; schedule against the wall-clock deadline.
+    std::uint64_t deadline = hold_current_tick() + (ttl_ms + HOLD_TICK_MS - 1) / HOLD_TICK_MS;
+    std::uint64_t delay = deadline > hold_wheel.now() ? deadline - hold_wheel.now() : 0;
+
+    Hold& hold = hold_table[slot];
+    hold.train_num = train_num;
+    hold.seats = seats;
+    hold.active = true;
+    hold.timer = hold_wheel.schedule(delay, slot);
+
+    hold_stats.placed.fetch_add(1, std::memory_order_relaxed);
+    atomic_store_max(hold_stats.outstanding_max, static_cast<long long>(hold_wheel.armed()));
+    return id;
+}
+
+// Takes train_mutex_of(train_num) and print_mutex. Puts held seats back on sale.
+// `op` is JOURNAL_HOLD_RELEASE or JOURNAL_HOLD_EXPIRE.
+void return_held_seats(int train_num, int seats, HoldId id, JournalOp op, int actor) {
+    std::lock_guard<RobustMutex> train_lock(train_mutex_of(train_num));
+    std::lock_guard<std::mutex> print_lock(print_mutex);
+    give_back_seats(train_num, seats, op, id);
+    adjust_held_seats(train_num, -seats);
+    emit_event(make_event(EVENT_RELEASED, actor, train_num, seats, seats_available(train_num)));
+    promote_waitlist(train_num, actor);
+}
+
+// Turns a hold into a permanent booking. Returns false if the hold already expired.
+bool confirm_hold(HoldId id) {
+    int train_num, seats;
+    {
+        std::lock_guard<std::mutex> lock(hold_mutex);
+        Hold* hold = find_hold(id);
+        if (hold == nullptr) {
+            hold_stats.late_confirms.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        train_num = hold->train_num;
+        seats = hold->seats;
+        hold_wheel.cancel(hold->timer);
+        free_hold_slot(static_cast<std::uint32_t>(hold - hold_table.data()));
+    }
+    adjust_held_seats(train_num, -seats);
+    journal_bookkeeping(JOURNAL_HOLD_CONFIRM, train_num, seats, id);
+    hold_stats.confirmed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// Gives a hold back before its TTL. Returns false if it already expired.
+// Must not be called with any train_mutex held.
+bool release_hold(HoldId id, int actor) {
+    int train_num, seats;
+    {
+        std::lock_guard<std::mutex> lock(hold_mutex);
+        Hold* hold = find_hold(id);
+        if (hold == nullptr) return false;
+        train_num = hold->train_num;
+        seats = hold->seats;
+        hold_wheel.cancel(hold->timer);
+        free_hold_slot(static_cast<std::uint32_t>(hold - hold_table.data()));
+    }
+    return_held_seats(train_num, seats, id, JOURNAL_HOLD_RELEASE, actor);
+    hold_stats.released.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// Fires every hold due by `tick`. Expired holds are collected under hold_mutex and their seats
+// returned afterwards, so the wheel is never held while waiting for a train lock.
+void expire_holds_until(std::uint64_t tick) {
+    std::vector<std::pair<HoldId, Hold>> due;
+    {
+        std::lock_guard<std::mutex> lock(hold_mutex);
+        hold_wheel.advance(tick, [&](std::uint64_t slot) {
+            const Hold& hold = hold_table[slot];
+            due.push_back({(std::uint64_t(hold.generation) << 32) | (slot + 1), hold});
+            free_hold_slot(static_cast<std::uint32_t>(slot));
+        });
+    }
+    for (const std::pair<HoldId, Hold>& hold : due) {
+        return_held_seats(hold.second.train_num, hold.second.seats, hold.first, JOURNAL_HOLD_EXPIRE, EVENT_ACTOR_HOLD_EXPIRY);
+        hold_stats.expired.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Background thread servicing the timer wheel once per tick.
+void hold_expiry_loop() {
+    while (hold_expiry_running.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(HOLD_TICK_MS));
+        expire_holds_until(hold_current_tick());
+    }
+}
+
+void print_hold_stats() {
+    cout << "\n--- Hold Statistics ---\n";
+    cout << "Placed:                " << hold_stats.placed.load() << endl;
+    cout << "Rejected (no seats):   " << hold_stats.rejected.load() << endl;
+    cout << "Confirmed:             " << hold_stats.confirmed.load() << endl;
+    cout << "Released by holder:    " << hold_stats.released.load() << endl;
+    cout << "Expired:               " << hold_stats.expired.load() << endl;
+    cout << "Late confirmations:    " << hold_stats.late_confirms.load() << endl;
+    cout << "Max outstanding holds: " << hold_stats.outstanding_max.load() << endl;
+}
+
+// --- ITINERARY HELPERS ---
+// Locks the distinct lock stripes of an itinerary's trains in ascending stripe order. Every
+// multi-train operation uses this one global order, so two itineraries can never wait on each
+// other in a cycle. Returns the number of locks taken (legs may share a train, and with striping
+// different trains may share a lock).
+int lock_itinerary_trains(const ItineraryLeg* legs, int num_legs, std::unique_lock<RobustMutex>* locks,
+                          ItineraryStats& stats) {
+    // Insertion sort with de-duplication; at most ITINERARY_MAX_LEGS ids
+    int ids[ITINERARY_MAX_LEGS];
+    int num_ids = 0;
+    for (int i = 0; i < num_legs; i++) {
+        int id = lock_stripe_of(legs[i].train_num);
+        int pos = num_ids;
+        while (pos > 0 && ids[pos - 1] > id) pos--;
+        if (pos > 0 && ids[pos - 1] == id) continue;
+        for (int j = num_ids; j > pos; j--) ids[j] = ids[j - 1];
+        ids[pos] = id;
+        num_ids++;
+    }
+
+    for (int i = 0; i < num_ids; i++) {
+        locks[i] = std::unique_lock<RobustMutex>(train_mutex[ids[i]], std::try_to_lock);
+        stats.lock_acquisitions++;
+        if (!locks[i].owns_lock()) {
+            stats.lock_contended++;
+            locks[i].lock();
+        }
+    }
+    return num_ids;
+}
+
+// Reserves seats on every leg or on none. Returns true on commit.
+// Must not be called with any train_mutex held.
+bool book_itinerary(ItineraryLeg* legs, int num_legs, ItineraryStats& stats) {
+    std::unique_lock<RobustMutex> locks[ITINERARY_MAX_LEGS];
+    lock_itinerary_trains(legs, num_legs, locks, stats);
+    stats.attempts++;
+
+    // Validate: total demand per train, so two legs on the same train are checked together
+    for (int i = 0; i < num_legs; i++) {
+        int demand = 0;
+        for (int j = 0; j < num_legs; j++) {
+            if (legs[j].train_num == legs[i].train_num) demand += legs[j].seats;
+        }
+        if (seats_available(legs[i].train_num) < demand) {
+            stats.aborted++;
+            return false;
+        }
+    }
+
+    // Commit: all trains are locked, so no lock-holder can observe a partial itinerary. Lock-free
+    // engines may still take seats after validation; then the legs taken so far are rolled back.
+    // Consistent readers see all legs or none (MultiTrainCommit).
+    MultiTrainCommit commit;
+    for (int i = 0; i < num_legs; i++) {
+        if (!try_take_seats(legs[i].train_num, legs[i].seats, JOURNAL_ITINERARY)) {
+            for (int j = 0; j < i; j++) give_back_seats(legs[j].train_num, legs[j].seats, JOURNAL_COMPENSATE);
+            stats.aborted++;
+            return false;
+        }
+    }
+    for (int i = 0; i < num_legs; i++) {
+        legs[i].remaining = seats_available(legs[i].train_num);
+    }
+    stats.committed++;
+    return true;
+}
+
+// Gives back every leg of a committed itinerary under the same ordered locking, or none.
+// Returns true if the itinerary was cancelled. Every train is checked first, its legs together
+// and bounded like any cancellation; the give-backs after that cannot overfill a train because
+// every other cancellation needs its lock. The lock-free engines cancel without it and could
+// refill a train between check and give-back, so under them itineraries are not cancelled.
+bool cancel_itinerary(ItineraryLeg* legs, int num_legs, ItineraryStats& stats) {
+    if (engine_mode != ENGINE_MUTEX) {
+        stats.cancel_rejected++;
+        return false;
+    }
+    std::unique_lock<RobustMutex> locks[ITINERARY_MAX_LEGS];
+    lock_itinerary_trains(legs, num_legs, locks, stats);
+
+    // Validate: total seats per train, so two legs on the same train are checked together
+    for (int i = 0; i < num_legs; i++) {
+        int train_num = legs[i].train_num;
+        int seats = 0;
+        for (int j = 0; j < num_legs; j++) {
+            if (legs[j].train_num == train_num) seats += legs[j].seats;
+        }
+        int available = seats_available(train_num);
+        if (available < 0 || available + seats > CAPACITY - held_seats[train_num].load(std::memory_order_acquire)) {
+            stats.cancel_rejected++;
+            return false;
+        }
+    }
+
+    // Commit: consistent readers see all legs or none (MultiTrainCommit)
+    MultiTrainCommit commit;
+    for (int i = 0; i < num_legs; i++) give_back_seats(legs[i].train_num, legs[i].seats, JOURNAL_CANCEL);
+    return true;
+}
+
+// Picks a connection starting at first_train: 2-3 legs on distinct trains drawn from
+// [0, num_trains), one party size for the whole journey.
+int make_itinerary(ItineraryLeg* legs, int first_train, int num_trains, int seats, std::mt19937& rng) {
+    int num_legs = std::min(2 + static_cast<int>(rng() % (ITINERARY_MAX_LEGS - 1)), num_trains);
+    legs[0] = {first_train, seats, 0};
+    for (int i = 1; i < num_legs; i++) {
+        bool duplicate;
+        do {
+            legs[i] = {static_cast<int>(rng() % num_trains), seats, 0};
+            duplicate = false;
+            for (int j = 0; j < i; j++) duplicate = duplicate || legs[j].train_num == legs[i].train_num;
+        } while (duplicate);
+    }
+    return num_legs;
+}
+
+// Simulation query type 5. Tries the requested connection, then up to ITINERARY_MAX_RETRIES
+// alternatives with different connecting trains.
+void itinerary_query(int thread_num, int first_train) {
+    static thread_local std::mt19937 rng(std::random_device{}());
+    ItineraryStats stats;
+    ItineraryLeg legs[ITINERARY_MAX_LEGS];
+    int seats = get_random_bookings();
+    int num_legs = 0;
+    bool booked = false;
+
+    for (int attempt = 0; attempt <= ITINERARY_MAX_RETRIES && !booked; attempt++) {
+        if (attempt > 0) stats.retries++;
+        num_legs = make_itinerary(legs, first_train, num_trains, seats, rng);
+        booked = book_itinerary(legs, num_legs, stats);
+    }
+
+    {
+        lock_guard<std::mutex> print_lock(print_mutex);
+        if (booked) {
+            Event event = make_event(EVENT_ITINERARY_BOOKED, thread_num, legs[0].train_num, seats);
+            event.aux = static_cast<std::uint8_t>(num_legs);
+            for (int i = 0; i < num_legs; i++) {
+                event.legs[i][0] = legs[i].train_num;
+                event.legs[i][1] = legs[i].remaining;
+            }
+            emit_event(event);
+        } else {
+            emit_event(make_event(EVENT_ITINERARY_FAILED, thread_num, first_train, static_cast<int>(stats.retries)));
+        }
+    }
+
+    lock_guard<std::mutex> stats_lock(itinerary_stats_mutex);
+    itinerary_totals.attempts += stats.attempts;
+    itinerary_totals.committed += stats.committed;
+    itinerary_totals.aborted += stats.aborted;
+    itinerary_totals.retries += stats.retries;
+    itinerary_totals.cancel_rejected += stats.cancel_rejected;
+    itinerary_totals.lock_acquisitions += stats.lock_acquisitions;
+    itinerary_totals.lock_contended += stats.lock_contended;
+}
+
+void print_itinerary_stats(const ItineraryStats& stats) {
+    double attempts = stats.attempts > 0 ? static_cast<double>(stats.attempts) : 1.0;
+    double acquisitions = stats.lock_acquisitions > 0 ? static_cast<double>(stats.lock_acquisitions) : 1.0;
+    cout << "Attempts:              " << stats.attempts << endl;
+    cout << "Committed:             " << stats.committed << endl;
+    cout << "Aborted:               " << stats.aborted << " (" << 100.0 * stats.aborted / attempts << "%)" << endl;
+    cout << "Retries:               " << stats.retries << " (" << 100.0 * stats.retries / attempts << "%)" << endl;
+    cout << "Cancels rejected:      " << stats.cancel_rejected << endl;
+    cout << "Contended lock waits:  " << stats.lock_contended << " of " << stats.lock_acquisitions
+         << " (" << 100.0 * stats.lock_contended / acquisitions << "%)" << endl;
+}
+
+// --- LOCK-FREE QUERIES ---
+// Inquiry, Booking and Cancellation for the atomic and OCC engines. The train lock is only
+// taken to touch the waitlist; output is printed after the state change has committed.
+// The read of an inquiry. A coalescing leader seals its flight right before it and hands the
+// result to its followers; any other inquiry just reads.
+int read_for_inquiry(int train_num, const InquiryTicket& inquiry) {
+    if (!inquiry.leader) return seats_available(train_num);
+    inquiry_flights.seal(inquiry);
+    int seats = seats_available(train_num);
+    inquiry_flights.publish(inquiry, seats);
+    return seats;
+}
+
+void print_coalescing_stats() {
+    long long inquiries = coalescing_stats.inquiries.load();
+    long long coalesced = coalescing_stats.coalesced.load();
+    cout << "\n--- Inquiry Coalescing ---\n";
+    cout << "Inquiries:             " << inquiries << endl;
+    cout << "Coalesced:             " << coalesced << " (" << (inquiries > 0 ? 100.0 * coalesced / inquiries : 0)
+         << "% hit rate)" << endl;
+    cout << "Gate entries saved:    " << coalesced << endl;
+    // Only the mutex engine takes the train lock for an inquiry
+    cout << "Train locks saved:     " << (engine_mode == ENGINE_MUTEX ? coalesced : 0) << endl;
+}
+
+void lockfree_query(int thread_num, int type, int train_num, const InquiryTicket& inquiry) {
+    EngineStats stats;
+    switch (type) {
+        case 1: { // Inquiry (Read)
+            int seats = read_for_inquiry(train_num, inquiry);
+            lock_guard<std::mutex> print_lock(print_mutex);
+            emit_event(make_event(EVENT_INQUIRY, thread_num, train_num, seats));
+            return;
+        }
+        case 2: { // Booking (Write)
+            int num_to_book = get_random_bookings();
+            if (engine_book(engine_mode, train_num, num_to_book, stats)) {
+                lock_guard<std::mutex> print_lock(print_mutex);
+                emit_event(make_event(EVENT_BOOKED, thread_num, train_num, num_to_book, seats_available(train_num)));
+            } else {
+                lock_guard<RobustMutex> train_lock(train_mutex_of(train_num));
+                lock_guard<std::mutex> print_lock(print_mutex);
+                Event event = make_event(EVENT_FAILED, thread_num, train_num);
+                event.aux = 2;
+                emit_event(event);
+                offer_waitlist(train_num, thread_num, num_to_book);
+            }
+            break;
+        }
+        case 3: { // Cancellation (Write)
+            int booked_seats = seats_booked(train_num);
+            int num_to_cancel = booked_seats > 0 ? std::rand() % booked_seats + 1 : 0;
+            if (num_to_cancel > 0 && engine_cancel(engine_mode, train_num, num_to_cancel, stats)) {
+                {
+                    lock_guard<std::mutex> print_lock(print_mutex);
+                    emit_event(make_event(EVENT_CANCELLED, thread_num, train_num, num_to_cancel,
+                                          seats_available(train_num)));
+                }
+                if (waitlist_depth[train_num].load(std::memory_order_acquire) > 0) {
+                    lock_guard<RobustMutex> train_lock(train_mutex_of(train_num));
+                    lock_guard<std::mutex> print_lock(print_mutex);
+                    promote_waitlist(train_num, thread_num);
+                }
+            } else {
+                lock_guard<std::mutex> print_lock(print_mutex);
+                emit_event(make_event(EVENT_NOTHING_TO_CANCEL, thread_num, train_num));
+            }
+            break;
+        }
+    }
+
+    lock_guard<std::mutex> stats_lock(engine_stats_mutex);
+    merge_engine_stats(engine_totals, stats);
+}
+
+// --- CRASH RECOVERY ---
+struct OrphanHold {
+    HoldId id;
+    int train_num;
+    int seats;
+};
+
+struct RecoveryStats {
+    long long journal_bytes = 0;
+    long long records = 0;     // Whole records in the journal files
+    long long applied = 0;     // Records newer than the word they were replayed onto
+    long long invalid = 0;     // Bad checksum, unknown op or train: skipped
+    long long torn_bytes = 0;  // Partial trailing records left by the crash
+    int threads = 0;
+    long long replay_ns = 0;
+    std::vector<OrphanHold> orphan_holds; // HOLD with no CONFIRM, RELEASE or EXPIRE after it
+};
+
+bool journal_record_valid(const JournalRecord& record, int num_trains) {
+    return record.crc == journal_record_crc(record) && record.op >= JOURNAL_BOOK &&
+           record.op <= JOURNAL_COMPENSATE && record.train_num >= 0 && record.train_num < num_trains;
+}
+
+// Replays journal files, oldest first, onto states[0..num_trains), which hold the checkpoint
+// image (or the initial words). `open_holds` are holds still outstanding before the first file,
+// as a compacted checkpoint carries them. Work is partitioned by train: train t belongs to
+// thread t % threads, and every thread walks all mapped files in order applying only its own
+// trains. No word has two writers, so no locks are needed, and each train's records keep their
+// file order, which the hold bookkeeping relies on. A single-threaded replay calls pace(bytes)
+// after every 4096 records so a background caller can throttle itself. Missing files are empty
+// ones; returns false on I/O errors.
+bool replay_journal_files(const std::vector<string>& paths, std::atomic<std::uint64_t>* states, int num_trains,
+                          int threads, RecoveryStats& stats,
+                          const std::vector<OrphanHold>& open_holds = std::vector<OrphanHold>(),
+                          const std::function<void(long long)>& pace = nullptr) {
+    auto start = std::chrono::steady_clock::now();
+    stats.threads = threads;
+    struct MappedFile {
+        void* mapping;
+        std::size_t bytes;
+        long long records;
+    };
+    std::vector<MappedFile> files;
+    auto unmap_all = [&] {
+        for (const MappedFile& file : files) ::munmap(file.mapping, file.bytes);
+    };
+    for (const string& path : paths) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            if (errno == ENOENT) continue;
+            unmap_all();
+            return false;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            unmap_all();
+            return false;
+        }
+        long long records = st.st_size / static_cast<long long>(sizeof(JournalRecord));
+        stats.journal_bytes += st.st_size;
+        stats.records += records;
+        stats.torn_bytes += st.st_size % static_cast<long long>(sizeof(JournalRecord));
+        if (records == 0) {
+            ::close(fd);
+            continue;
+        }
+        void* mapping = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            unmap_all();
+            return false;
+        }
+        ::madvise(mapping, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+        files.push_back(MappedFile{mapping, static_cast<std::size_t>(st.st_size), records});
+    }
+
+    struct Partition {
+        long long applied = 0;
+        long long invalid = 0;
+        std::unordered_map<HoldId, OrphanHold> open_holds;
+    };
+    std::vector<Partition> partitions(threads);
+    for (const OrphanHold& hold : open_holds) partitions[hold.train_num % threads].open_holds[hold.id] = hold;
+    auto replay_partition = [&](int part) {
+        Partition& out = partitions[part];
+        for (const MappedFile& file : files) {
+            const JournalRecord* records = static_cast<const JournalRecord*>(file.mapping);
+            for (long long i = 0; i < file.records; i++) {
+                if (pace && (i & 4095) == 4095) pace(4096 * static_cast<long long>(sizeof(JournalRecord)));
+                const JournalRecord& record = records[i];
+                if (!journal_record_valid(record, num_trains)) {
+                    if (part == 0) out.invalid++;
+                    continue;
+                }
+                if (record.train_num % threads != part) continue;
+                if (apply_journal_record(states[record.train_num], record)) out.applied++;
+                switch (record.op) {
+                    case JOURNAL_HOLD:
+                        out.open_holds[record.hold_id] = OrphanHold{record.hold_id, record.train_num, record.seats};
+                        break;
+                    case JOURNAL_HOLD_CONFIRM:
+                    case JOURNAL_HOLD_RELEASE:
+                    case JOURNAL_HOLD_EXPIRE:
+                        out.open_holds.erase(record.hold_id);
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    };
+    std::vector<std::thread> helpers;
+    for (int part = 1; part < threads; part++) helpers.emplace_back(replay_partition, part);
+    replay_partition(0);
+    for (std::thread& helper : helpers) helper.join();
+    unmap_all();
+
+    for (const Partition& part : partitions) {
+        stats.applied += part.applied;
+        stats.invalid += part.invalid;
+        for (const auto& hold : part.open_holds) stats.orphan_holds.push_back(hold.second);
+    }
+    stats.replay_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+// Replays the single journal file at `path`; see replay_journal_files.
+bool replay_journal(const char* path, std::atomic<std::uint64_t>* states, int num_trains, int threads,
+                    RecoveryStats& stats) {
+    return replay_journal_files(std::vector<string>(1, path), states, num_trains, threads, stats);
+}
+
+int recovery_threads() {
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    return std::max(1, std::min(RECOVERY_MAX_THREADS, cores));
+}
+
+// --- JOURNAL COMPACTION ---
+// With --wal the journal writer closes a segment every journal_segment_bytes, and a background
+// compactor folds closed segments into <wal>.ckpt and deletes them, so the journal on disk stays
+// bounded by what arrived since the last pass instead of growing for the life of the system.
+//
+// <wal>.ckpt: a header, one packed state word per train, the holds still open after the last
+// folded record, and a CRC32C of everything before it. It is replaced by write, fdatasync and
+// rename, and the rename is synced before any segment is deleted, so a crash leaves either the
+// old checkpoint with its segments or the new one (plus, at worst, segments it already covers).
+const char JOURNAL_CHECKPOINT_MAGIC[8] = {'R', 'S', 'V', 'J', 'C', 'K', 'P', '1'};
+
+struct JournalCheckpointHeader {
+    char magic[8];
+    std::uint64_t through_segment; // Every segment numbered up to here is folded in
+    std::uint64_t records_folded;  // Over the checkpoint's whole history
+    std::uint32_t num_trains;
+    std::uint32_t num_holds;
+};
+
+struct JournalCheckpointHold {
+    std::uint64_t hold_id;
+    std::int32_t train_num;
+    std::int32_t seats;
+};
+
+struct JournalCheckpoint {
+    std::uint64_t through_segment = 0; // 0: nothing compacted yet
+    std::uint64_t records_folded = 0;
+    std::vector<std::uint64_t> words;  // Per train; empty until the first compaction
+    std::vector<OrphanHold> open_holds;
+};
+
+struct CompactionStats {
+    long long passes = 0;        // Passes that folded at least one segment
+    long long segments = 0;
+    long long records = 0;
+    long long bytes_read = 0;    // Closed segments folded
+    long long bytes_written = 0; // Checkpoint files
+    long long busy_ns = 0;       // Inside passes, throttling included
+    long long throttle_ns = 0;   // Of which asleep to stay within the read budget
+    long long pass_ns_max = 0;
+};
+
+std::string journal_path;
+std::uint64_t journal_segment_bytes = JOURNAL_SEGMENT_BYTES;
+int compaction_interval_ms = COMPACTION_INTERVAL_MS;
+long long compaction_bytes_per_s = static_cast<long long>(COMPACTION_MAX_MB_PER_S) << 20;
+JournalCheckpoint journal_checkpoint; // Owned by the compactor thread while it runs
+CompactionStats compaction_totals;    // Likewise; read once it is joined
+std::mutex compactor_mutex;
+std::condition_variable compactor_cond; // Wakes the compactor early at shutdown
+bool compactor_running = false;
+std::thread compactor_thread;
+std::atomic<bool> compaction_throttled{true}; // Cleared at shutdown so a pass in progress hurries
+
+string journal_checkpoint_path(const string& wal_path) {
+    return wal_path + ".ckpt";
+}
+
+// Numbers of the closed segments of the journal at wal_path, ascending.
+std::vector<std::uint64_t> list_journal_segments(const string& wal_path) {
+    string::size_type slash = wal_path.rfind('/');
+    string dir = slash == string::npos ? "." : wal_path.substr(0, slash + 1);
+    string prefix = (slash == string::npos ? wal_path : wal_path.substr(slash + 1)) + ".";
+    std::vector<std::uint64_t> numbers;
+    DIR* listing = ::opendir(dir.c_str());
+    if (listing == nullptr) return numbers;
+    while (dirent* entry = ::readdir(listing)) {
+        const char* name = entry->d_name;
+        if (std::strncmp(name, prefix.c_str(), prefix.size()) != 0) continue;
+        const char* digits = name + prefix.size();
+        if (*digits == '\0' || std::strspn(digits, "0123456789") != std::strlen(digits)) continue;
+        numbers.push_back(std::strtoull(digits, nullptr, 10));
+    }
+    ::closedir(listing);
+    std::sort(numbers.begin(), numbers.end());
+    return numbers;
+}
+
+// Deletes a journal with everything that belongs to it: active file, segments, checkpoint.
+void remove_journal_files(const string& wal_path) {
+    for (std::uint64_t number : list_journal_segments(wal_path)) {
+        ::unlink(WalWriter::segment_path(wal_path, number).c_str());
+    }
+    ::unlink(wal_path.c_str());
+    ::unlink(journal_checkpoint_path(wal_path).c_str());
+    ::unlink((journal_checkpoint_path(wal_path) + ".tmp").c_str());
+}
+
+// Reads <wal>.ckpt. A missing file is an empty checkpoint; false means it exists but cannot be
+// read or fails its checksum, which recovery has no way around (its segments are gone).
+bool load_journal_checkpoint(const string& wal_path, int num_trains, JournalCheckpoint& checkpoint) {
+    checkpoint = JournalCheckpoint();
+    FILE* file = std::fopen(journal_checkpoint_path(wal_path).c_str(), "rb");
+    if (file == nullptr) return errno == ENOENT;
+    JournalCheckpointHeader header;
+    std::vector<JournalCheckpointHold> holds;
+    std::uint32_t stored_crc = 0;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+              std::memcmp(header.magic, JOURNAL_CHECKPOINT_MAGIC, sizeof(header.magic)) == 0 &&
+              header.num_trains == static_cast<std::uint32_t>(num_trains) && header.num_holds <= (1u << 24);
+    if (ok) {
+        checkpoint.words.resize(header.num_trains);
+        holds.resize(header.num_holds);
+        ok = std::fread(checkpoint.words.data(), sizeof(std::uint64_t), header.num_trains, file) == header.num_trains &&
+             std::fread(holds.data(), sizeof(JournalCheckpointHold), holds.size(), file) == holds.size() &&
+             std::fread(&stored_crc, sizeof(stored_crc), 1, file) == 1;
+    }
+    std::fclose(file);
+    if (ok) {
+        std::uint32_t crc = crc32c(&header, sizeof(header));
+        crc = crc32c_extend(crc, checkpoint.words.data(), checkpoint.words.size() * sizeof(std::uint64_t));
+        crc = crc32c_extend(crc, holds.data(), holds.size() * sizeof(JournalCheckpointHold));
+        ok = crc == stored_crc;
+    }
+    if (!ok) {
+        checkpoint = JournalCheckpoint();
+        return false;
+    }
+    checkpoint.through_segment = header.through_segment;
+    checkpoint.records_folded = header.records_folded;
+    for (const JournalCheckpointHold& hold : holds) {
+        checkpoint.open_holds.push_back(OrphanHold{hold.hold_id, hold.train_num, hold.seats});
+    }
+    return true;
+}
+
+// Replaces <wal>.ckpt with `checkpoint` durably. Returns the bytes written, or -1.
+long long write_journal_checkpoint(const string& wal_path, const JournalCheckpoint& checkpoint) {
+    JournalCheckpointHeader header;
+    std::memcpy(header.magic, JOURNAL_CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.through_segment = checkpoint.through_segment;
+    header.records_folded = checkpoint.records_folded;
+    header.num_trains = static_cast<std::uint32_t>(checkpoint.words.size());
+    header.num_holds = static_cast<std::uint32_t>(checkpoint.open_holds.size());
+    std::vector<JournalCheckpointHold> holds;
+    for (const OrphanHold& hold : checkpoint.open_holds) {
+        holds.push_back(JournalCheckpointHold{hold.id, hold.train_num, hold.seats});
+    }
+    std::uint32_t crc = crc32c(&header, sizeof(header));
+    crc = crc32c_extend(crc, checkpoint.words.data(), checkpoint.words.size() * sizeof(std::uint64_t));
+    crc = crc32c_extend(crc, holds.data(), holds.size() * sizeof(JournalCheckpointHold));
+
+    string path = journal_checkpoint_path(wal_path);
+    string tmp_path = path + ".tmp";
+    FILE* file = std::fopen(tmp_path.c_str(), "wb");
+    if (file == nullptr) return -1;
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(checkpoint.words.data(), sizeof(std::uint64_t), checkpoint.words.size(), file) ==
+                  checkpoint.words.size() &&
+              std::fwrite(holds.data(), sizeof(JournalCheckpointHold), holds.size(), file) == holds.size() &&
+              std::fwrite(&crc, sizeof(crc), 1, file) == 1;
+    ok = std::fflush(file) == 0 && ok;
+    ok = ::fdatasync(::fileno(file)) == 0 && ok;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || ::rename(tmp_path.c_str(), path.c_str()) != 0 || !WalWriter::sync_directory_of(path)) return -1;
+    return static_cast<long long>(sizeof(header) + checkpoint.words.size() * sizeof(std::uint64_t) +
+                                  holds.size() * sizeof(JournalCheckpointHold) + sizeof(crc));
+}
+
+// The files replayed on top of `checkpoint`, oldest first: every closed segment it does not
+// cover, then the active file.
+std::vector<string> journal_replay_paths(const string& wal_path, const JournalCheckpoint& checkpoint) {
+    std::vector<string> paths;
+    for (std::uint64_t number : list_journal_segments(wal_path)) {
+        if (number > checkpoint.through_segment) paths.push_back(WalWriter::segment_path(wal_path, number));
+    }
+    paths.push_back(wal_path);
+    return paths;
+}
+
+// Restores a journal onto states[0..num_trains): the checkpoint's words, then the files after
+// it, with the checkpoint's open holds carried in.
+bool recover_journal(const string& wal_path, const JournalCheckpoint& checkpoint,
+                     std::atomic<std::uint64_t>* states, int threads, RecoveryStats& stats) {
+    for (std::size_t i = 0; i < checkpoint.words.size(); i++) apply_state_word(states[i], checkpoint.words[i]);
+    return replay_journal_files(journal_replay_paths(wal_path, checkpoint), states, num_trains, threads, stats,
+                                checkpoint.open_holds);
+}
+
+// One compaction pass: folds every closed segment after `checkpoint` into a new checkpoint,
+// publishes it, then deletes the folded segments. Reads are paced to compaction_bytes_per_s
+// while compaction_throttled is set. On failure the segments stay and the next pass retries.
+bool compact_journal(const string& wal_path, JournalCheckpoint& checkpoint, CompactionStats& stats) {
+    std::vector<string> paths;
+    std::uint64_t through = checkpoint.through_segment;
+    for (std::uint64_t number : list_journal_segments(wal_path)) {
+        string path = WalWriter::segment_path(wal_path, number);
+        if (number <= checkpoint.through_segment) {
+            ::unlink(path.c_str()); // Folded by a pass that died before deleting it
+            continue;
+        }
+        paths.push_back(path);
+        through = number;
+    }
+    if (paths.empty()) return true;
+
+    auto start = std::chrono::steady_clock::now();
+    long long paced_bytes = 0;
+    long long throttle_ns = 0;
+    auto pace = [&](long long bytes) {
+        paced_bytes += bytes;
+        if (!compaction_throttled.load(std::memory_order_relaxed)) return;
+        long long due_ns = static_cast<long long>(1e9 * paced_bytes / compaction_bytes_per_s);
+        long long elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        if (due_ns > elapsed_ns) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(due_ns - elapsed_ns));
+            throttle_ns += due_ns - elapsed_ns;
+        }
+    };
+    std::vector<std::atomic<std::uint64_t>> states(num_trains);
+    for (int i = 0; i < num_trains; i++) {
+        states[i] = checkpoint.words.empty() ? pack_state(CAPACITY, 0) : checkpoint.words[i];
+    }
+    RecoveryStats fold;
+    if (!replay_journal_files(paths, states.data(), num_trains, 1, fold, checkpoint.open_holds, pace)) return false;
+
+    JournalCheckpoint next;
+    next.through_segment = through;
+    next.records_folded = checkpoint.records_folded + static_cast<std::uint64_t>(fold.records);
+    for (const std::atomic<std::uint64_t>& word : states) next.words.push_back(word.load());
+    next.open_holds = fold.orphan_holds;
+    long long written = write_journal_checkpoint(wal_path, next);
+    if (written < 0) return false;
+    for (const string& path : paths) ::unlink(path.c_str());
+    checkpoint = std::move(next);
+
+    long long pass_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    stats.passes++;
+    stats.segments += static_cast<long long>(paths.size());
+    stats.records += fold.records;
+    stats.bytes_read += fold.journal_bytes;
+    stats.bytes_written += written;
+    stats.busy_ns += pass_ns;
+    stats.throttle_ns += throttle_ns;
+    stats.pass_ns_max = std::max(stats.pass_ns_max, pass_ns);
+    return true;
+}
+
+// Background compactor (with --wal). Runs at idle CPU priority and within a read budget,
+// so folding segments only takes time the workers leave idle.
+void compactor_loop() {
+    // Linux applies both to the calling thread only. SCHED_IDLE runs it only when a core would
+    // otherwise idle; the nice value is the fallback where SCHED_IDLE is refused.
+    struct sched_param idle_param = {};
+    if (::sched_setscheduler(0, SCHED_IDLE, &idle_param) != 0) {
+        ::setpriority(PRIO_PROCESS, static_cast<id_t>(::syscall(SYS_gettid)), 19);
+    }
+    std::unique_lock<std::mutex> lock(compactor_mutex);
+    while (compactor_running) {
+        compactor_cond.wait_for(lock, std::chrono::milliseconds(compaction_interval_ms));
+        if (!compactor_running) break;
+        lock.unlock();
+        if (!compact_journal(journal_path, journal_checkpoint, compaction_totals)) {
+            lock_guard<std::mutex> print_lock(print_mutex);
+            cerr << "Journal compaction failed: " << std::strerror(errno) << endl;
+        }
+        lock.lock();
+    }
+}
+
+void start_compactor() {
+    compaction_throttled = true;
+    compactor_running = true;
+    compactor_thread = std::thread(compactor_loop);
+}
+
+void stop_compactor() {
+    {
+        lock_guard<std::mutex> lock(compactor_mutex);
+        compactor_running = false;
+    }
+    compaction_throttled = false;
+    compactor_cond.notify_one();
+    compactor_thread.join();
+}
+
+// `journal_bytes`: what the journal writer wrote over the same period, the base for amplification.
+void print_compaction_stats(const CompactionStats& stats, long long journal_bytes, const JournalCheckpoint& checkpoint) {
+    double busy_s = stats.busy_ns / 1e9;
+    double working_s = (stats.busy_ns - stats.throttle_ns) / 1e9;
+    double mib = 1024.0 * 1024.0;
+    double base = journal_bytes > 0 ? static_cast<double>(journal_bytes) : 1.0;
+    cout << "\n--- Journal Compaction Statistics ---\n";
+    cout << "Passes:                " << stats.passes << " (" << stats.segments << " segments folded, "
+         << list_journal_segments(journal_path).size() << " waiting)" << endl;
+    cout << "Records folded:        " << stats.records << " (checkpoint covers " << checkpoint.records_folded
+         << " through segment " << checkpoint.through_segment << ", " << checkpoint.open_holds.size()
+         << " holds open)" << endl;
+    if (stats.passes > 0) {
+        cout << "Rate:                  " << stats.records / std::max(working_s, 1e-9) / 1e6 << " M records/s ("
+             << stats.bytes_read / mib / std::max(working_s, 1e-9) << " MiB/s) unthrottled, "
+             << stats.bytes_read / mib / std::max(busy_s, 1e-9) << " MiB/s paced (budget "
+             << compaction_bytes_per_s / mib << " MiB/s)" << endl;
+        cout << "Longest pass:          " << stats.pass_ns_max / 1000000 << " ms" << endl;
+    }
+    cout << "I/O amplification:     read " << stats.bytes_read / base << "x, write "
+         << (journal_bytes + stats.bytes_written) / base << "x (" << stats.bytes_written
+         << " checkpoint bytes on " << journal_bytes << " journal bytes)" << endl;
+}
+
+// --- DURABLE STARTUP ---
+// Startup for --store / --wal, before any other thread exists: restores the newest checkpoint,
+// replays the journal on top of it, releases holds whose holder died with the process and
+// starts the checkpointer and the journal compactor. Prints what it did; returns false if the run cannot start.
+bool open_durable_state(const char* store_path, const char* wal_path) {
+    SeatStore::OpenResult store_result = SeatStore::STORE_CREATED;
+    if (store_path != nullptr) {
+        auto start = std::chrono::steady_clock::now();
+        store_result = seat_store.open(store_path, num_trains, STORE_DAYS, pack_state(CAPACITY, 0));
+        if (store_result == SeatStore::STORE_FAILED) {
+            cerr << "Cannot open seat store " << store_path << ": " << seat_store.last_error() << endl;
+            return false;
+        }
+        train_state = seat_store.slots(); // Day 0 of every train
+        store_enabled = true;
+        const char* how = store_result == SeatStore::STORE_CREATED ? "created" :
+                          store_result == SeatStore::STORE_CLEAN ? "reused after clean shutdown" :
+                          "restored from checkpoint after crash";
+        cout << "Seat store " << store_path << " " << how << " in "
+             << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()
+             << " us." << endl;
+    }
+
+    if (wal_path != nullptr) {
+        journal_path = wal_path;
+        if (!load_journal_checkpoint(journal_path, num_trains, journal_checkpoint)) {
+            cerr << "Journal checkpoint " << journal_checkpoint_path(journal_path)
+                 << " is unreadable or corrupt" << endl;
+            return false;
+        }
+        // A cleanly shut down store already holds every journaled change
+        RecoveryStats recovery;
+        if (store_result != SeatStore::STORE_CLEAN) {
+            if (!recover_journal(journal_path, journal_checkpoint, train_state, recovery_threads(), recovery)) {
+                cerr << "Cannot replay journal " << wal_path << ": " << std::strerror(errno) << endl;
+                return false;
+            }
+            // Cut a torn tail off so new records stay aligned (closed segments were synced whole)
+            struct stat st;
+            if (::stat(wal_path, &st) == 0 && st.st_size % static_cast<off_t>(sizeof(JournalRecord)) != 0 &&
+                ::truncate(wal_path, st.st_size - st.st_size % static_cast<off_t>(sizeof(JournalRecord))) != 0) {
+                cerr << "Cannot truncate torn journal tail: " << std::strerror(errno) << endl;
+                return false;
+            }
+            if (recovery.records > 0 || !journal_checkpoint.words.empty()) {
+                cout << "Journal " << wal_path << " replayed onto its checkpoint (through segment "
+                     << journal_checkpoint.through_segment << "): " << recovery.records << " records, "
+                     << recovery.applied << " applied, " << recovery.invalid << " invalid, "
+                     << recovery.torn_bytes << " torn bytes dropped in " << recovery.replay_ns / 1000
+                     << " us on " << recovery.threads << " threads." << endl;
+            }
+        }
+
+        std::atomic<std::uint64_t>* slots = store_enabled ? seat_store.slots() : train_state;
+        std::size_t num_slots = store_enabled ? seat_store.num_slots() : num_trains;
+        for (std::size_t i = 0; i < num_slots; i++) durable_state[i] = slots[i].load();
+        journal.set_durable_hook(journal_durable_hook);
+        std::vector<std::uint64_t> segments = list_journal_segments(journal_path);
+        std::uint64_t last_segment = segments.empty() ? 0 : segments.back();
+        journal.set_segments(journal_segment_bytes, std::max(last_segment, journal_checkpoint.through_segment) + 1);
+        if (!journal.open(wal_path, journal_io_mode)) {
+            cerr << "Cannot open journal " << wal_path << ": " << std::strerror(errno) << endl;
+            return false;
+        }
+        if (journal.io_mode() != journal_io_mode) {
+            cout << "io_uring unavailable (" << std::strerror(journal.uring_fallback_errno())
+                 << "); journal falls back to pwritev." << endl;
+        }
+        journal_enabled = true;
+
+        // Nobody is left to pay for holds that were outstanding at the crash
+        for (const OrphanHold& hold : recovery.orphan_holds) {
+            give_back_seats(hold.train_num, hold.seats, JOURNAL_HOLD_EXPIRE, hold.id);
+        }
+        if (!journal_wait()) {
+            cerr << "Cannot write journal " << wal_path << endl;
+            return false;
+        }
+        if (!recovery.orphan_holds.empty()) {
+            cout << "Released " << recovery.orphan_holds.size() << " holds orphaned by the crash." << endl;
+        }
+        start_compactor();
+    }
+
+    if (store_enabled) {
+        checkpointer_running = true;
+        checkpointer_thread = std::thread(checkpointer_loop);
+    }
+    return true;
+}
+
+// --- SHARED-MEMORY TABLE ---
+// --shm=NAME: moves train_state, held_seats, booking_seats, train_mutex and the admission limit
+// into the shared table NAME, creating it or joining the processes already booking against it.
+bool open_shared_table(const char* name) {
+    SharedTrainTable::OpenResult result =
+        shared_table.open(name, num_trains, lock_stripes, MAX_CONCURRENT_ACCESS, pack_state(CAPACITY, 0));
+    if (result == SharedTrainTable::SHM_FAILED) {
+        cerr << "Cannot open shared train table " << name << ": " << shared_table.last_error() << endl;
+        return false;
+    }
+    train_state = shared_table.states();
+    held_seats = shared_table.held();
+    booking_seats = shared_table.booking();
+    train_mutex = shared_table.train_locks();
+    shared_enabled = true;
+    cout << "Shared train table " << name << (result == SharedTrainTable::SHM_CREATED ? " created" : " joined")
+         << " (" << shared_table.attached() << " processes attached)." << endl;
+    return true;
+}
+
+void print_shared_table_stats() {
+    cout << "\n--- Shared Table Statistics ---\n";
+    cout << "Processes attached:    " << shared_table.attached() << " (this one included)" << endl;
+    cout << "Dead owners recovered: " << shared_table.owner_deaths() << " locks" << endl;
+}
+
+// --- TCP SERVER ---
+// --serve=PORT answers the binary protocol of protocol.h on 127.0.0.1:PORT instead of running
+// the simulated workers. Each reactor thread is pinned to a core and owns its own SO_REUSEPORT
+// listening socket, so the kernel spreads new connections across reactors and a connection
+// never changes threads. Sockets are non-blocking and edge-triggered: every readiness event is
+// drained until EAGAIN, all complete requests in the buffer are executed as one batch, and the
+// batch's journal records share one group commit before its responses go out.
+struct ServerStats {
+    long long connections = 0;
+    long long requests = 0;
+    long long rejected = 0;
+    long long bad_requests = 0;
+    long long not_durable = 0;     // Applied, but answered RESP_NOT_DURABLE after a journal failure
+    long long batches = 0;         // Groups of pipelined requests answered together
+    long long batch_max = 0;
+    long long bytes_in = 0;
+    long long bytes_out = 0;
+    long long requests_by_op[REQ_CANCEL + 1] = {};
+};
+
+struct Connection {
+    int fd;
+    std::vector<unsigned char> in;
+    std::vector<unsigned char> out;
+    std::size_t out_sent = 0;
+};
+
+std::atomic<bool> server_stopping{false};
+int server_reactors = 0; // --reactors=N; 0: one per core
+std::mutex server_stats_mutex;
+ServerStats server_totals;
+
+void handle_server_signal(int) {
+    server_stopping.store(true); // Lock-free, so safe in a signal handler
+}
+
+Response execute_request(const Request& request, EngineStats& engine_stats, ServerStats& stats) {
+    Response response = {request.op, RESP_OK, request.request_id, 0};
+    if (request.train_num >= static_cast<std::uint32_t>(num_trains) || request.op < REQ_INQUIRY || request.op > REQ_CANCEL ||
+        (request.op != REQ_INQUIRY && (request.seats == 0 || request.seats > CAPACITY))) {
+        response.status = RESP_BAD_REQUEST;
+        stats.bad_requests++;
+        return response;
+    }
+    int train_num = static_cast<int>(request.train_num);
+    bool done = true;
+    if (request.op == REQ_BOOK) done = engine_book(engine_mode, train_num, request.seats, engine_stats);
+    if (request.op == REQ_CANCEL) done = engine_cancel(engine_mode, train_num, request.seats, engine_stats);
+    if (!done) {
+        response.status = RESP_REJECTED;
+        stats.rejected++;
+    }
+    stats.requests_by_op[request.op]++;
+    response.seats_available = seats_available(train_num);
+    return response;
+}
+
+// Handles one readiness event. Returns false when the connection should be closed.
+bool serve_connection(Connection& conn, EngineStats& engine_stats, ServerStats& stats) {
+    // Edge-triggered: read until EAGAIN, or no new event comes for bytes already queued. A client
+    // that does not read its responses is not read from either; the EPOLLOUT edge after the
+    // backlog drains brings us back here.
+    bool peer_closed = false;
+    while (conn.out.size() - conn.out_sent < SERVER_MAX_OUTPUT_BYTES) {
+        std::size_t old_size = conn.in.size();
+        conn.in.resize(old_size + 65536);
+        ssize_t got = ::recv(conn.fd, conn.in.data() + old_size, 65536, 0);
+        conn.in.resize(old_size + (got > 0 ? static_cast<std::size_t>(got) : 0));
+        if (got > 0) {
+            stats.bytes_in += got;
+            continue;
+        }
+        if (got == 0) {
+            peer_closed = true;
+            break;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        return false;
+    }
+
+    // Every complete request: pipelined requests are executed and answered as one batch
+    std::size_t consumed = 0;
+    long long handled = 0;
+    std::size_t batch_start = conn.out.size();
+    while (true) {
+        Request request;
+        long used = decode_request(conn.in.data() + consumed, conn.in.size() - consumed, request);
+        if (used < 0) return false; // Malformed frame: the stream cannot be resynchronized
+        if (used == 0) break;
+        consumed += static_cast<std::size_t>(used);
+        Response response = execute_request(request, engine_stats, stats);
+        std::size_t at = conn.out.size();
+        conn.out.resize(at + RESPONSE_FRAME_BYTES);
+        encode_response(response, conn.out.data() + at);
+        handled++;
+    }
+    conn.in.erase(conn.in.begin(), conn.in.begin() + static_cast<std::ptrdiff_t>(consumed));
+    if (handled > 0) {
+        // One group commit for the batch; a no-op without --wal. If the journal failed, no
+        // booking or cancellation in the batch may be answered as done.
+        if (!journal_wait()) {
+            for (std::size_t at = batch_start; at < conn.out.size(); at += RESPONSE_FRAME_BYTES) {
+                Response response = {};
+                decode_response(conn.out.data() + at, RESPONSE_FRAME_BYTES, response);
+                if (response.status != RESP_OK || response.op == REQ_INQUIRY) continue;
+                response.status = RESP_NOT_DURABLE;
+                encode_response(response, conn.out.data() + at);
+                stats.not_durable++;
+            }
+        }
+        stats.requests += handled;
+        stats.batches++;
+        stats.batch_max = std::max(stats.batch_max, handled);
+    }
+
+    while (conn.out_sent < conn.out.size()) {
+        ssize_t sent = ::send(conn.fd, conn.out.data() + conn.out_sent, conn.out.size() - conn.out_sent,
+                              MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break; // EPOLLOUT edge resumes
+            return false;
+        }
+        conn.out_sent += static_cast<std::size_t>(sent);
+        stats.bytes_out += sent;
+    }
+    if (conn.out_sent == conn.out.size()) {
+        conn.out.clear();
+        conn.out_sent = 0;
+    }
+    return !peer_closed;
+}
+
+void reactor_loop(int index, int listen_fd) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(index % static_cast<int>(std::max(1u, std::thread::hardware_concurrency())), &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+
+    EngineStats engine_stats;
+    ServerStats stats;
+    int epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    epoll_event listen_event = {};
+    listen_event.events = EPOLLIN | EPOLLET;
+    listen_event.data.ptr = nullptr; // Marks the listening socket
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &listen_event);
+    std::vector<Connection*> open_connections;
+
+    epoll_event events[64];
+    while (!server_stopping.load(std::memory_order_relaxed)) {
+        int ready = ::epoll_wait(epoll_fd, events, 64, 100);
+        for (int i = 0; i < ready; i++) {
+            if (events[i].data.ptr == nullptr) {
+                while (true) { // Edge-triggered: accept everything pending
+                    int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (fd < 0) break;
+                    int one = 1;
+                    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    Connection* conn = new Connection();
+                    conn->fd = fd;
+                    epoll_event event = {};
+                    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                    event.data.ptr = conn;
+                    ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+                    open_connections.push_back(conn);
+                    stats.connections++;
+                }
+                continue;
+            }
+            Connection* conn = static_cast<Connection*>(events[i].data.ptr);
+            if ((events[i].events & EPOLLERR) != 0 || !serve_connection(*conn, engine_stats, stats)) {
+                ::close(conn->fd); // Also removes it from the epoll set
+                open_connections.erase(std::find(open_connections.begin(), open_connections.end(), conn));
+                delete conn;
+            }
+        }
+    }
+    for (Connection* conn : open_connections) {
+        ::close(conn->fd);
+        delete conn;
+    }
+    ::close(epoll_fd);
+    ::close(listen_fd);
+
+    lock_guard<std::mutex> lock(server_stats_mutex);
+    server_totals.connections += stats.connections;
+    server_totals.requests += stats.requests;
+    server_totals.rejected += stats.rejected;
+    server_totals.bad_requests += stats.bad_requests;
+    server_totals.not_durable += stats.not_durable;
+    server_totals.batches += stats.batches;
+    server_totals.batch_max = std::max(server_totals.batch_max, stats.batch_max);
+    server_totals.bytes_in += stats.bytes_in;
+    server_totals.bytes_out += stats.bytes_out;
+    for (int op = 0; op <= REQ_CANCEL; op++) server_totals.requests_by_op[op] += stats.requests_by_op[op];
+    lock_guard<std::mutex> engine_lock(engine_stats_mutex);
+    merge_engine_stats(engine_totals, engine_stats);
+}
+
+// Binds one listening socket per reactor on 127.0.0.1:port. Done before anything else starts,
+// so a taken port fails the run cleanly.
+bool open_server_sockets(int port, std::vector<int>& listen_fds) {
+    int reactors = server_reactors > 0 ? server_reactors
+                                       : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int i = 0; i < reactors; i++) {
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<std::uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (fd < 0 || ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0 ||
+            ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+            cerr << "Cannot listen on 127.0.0.1:" << port << ": " << std::strerror(errno) << endl;
+            if (fd >= 0) ::close(fd);
+            for (int open_fd : listen_fds) ::close(open_fd);
+            listen_fds.clear();
+            return false;
+        }
+        listen_fds.push_back(fd);
+    }
+    return true;
+}
+
+// Runs one reactor per listening socket until SIGINT or SIGTERM.
+void run_server(int port, const std::vector<int>& listen_fds) {
+    std::signal(SIGINT, handle_server_signal);
+    std::signal(SIGTERM, handle_server_signal);
+    cout << "Serving on 127.0.0.1:" << port << " with " << listen_fds.size() << " reactors ("
+         << engine_name(engine_mode) << " engine); SIGINT or SIGTERM stops." << endl;
+    std::vector<std::thread> reactors;
+    for (std::size_t i = 0; i < listen_fds.size(); i++) {
+        reactors.emplace_back(reactor_loop, static_cast<int>(i), listen_fds[i]);
+    }
+    for (std::thread& reactor : reactors) reactor.join();
+}
+
+void print_server_stats(std::size_t reactors, long long run_ns) {
+    const ServerStats& stats = server_totals;
+    double seconds = run_ns / 1e9;
+    cout << "\n--- Server Statistics (" << reactors << " reactors) ---\n";
+    cout << "Connections:           " << stats.connections << endl;
+    cout << "Requests:              " << stats.requests << " (" << stats.requests_by_op[REQ_INQUIRY]
+         << " inquiries, " << stats.requests_by_op[REQ_BOOK] << " bookings, " << stats.requests_by_op[REQ_CANCEL]
+         << " cancellations; " << stats.rejected << " rejected, " << stats.bad_requests << " bad, "
+         << stats.not_durable << " not durable)" << endl;
+    cout << "Throughput:            " << static_cast<long long>(stats.requests / std::max(seconds, 1e-9))
+         << " requests/s over " << seconds << " s" << endl;
+    cout << "Pipelining:            avg " << static_cast<double>(stats.requests) / std::max(1LL, stats.batches)
+         << " requests per batch, max " << stats.batch_max << endl;
+    cout << "Traffic:               " << stats.bytes_in << " bytes in, " << stats.bytes_out << " bytes out" << endl;
+}
+
+// --- WORKER THREAD (FIXED) ---
+void worker_thread(int thread_num) {
+    auto start = std::chrono::steady_clock::now();
+
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::rand() % 500));
+        int train_num = get_random_train();
+        int type = std::rand() % NUM_QUERY_TYPES + 1;
+
+        // Check time limit before starting a new request
+        auto now = std::chrono::steady_clock::now();
+        auto elapsed_seconds = std::chrono::duration_cast<std::chrono::seconds>(now - start);
+        if (elapsed_seconds.count() >= MAX_TIME * 60) {
+            break;
+        }
+
+        // Coalesced inquiry: if an inquiry on this train is still waiting for admission or the
+        // train lock, wait for its answer instead of queueing behind it.
+        InquiryTicket inquiry;
+        if (type == 1 && coalesce_inquiries) {
+            coalescing_stats.inquiries++;
+            inquiry = inquiry_flights.join(train_num);
+            if (!inquiry.leader) {
+                int seats = inquiry_flights.wait(inquiry);
+                coalescing_stats.coalesced++;
+                lock_guard<std::mutex> print_lock(print_mutex);
+                emit_event(make_event(EVENT_INQUIRY, thread_num, train_num, seats));
+                continue;
+            }
+        }
+
+        // --- PHASE 1: GLOBAL LOAD CONTROL (Using Condition Variable) ---
+        int admission_slot = -1; // With --shm: the shared admission slot this request holds
+        if (shared_enabled) { // Limit shared by every process; a dead holder's slot frees itself
+            print_query(thread_num, type, train_num, EVENT_WAITING);
+            admission_slot = shared_table.admit();
+        } else { // Start a new scope for unique_lock
+            print_query(thread_num, type, train_num, EVENT_WAITING);
+
+            // Acquire access_mutex
+            std::unique_lock<std::mutex> load_lock(access_mutex);
+
+            // Wait until an access slot is free (releases lock while waiting)
+            access_cond.wait(load_lock, [&]{
+                return active_access_count < MAX_CONCURRENT_ACCESS;
+            });
+
+            // Lock re-acquired, condition met.
+            active_access_count++; // Claim the slot
+
+            // load_lock is released here when scope ends, ensuring active_access_count is protected.
+        } // End of scope: load_lock releases access_mutex automatically.
+
+        print_query(thread_num, type, train_num, EVENT_GAINED);
+
+        // --- PHASE 2: LOCAL DATA INTEGRITY (Using Train Mutex) ---
+        HoldId pending_hold = 0; // Set by a Hold query; paid for in PHASE 4
+
+        if (type == 5) { // Itinerary: locks all of its trains itself, in ascending order
+            itinerary_query(thread_num, train_num);
+        } else if (engine_mode != ENGINE_MUTEX && type <= 3) { // Lock-free engines
+            lockfree_query(thread_num, type, train_num, inquiry);
+        } else { // Single-train query; new scope so both locks are released before PHASE 3
+            // Acquire lock for the specific train to ensure data integrity
+            EngineStats stats;
+            bool engine_query = (type == 2 || type == 3);
+            std::unique_lock<RobustMutex> train_lock(train_mutex_of(train_num), std::try_to_lock);
+            if (!train_lock.owns_lock()) {
+                if (engine_query) stats.conflicts++;
+                train_lock.lock();
+            }
+            if (engine_query) stats.operations++;
+
+            // Execute Query (Critical Section for data)
+            lock_guard<std::mutex> print_lock(print_mutex);
+
+            switch (type) {
+                case 1: { // Inquiry (Read)
+                    emit_event(make_event(EVENT_INQUIRY, thread_num, train_num, read_for_inquiry(train_num, inquiry)));
+                    break;
+                }
+                case 2: { // Booking (Write)
+                    int num_to_book = get_random_bookings();
+                    if (try_take_seats(train_num, num_to_book, JOURNAL_BOOK)) {
+                        emit_event(make_event(EVENT_BOOKED, thread_num, train_num, num_to_book,
+                                              seats_available(train_num)));
+                    } else {
+                        Event event = make_event(EVENT_FAILED, thread_num, train_num);
+                        event.aux = 2;
+                        emit_event(event);
+                        offer_waitlist(train_num, thread_num, num_to_book);
+                    }
+                    break;
+                }
+                case 3: { // Cancellation (Write)
+                    int booked_seats = seats_booked(train_num);
+                    int num_to_cancel = booked_seats > 0 ? std::rand() % booked_seats + 1 : 0;
+                    if (num_to_cancel > 0 && try_return_seats(train_num, num_to_cancel, JOURNAL_CANCEL)) {
+                        emit_event(make_event(EVENT_CANCELLED, thread_num, train_num, num_to_cancel,
+                                              seats_available(train_num)));
+                        // Freed seats go to the waitlist first, inside the same critical section.
+                        promote_waitlist(train_num, thread_num);
+                    } else {
+                        emit_event(make_event(EVENT_NOTHING_TO_CANCEL, thread_num, train_num));
+                    }
+                    break;
+                }
+                case 4: { // Hold (Write; confirmed, released or left to expire in PHASE 4)
+                    int num_to_hold = get_random_bookings();
+                    pending_hold = place_hold(train_num, num_to_hold, HOLD_TTL_MS);
+                    if (pending_hold != 0) {
+                        emit_event(make_event(EVENT_HELD, thread_num, train_num, num_to_hold,
+                                              seats_available(train_num)));
+                    } else {
+                        Event event = make_event(EVENT_FAILED, thread_num, train_num);
+                        event.aux = 4;
+                        emit_event(event);
+                    }
+                    break;
+                }
+            }
+
+            if (engine_query) {
+                lock_guard<std::mutex> stats_lock(engine_stats_mutex);
+                merge_engine_stats(engine_totals, stats);
+            }
+        } // train_lock and print_lock are released here.
+
+        // The request is acknowledged only once its journal records are durable (group commit).
+        // If the journal failed they never will be: give the slot back and stop taking requests.
+        bool durable = journal_wait();
+
+        // --- PHASE 3: RELEASE GLOBAL ACCESS (Signaling) ---
+
+        if (shared_enabled) {
+            shared_table.leave(admission_slot);
+        } else { // Start a new scope for load_lock
+            { // Re-acquire the global load lock to safely decrement the counter
+                std::lock_guard<std::mutex> release_lock(access_mutex);
+                active_access_count--; // Release the slot
+            } // End of scope: release_lock releases access_mutex automatically.
+
+            // Signal one waiting thread that a slot in the global access pool is free
+            access_cond.notify_one();
+        }
+        if (!durable) break;
+
+        // --- PHASE 4: PAYMENT FOR HELD SEATS (No locks held) ---
+        if (pending_hold != 0) {
+            // Payment takes up to 1.5x the TTL, so some holds expire before it completes.
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::rand() % (HOLD_TTL_MS * 3 / 2)));
+            int outcome = std::rand() % 100;
+            if (outcome < HOLD_CONFIRM_PERCENT) {
+                bool confirmed = confirm_hold(pending_hold);
+                lock_guard<std::mutex> print_lock(print_mutex);
+                emit_event(make_event(confirmed ? EVENT_CONFIRMED : EVENT_HOLD_UNPAID, thread_num, train_num));
+            } else if (outcome < HOLD_CONFIRM_PERCENT + HOLD_RELEASE_PERCENT) {
+                release_hold(pending_hold, thread_num);
+            }
+            if (!journal_wait()) break;
+            // Otherwise the holder walks away and the timer wheel releases the seats.
+        }
+
+        // Time check moved to the start of the loop for cleaner structure.
+    }
+}
+
+// --- BENCHMARKS ---
+// Itinerary contention benchmark: `threads` clients book and cancel 2-3 leg itineraries on a hot
+// set of `hot_trains` trains for `seconds`. Smaller hot sets mean more lock contention and,
+// as the hot trains fill up, more aborts and retries.
+void bench_itinerary(int threads, int hot_trains, int seconds) {
+    for (int i = 0; i < hot_trains; i++) train_state[i] = pack_state(CAPACITY, 0);
+
+    std::vector<ItineraryStats> per_thread(threads);
+    std::vector<std::thread> clients;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    for (int t = 0; t < threads; t++) {
+        clients.emplace_back([&, t] {
+            std::mt19937 rng(t * 7919 + hot_trains);
+            ItineraryStats& stats = per_thread[t];
+            std::vector<std::vector<ItineraryLeg>> booked;
+            ItineraryLeg legs[ITINERARY_MAX_LEGS];
+            while (std::chrono::steady_clock::now() < deadline) {
+                // Cancel 40% of the time so the hot trains hover around full instead of selling out
+                if (!booked.empty() && rng() % 100 < 40) {
+                    std::size_t victim = rng() % booked.size();
+                    if (!cancel_itinerary(booked[victim].data(), static_cast<int>(booked[victim].size()), stats)) continue;
+                    booked[victim] = booked.back();
+                    booked.pop_back();
+                    continue;
+                }
+                int seats = BOOK_MIN + static_cast<int>(rng() % (BOOK_MAX - BOOK_MIN + 1));
+                for (int attempt = 0; attempt <= ITINERARY_MAX_RETRIES; attempt++) {
+                    if (attempt > 0) stats.retries++;
+                    int first_train = static_cast<int>(rng() % hot_trains);
+                    int num_legs = make_itinerary(legs, first_train, hot_trains, seats, rng);
+                    if (book_itinerary(legs, num_legs, stats)) {
+                        booked.push_back(std::vector<ItineraryLeg>(legs, legs + num_legs));
+                        break;
+                    }
+                }
+            }
+        });
+    }
+    for (std::thread& client : clients) client.join();
+
+    ItineraryStats total;
+    for (const ItineraryStats& stats : per_thread) {
+        total.attempts += stats.attempts;
+        total.committed += stats.committed;
+        total.aborted += stats.aborted;
+        total.retries += stats.retries;
+        total.cancel_rejected += stats.cancel_rejected;
+        total.lock_acquisitions += stats.lock_acquisitions;
+        total.lock_contended += stats.lock_contended;
+    }
+    cout << "\n--- Itinerary benchmark: " << threads << " threads, " << hot_trains << " hot trains, "
+         << seconds << " s ---\n";
+    cout << "Throughput:            " << total.attempts / seconds << " attempts/s" << endl;
+    print_itinerary_stats(total);
+}
+
+// Engine comparison: the same inquiry/booking/cancellation mix against each engine, for a few
+// workload shapes, so the engine can be chosen per workload.
+std::atomic<long long> bench_sink{0};
+
+struct EngineWorkload {
+    const char* name;
+    int trains;       // Trains the requests are spread over
+    int read_percent; // Share of inquiries; the rest is split evenly between bookings and cancellations
+};
+
+// Returns false if the engine broke the seat invariant: once the clients have stopped, every train
+// must have 0 <= seats <= CAPACITY - held seats available.
+bool bench_engine(EngineMode mode, const EngineWorkload& workload, int threads, int seconds) {
+    for (int i = 0; i < workload.trains; i++) {
+        // Start half full so both bookings and cancellations mostly succeed
+        train_state[i] = pack_state(CAPACITY / 2, 0);
+        held_seats[i] = 0;
+    }
+
+    std::vector<EngineStats> per_thread(threads);
+    std::vector<long long> reads(threads, 0);
+    std::vector<std::thread> clients;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    for (int t = 0; t < threads; t++) {
+        clients.emplace_back([&, t] {
+            std::mt19937 rng(t * 104729 + workload.trains);
+            long long seen = 0;
+            while (std::chrono::steady_clock::now() < deadline) {
+                for (int batch = 0; batch < 64; batch++) {
+                    int train_num = static_cast<int>(rng() % workload.trains);
+                    int seats = BOOK_MIN + static_cast<int>(rng() % (BOOK_MAX - BOOK_MIN + 1));
+                    int roll = static_cast<int>(rng() % 100);
+                    if (roll < workload.read_percent) {
+                        if (mode == ENGINE_MUTEX) {
+                            std::lock_guard<RobustMutex> lock(train_mutex_of(train_num));
+                            seen += seats_available(train_num);
+                        } else {
+                            seen += seats_available(train_num);
+                        }
+                        reads[t]++;
+                    } else if (roll % 2 == 0) {
+                        engine_book(mode, train_num, seats, per_thread[t]);
+                    } else {
+                        engine_cancel(mode, train_num, seats, per_thread[t]);
+                    }
+                }
+            }
+            bench_sink.fetch_add(seen, std::memory_order_relaxed); // Keep the reads observable
+        });
+    }
+    for (std::thread& client : clients) client.join();
+
+    EngineStats total;
+    long long total_reads = 0;
+    for (int t = 0; t < threads; t++) {
+        merge_engine_stats(total, per_thread[t]);
+        total_reads += reads[t];
+    }
+    int broken = 0;
+    for (int i = 0; i < workload.trains; i++) {
+        int seats = seats_available(i);
+        if (seats < 0 || seats > CAPACITY - held_seats[i].load()) broken++;
+    }
+    double writes = total.operations > 0 ? static_cast<double>(total.operations) : 1.0;
+    cout << "  " << workload.name << "  " << engine_name(mode) << "\t"
+         << (total.operations + total_reads) / seconds / 1000 << " kops/s\t"
+         << "conflicts " << 100.0 * total.conflicts / writes << "%\t"
+         << "compensations " << 100.0 * total.compensations / writes << "%\t"
+         << (broken == 0 ? "seats ok" : "SEATS OUT OF RANGE on ") << (broken == 0 ? "" : std::to_string(broken) + " trains")
+         << endl;
+    return broken == 0;
+}
+
+// Live-report benchmark: booking clients on the mutex engine while one reporter reads all trains
+// in a loop, either lock-free (read_consistent_states) or by taking every train_mutex.
+void bench_live_report(int threads, int seconds, bool lock_all) {
+    for (int i = 0; i < num_trains; i++) train_state[i] = pack_state(CAPACITY / 2, 0);
+
+    std::vector<EngineStats> per_thread(threads);
+    std::vector<std::thread> clients;
+    std::atomic<bool> stop{false};
+    for (int t = 0; t < threads; t++) {
+        clients.emplace_back([&, t] {
+            std::mt19937 rng(t * 15485863);
+            while (!stop.load(std::memory_order_relaxed)) {
+                int train_num = static_cast<int>(rng() % num_trains);
+                int seats = BOOK_MIN + static_cast<int>(rng() % (BOOK_MAX - BOOK_MIN + 1));
+                if (rng() % 2 == 0) engine_book(ENGINE_MUTEX, train_num, seats, per_thread[t]);
+                else engine_cancel(ENGINE_MUTEX, train_num, seats, per_thread[t]);
+            }
+        });
+    }
+
+    ConsistentReadStats stats;
+    std::vector<std::uint64_t> states(num_trains);
+    std::vector<std::unique_lock<RobustMutex>> locks(lock_stripes);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (lock_all) {
+            for (int i = 0; i < lock_stripes; i++) locks[i] = std::unique_lock<RobustMutex>(train_mutex[i]);
+            for (int i = 0; i < num_trains; i++) states[i] = train_state[i].load(std::memory_order_relaxed);
+            for (std::unique_lock<RobustMutex>& lock : locks) lock.unlock();
+            stats.reads++;
+        } else {
+            read_consistent_states(states.data(), num_trains, stats);
+        }
+        bench_sink.fetch_add(static_cast<long long>(states[0]), std::memory_order_relaxed);
+    }
+    stop = true;
+    for (std::thread& client : clients) client.join();
+
+    EngineStats total;
+    for (const EngineStats& client_stats : per_thread) merge_engine_stats(total, client_stats);
+    cout << "\n--- Live report benchmark: " << threads << " booking threads, "
+         << (lock_all ? "reader takes all train locks" : "lock-free consistent reader") << " ---\n";
+    cout << "Bookings/cancellations: " << total.operations / seconds << " ops/s" << endl;
+    cout << "Reports:                " << stats.reads / seconds << " reads/s" << endl;
+    if (!lock_all) print_consistent_read_stats(stats);
+}
+
+// Seats a journaled operation moved, signed as it changed the train's count.
+int journal_seat_change(const JournalRecord& record) {
+    switch (record.op) {
+        case JOURNAL_BOOK:
+        case JOURNAL_HOLD:
+        case JOURNAL_PROMOTE:
+        case JOURNAL_ITINERARY:
+            return -record.seats;
+        case JOURNAL_CANCEL:
+        case JOURNAL_HOLD_RELEASE:
+        case JOURNAL_HOLD_EXPIRE:
+        case JOURNAL_COMPENSATE:
+            return record.seats;
+        default:
+            return 0;
+    }
+}
+
+// --crash-torture's ledger check: walks each train's journaled words in version order from the
+// compacted checkpoint and counts the records that do not follow from the one before: a count
+// outside [0, CAPACITY] before or after the operation, a repeated version, or seats that differ
+// from the previous version's once the operation is undone. Versions a crash lost leave gaps,
+// which are not checked across.
+long long journal_ledger_breaks(const string& wal_path, const JournalCheckpoint& checkpoint) {
+    std::vector<std::vector<JournalRecord>> by_train(num_trains);
+    for (const string& path : journal_replay_paths(wal_path, checkpoint)) {
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (file == nullptr) continue;
+        JournalRecord record;
+        while (std::fread(&record, sizeof(record), 1, file) == 1) {
+            if (journal_record_valid(record, num_trains) && record.op != JOURNAL_HOLD_CONFIRM) {
+                by_train[record.train_num].push_back(record);
+            }
+        }
+        std::fclose(file);
+    }
+
+    long long breaks = 0;
+    for (int i = 0; i < num_trains; i++) {
+        std::uint64_t base = checkpoint.words.empty() ? pack_state(CAPACITY, 0) : checkpoint.words[i];
+        std::uint32_t base_version = state_version(base);
+        std::vector<JournalRecord>& records = by_train[i];
+        std::sort(records.begin(), records.end(), [&](const JournalRecord& a, const JournalRecord& b) {
+            return a.version_after - base_version < b.version_after - base_version;
+        });
+        int seats = state_seats(base);
+        std::uint32_t last_offset = 0;
+        for (const JournalRecord& record : records) {
+            std::uint32_t offset = record.version_after - base_version;
+            if (offset == 0 || offset > INT32_MAX) continue; // Already folded into the checkpoint
+            int before = record.seats_after - journal_seat_change(record);
+            bool in_range = before >= 0 && before <= CAPACITY && record.seats_after >= 0 && record.seats_after <= CAPACITY;
+            bool follows = offset != last_offset + 1 || before == seats;
+            if (offset == last_offset || !in_range || !follows) breaks++;
+            seats = record.seats_after;
+            last_offset = offset;
+        }
+    }
+    return breaks;
+}
+
+// --crash-torture child: a booking storm against the store and journal that only ends with
+// SIGKILL. Every operation is acknowledged on ack_fd with the train and state word its journal
+// record carries once that record is durable, exactly when a real client would be told "booked".
+void crash_torture_child(const string& store_path, const string& wal_path, int ack_fd, unsigned seed) {
+    int null_fd = ::open("/dev/null", O_WRONLY);
+    if (null_fd >= 0) ::dup2(null_fd, STDOUT_FILENO);
+    checkpoint_interval_ms = TORTURE_CHECKPOINT_MS;
+    journal_segment_bytes = TORTURE_SEGMENT_BYTES;
+    compaction_interval_ms = TORTURE_COMPACTION_MS;
+    const EngineMode modes[] = {ENGINE_MUTEX, ENGINE_ATOMIC, ENGINE_OCC};
+    engine_mode = modes[seed % 3];
+    for (int i = 0; i < num_trains; i++) train_state[i] = pack_state(CAPACITY, 0);
+    if (!open_durable_state(store_path.c_str(), wal_path.c_str())) ::_exit(2);
+    hold_expiry_running = true;
+    hold_expiry_thread = std::thread(hold_expiry_loop);
+
+    auto storm = [&](int thread_num) {
+        std::mt19937 rng(seed * 31 + thread_num);
+        EngineStats stats;
+        while (true) {
+            int train_num = static_cast<int>(rng() % num_trains);
+            int seats = BOOK_MIN + static_cast<int>(rng() % (BOOK_MAX - BOOK_MIN + 1));
+            unsigned kind = rng() % 4;
+            if (kind == 0) {
+                engine_book(engine_mode, train_num, seats, stats);
+            } else if (kind == 1) {
+                engine_cancel(engine_mode, train_num, seats, stats);
+            } else {
+                HoldId id;
+                {
+                    std::lock_guard<RobustMutex> lock(train_mutex_of(train_num));
+                    id = place_hold(train_num, seats, 50);
+                }
+                // Paid, cancelled, or left to the expiry thread (and possibly to recovery)
+                if (id != 0 && kind == 2 && rng() % 2 == 0) confirm_hold(id);
+                if (id != 0 && kind == 3 && rng() % 2 == 0) release_hold(id, thread_num);
+            }
+            if (journal_last_seq == 0) continue;
+            JournalAck ack = journal_last_ack;
+            if (!journal_wait()) ::_exit(4); // Never acknowledge what is not durable
+            if (::write(ack_fd, &ack, sizeof(ack)) != static_cast<ssize_t>(sizeof(ack))) ::_exit(3);
+        }
+    };
+    for (int i = 0; i < MAX_THREADS; i++) threads[i] = std::thread(storm, i);
+    threads[0].join(); // Never returns; the parent kills the process
+}
+
+// --crash-torture DIR [rounds]: runs the booking storm in a child, SIGKILLs it at a random
+// moment, then recovers the way a restart does (store checkpoint + parallel journal replay) and
+// checks:
+//   - the result is byte-identical to replaying the compacted journal checkpoint and the
+//     segments after it from the initial state,
+//   - every acknowledged operation survived: each train holds the word of its newest
+//     acknowledgement, seats included, or a newer one,
+//   - seat counts are within [0, CAPACITY],
+//   - the journal is a ledger: every record's seats follow from the version before it
+//     (journal_ledger_breaks), so a word no real sequence of bookings produced cannot pass.
+// Trains whose recovered word differs from the dead process's memory only lost changes that
+// were never acknowledged. The child rolls and compacts journal segments every few milliseconds,
+// so kills also land inside compaction passes. Each round restarts from the previous round's files.
+int crash_torture(const char* dir, int rounds) {
+    string store_path = string(dir) + "/torture.store";
+    string wal_path = string(dir) + "/torture.wal";
+    ::unlink(store_path.c_str());
+    remove_journal_files(wal_path);
+    std::mt19937 rng(static_cast<unsigned>(std::time(nullptr)));
+    std::vector<std::uint64_t> acked_state(num_trains);
+    std::vector<bool> acked(num_trains, false);
+    int failures = 0;
+
+    cout << "--- Crash torture: " << rounds << " rounds in " << dir << " ---\n";
+    cout << "round\tkill ms\trecords\tsegs\tckpt seq\treplay us\tidentical\tacks\tledger\tlost in flight\n";
+    for (int round = 1; round <= rounds; round++) {
+        int ack_pipe[2];
+        if (::pipe(ack_pipe) != 0) return 1;
+        unsigned seed = static_cast<unsigned>(rng());
+        int kill_after_ms = 50 + static_cast<int>(rng() % 400);
+        cout.flush();
+        pid_t pid = ::fork();
+        if (pid == 0) {
+            ::close(ack_pipe[0]);
+            crash_torture_child(store_path, wal_path, ack_pipe[1], seed);
+            ::_exit(0);
+        }
+        ::close(ack_pipe[1]);
+        if (pid < 0) return 1;
+
+        // Collect acknowledgements until the kill, then whatever was still in the pipe
+        long long acks = 0;
+        auto absorb = [&](const JournalAck* received, std::size_t count) {
+            for (std::size_t i = 0; i < count; i++) {
+                int train_num = static_cast<int>(received[i].train_num);
+                std::uint64_t state = received[i].state_after;
+                if (train_num < 0 || train_num >= num_trains) continue;
+                if (!acked[train_num] || version_at_least(state_version(state), state_version(acked_state[train_num]))) {
+                    acked_state[train_num] = state;
+                    acked[train_num] = true;
+                }
+                acks++;
+            }
+        };
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kill_after_ms);
+        bool killed = false;
+        JournalAck buffer[256];
+        std::size_t buffered_bytes = 0;
+        while (true) {
+            int timeout_ms = 100;
+            if (!killed) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+                if (left <= 0) {
+                    ::kill(pid, SIGKILL);
+                    killed = true;
+                } else {
+                    timeout_ms = static_cast<int>(left);
+                }
+            }
+            struct pollfd pfd = {ack_pipe[0], POLLIN, 0};
+            if (::poll(&pfd, 1, timeout_ms) <= 0) continue;
+            ssize_t got = ::read(ack_pipe[0], reinterpret_cast<char*>(buffer) + buffered_bytes,
+                                 sizeof(buffer) - buffered_bytes);
+            if (got <= 0) {
+                if (got < 0 && errno == EINTR) continue;
+                break; // EOF: the child is gone and the pipe is drained
+            }
+            buffered_bytes += static_cast<std::size_t>(got);
+            std::size_t whole = buffered_bytes / sizeof(JournalAck);
+            absorb(buffer, whole);
+            buffered_bytes -= whole * sizeof(JournalAck);
+            std::memmove(buffer, buffer + whole, buffered_bytes);
+        }
+        ::close(ack_pipe[0]);
+        int status = 0;
+        while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
+        if (!WIFSIGNALED(status)) {
+            cout << round << ": child exited on its own (status " << status << ")" << endl;
+            failures++;
+            continue;
+        }
+
+        // What the dead process had in memory, before recovery overwrites the live region
+        std::vector<std::uint64_t> before_crash(num_trains);
+        if (!SeatStore::peek_live(store_path, before_crash.data(), num_trains)) {
+            cout << round << ": killed before the store existed" << endl;
+            continue;
+        }
+
+        // Recovery exactly as a restart performs it
+        SeatStore store;
+        if (store.open(store_path, num_trains, STORE_DAYS, pack_state(CAPACITY, 0)) == SeatStore::STORE_FAILED) {
+            cout << round << ": store did not open: " << store.last_error() << endl;
+            failures++;
+            continue;
+        }
+        JournalCheckpoint compacted;
+        RecoveryStats recovery;
+        bool replayed = load_journal_checkpoint(wal_path, num_trains, compacted) &&
+                        recover_journal(wal_path, compacted, store.slots(), recovery_threads(), recovery);
+
+        // Reference: the compacted journal replayed onto the initial state
+        std::vector<std::atomic<std::uint64_t>> reference(num_trains);
+        for (std::atomic<std::uint64_t>& word : reference) word = pack_state(CAPACITY, 0);
+        RecoveryStats full;
+        replayed = replayed && recover_journal(wal_path, compacted, reference.data(), 1, full);
+
+        bool identical = replayed;
+        bool acks_ok = true;
+        int lost_in_flight = 0;
+        for (int i = 0; i < num_trains; i++) {
+            std::uint64_t recovered = store.slots()[i].load();
+            if (recovered != reference[i].load()) identical = false;
+            int seats = state_seats(recovered);
+            if (seats < 0 || seats > CAPACITY) identical = false;
+            if (acked[i] && recovered != acked_state[i] &&
+                !version_at_least(state_version(recovered), state_version(acked_state[i]) + 1)) {
+                acks_ok = false;
+            }
+            if (recovered != before_crash[i]) lost_in_flight++;
+        }
+        long long ledger_breaks = replayed ? journal_ledger_breaks(wal_path, compacted) : -1;
+        std::uint64_t sequence = store.checkpoint_sequence();
+        store.close();
+
+        cout << round << "\t" << kill_after_ms << "\t" << recovery.records << "\t"
+             << compacted.through_segment << "\t" << sequence << "\t\t"
+             << recovery.replay_ns / 1000 << "\t\t" << (identical ? "yes" : "NO") << "\t\t"
+             << (acks_ok ? "ok" : "LOST") << " (" << acks << ")\t"
+             << (ledger_breaks == 0 ? "ok" : "BROKEN") << "\t" << lost_in_flight << endl;
+        if (!identical || !acks_ok || ledger_breaks != 0) failures++;
+    }
+
+    if (failures == 0) cout << "All rounds recovered correctly." << endl;
+    else cout << "RECOVERY FAILURES: " << failures << " (files kept in " << dir << ")" << endl;
+    if (failures == 0) {
+        ::unlink(store_path.c_str());
+        remove_journal_files(wal_path);
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+// --bench-recovery DIR [max records]: journal replay time against journal length and replay
+// threads. Journals are synthetic: random trains, per-train versions counting up, and a booking /
+// cancellation / hold mix, written to DIR and replayed from the page cache.
+int bench_recovery(const char* dir, long long max_records) {
+    string path = string(dir) + "/bench_recovery.wal";
+    cout << "--- Recovery benchmark (" << num_trains << " trains, up to " << recovery_threads()
+         << " replay threads) ---\n";
+    bool all_identical = true;
+    for (long long n = 10000; n <= max_records; n *= 10) {
+        FILE* file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            cerr << "Cannot create " << path << ": " << std::strerror(errno) << endl;
+            return 1;
+        }
+        std::mt19937 rng(static_cast<unsigned>(n));
+        std::vector<std::uint64_t> state(num_trains, pack_state(CAPACITY, 0));
+        HoldId next_hold = 1;
+        for (long long i = 0; i < n; i++) {
+            int train_num = static_cast<int>(rng() % num_trains);
+            int seats = BOOK_MIN + static_cast<int>(rng() % (BOOK_MAX - BOOK_MIN + 1));
+            int available = state_seats(state[train_num]);
+            JournalRecord record;
+            std::memset(&record, 0, sizeof(record));
+            record.train_num = train_num;
+            record.seats = seats;
+            if (available >= seats && rng() % 2 == 0) {
+                record.op = rng() % 8 == 0 ? JOURNAL_HOLD : JOURNAL_BOOK;
+                if (record.op == JOURNAL_HOLD) record.hold_id = next_hold++;
+                available -= seats;
+            } else if (available + seats <= CAPACITY) {
+                record.op = JOURNAL_CANCEL;
+                available += seats;
+            } else {
+                record.op = JOURNAL_COMPENSATE;
+            }
+            state[train_num] = pack_state(available, state_version(state[train_num]) + 1);
+            record.seats_after = available;
+            record.version_after = state_version(state[train_num]);
+            record.crc = journal_record_crc(record);
+            std::fwrite(&record, sizeof(record), 1, file);
+        }
+        std::fclose(file);
+
+        for (int threads = 1;; threads = std::min(threads * 2, recovery_threads())) {
+            std::vector<std::atomic<std::uint64_t>> states(num_trains);
+            for (std::atomic<std::uint64_t>& word : states) word = pack_state(CAPACITY, 0);
+            RecoveryStats stats;
+            replay_journal(path.c_str(), states.data(), num_trains, threads, stats);
+            bool identical = stats.records == n;
+            for (int i = 0; i < num_trains; i++) identical = identical && states[i].load() == state[i];
+            all_identical = all_identical && identical;
+            cout << "  " << n << " records\t" << stats.journal_bytes / 1048576 << " MiB\t" << threads
+                 << " threads\t" << stats.replay_ns / 1000000.0 << " ms\t"
+                 << stats.records * 1000.0 / stats.replay_ns << " Mrec/s\t"
+                 << (identical ? "identical" : "MISMATCH") << endl;
+            if (threads == recovery_threads()) break;
+        }
+    }
+    ::unlink(path.c_str());
+    return all_identical ? 0 : 1;
+}
+
+// `threads` committers append 32-byte records to `wal` and wait for each to be durable, as
+// journal_state() + journal_wait() do, for `seconds`. Returns every commit latency (append until
+// durable) in ns, sorted.
+std::vector<long long> run_committers(WalWriter& wal, int threads, int seconds) {
+    std::atomic<bool> running{true};
+    std::vector<std::vector<long long>> latencies(threads);
+    std::vector<std::thread> committers;
+    for (int t = 0; t < threads; t++) {
+        committers.emplace_back([&, t] {
+            std::vector<long long>& samples = latencies[t];
+            samples.reserve(1 << 16);
+            int train_num = t % num_trains;
+            std::uint32_t version = 0;
+            while (running.load(std::memory_order_relaxed)) {
+                auto start = std::chrono::steady_clock::now();
+                std::uint64_t seq = wal.append_in_place(sizeof(JournalRecord), [&](char* dst) {
+                    JournalRecord* record = new (dst) JournalRecord();
+                    record->train_num = train_num;
+                    record->seats = BOOK_MIN;
+                    record->version_after = ++version;
+                    record->op = JOURNAL_BOOK;
+                    record->crc = journal_record_crc(*record);
+                });
+                if (!wal.wait_durable(seq)) break;
+                samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    running = false;
+    for (std::thread& committer : committers) committer.join();
+
+    std::vector<long long> all;
+    for (const std::vector<long long>& samples : latencies) all.insert(all.end(), samples.begin(), samples.end());
+    std::sort(all.begin(), all.end());
+    return all;
+}
+
+long long latency_percentile(const std::vector<long long>& sorted, double p) {
+    return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(p * sorted.size()))];
+}
+
+// Journal writer benchmark: commits/s and commit latency percentiles for one I/O mode.
+void bench_wal(const char* path, WalWriter::IoMode mode, int threads, int seconds) {
+    ::unlink(path);
+    WalWriter wal;
+    if (!wal.open(path, mode)) {
+        cerr << "Cannot open " << path << ": " << std::strerror(errno) << endl;
+        return;
+    }
+    if (wal.io_mode() != mode) {
+        cout << "  " << WalWriter::io_mode_name(mode) << " unavailable ("
+             << std::strerror(wal.uring_fallback_errno()) << "), skipped" << endl;
+        wal.close();
+        ::unlink(path);
+        return;
+    }
+
+    std::vector<long long> all = run_committers(wal, threads, seconds);
+    WalWriter::Stats stats = wal.stats();
+    wal.close();
+    ::unlink(path);
+
+    long long batches = stats.batches > 0 ? stats.batches : 1;
+    cout << "  " << WalWriter::io_mode_name(mode) << "\t" << all.size() / seconds << " commits/s\t"
+         << "p50 " << latency_percentile(all, 0.50) / 1000 << " us\tp99 "
+         << latency_percentile(all, 0.99) / 1000 << " us\t"
+         << "p99.9 " << latency_percentile(all, 0.999) / 1000 << " us\t"
+         << "batch avg " << static_cast<double>(stats.records) / batches << "\t"
+         << "flush avg " << stats.flush_ns_total / batches / 1000 << " us" << endl;
+}
+
+// --bench-compaction DIR [threads] [seconds]: journal commit latency with the compactor off and
+// on. Committers append and wait as in --bench-wal on a journal that rolls over every 256 KiB;
+// with the compactor on, closed segments are folded and deleted as they appear. A throttled,
+// low-priority compactor should leave the p99 where it was.
+int bench_compaction(const char* dir, int threads, int seconds) {
+    string wal_path = string(dir) + "/compaction.wal";
+    journal_path = wal_path;
+    compaction_interval_ms = 100;
+    cout << "--- Journal compaction benchmark: " << threads << " committers, " << seconds << " s per run ---\n";
+    for (int pass = 0; pass < 2; pass++) {
+        bool compact = pass == 1;
+        remove_journal_files(wal_path);
+        journal_checkpoint = JournalCheckpoint();
+        compaction_totals = CompactionStats();
+        WalWriter wal;
+        wal.set_segments(256 << 10, 1);
+        if (!wal.open(wal_path, WalWriter::IO_WRITE)) {
+            cerr << "Cannot open " << wal_path << ": " << std::strerror(errno) << endl;
+            return 1;
+        }
+        if (compact) start_compactor();
+        std::vector<long long> all = run_committers(wal, threads, seconds);
+        if (compact) stop_compactor();
+        WalWriter::Stats stats = wal.stats();
+        wal.close();
+        cout << "  compactor " << (compact ? "on " : "off") << "\t" << all.size() / seconds << " commits/s\t"
+             << "p50 " << latency_percentile(all, 0.50) / 1000 << " us\tp99 "
+             << latency_percentile(all, 0.99) / 1000 << " us\tp99.9 "
+             << latency_percentile(all, 0.999) / 1000 << " us\t"
+             << stats.segments_closed << " segments closed, "
+             << list_journal_segments(wal_path).size() << " left on disk" << endl;
+        if (compact) print_compaction_stats(compaction_totals, stats.bytes, journal_checkpoint);
+    }
+    remove_journal_files(wal_path);
+    return 0;
+}
+
+// Admission for benchmark clients: worker_thread's access_mutex / access_cond gate, with the
+// limit as a parameter instead of MAX_CONCURRENT_ACCESS (0: no gate). Returns the ns spent
+// blocked on the gate's mutex or waiting for a slot; an uncontended admission returns 0.
+long long bench_admit(int limit) {
+    if (limit <= 0) return 0;
+    std::unique_lock<std::mutex> load_lock(access_mutex, std::try_to_lock);
+    if (load_lock.owns_lock() && active_access_count < limit) {
+        active_access_count++;
+        return 0;
+    }
+    auto start = std::chrono::steady_clock::now();
+    if (!load_lock.owns_lock()) load_lock.lock();
+    access_cond.wait(load_lock, [limit] { return active_access_count < limit; });
+    active_access_count++;
+    load_lock.unlock();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void bench_leave(int limit) {
+    if (limit <= 0) return;
+    {
+        std::lock_guard<std::mutex> release_lock(access_mutex);
+        active_access_count--;
+    }
+    access_cond.notify_one();
+}
+
+// --bench-open-loop [threads] [seconds per rate] [poisson|constant]: throughput vs latency per
+// engine. worker_thread is a closed loop: it sends its next request only once the previous one
+// is answered, so while the system stalls the load stalls with it and the requests that should
+// have queued up behind the stall are never measured (coordinated omission). Here every thread
+// follows an arrival schedule fixed in advance at rate / threads -- exponential gaps (Poisson)
+// or even ones -- and keeps to it whether or not earlier requests are done: a thread that falls
+// behind sends its overdue requests back to back. Latency runs from the intended send time, so
+// it includes the time a request spent waiting for the generator to get to it.
+//
+// Requests take the simulation's path minus the printing: admission (MAX_CONCURRENT_ACCESS),
+// then half inquiries, a quarter bookings and a quarter cancellations through execute_request.
+// Each engine's closed-loop capacity is measured first and the rates swept as fractions of it,
+// which puts the knee of the curve in view on any machine.
+struct OpenLoopRun {
+    double achieved = 0;              // Completed requests per second
+    long long dropped = 0;            // Scheduled but never sent: the run was cut off behind schedule
+    std::vector<long long> latencies; // ns from intended send to completion, sorted
+    std::vector<long long> service;   // ns from actual send to completion, sorted
+};
+
+// rate 0: closed loop, each thread sends as soon as its previous request completes.
+OpenLoopRun run_open_loop(double rate, int threads, int seconds, bool poisson) {
+    typedef std::chrono::steady_clock clock;
+    for (int i = 0; i < num_trains; i++) {
+        train_state[i] = pack_state(CAPACITY / 2, 0);
+        held_seats[i] = 0;
+    }
+    recount_occupancy();
+    if (availability_tree_enabled) availability_tree.build(train_state, num_trains);
+    std::vector<std::vector<long long>> latencies(threads), service(threads);
+    std::vector<long long> dropped(threads, 0);
+    std::vector<std::thread> generators;
+    auto start = clock::now() + std::chrono::milliseconds(10); // Let every thread get going first
+    auto end = start + std::chrono::seconds(seconds);
+    auto cutoff = end + std::chrono::seconds(seconds); // Give up on a backlog after twice the run
+    for (int t = 0; t < threads; t++) {
+        generators.emplace_back([&, t] {
+            std::mt19937 rng(t * 15485863 + static_cast<unsigned>(rate));
+            std::exponential_distribution<double> exponential(rate / threads);
+            double mean_gap = rate > 0 ? threads / rate : 0;
+            auto next_gap = [&] {
+                double gap = poisson ? exponential(rng) : mean_gap;
+                return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(gap));
+            };
+            EngineStats engine_stats;
+            ServerStats stats;
+            latencies[t].reserve(1 << 16);
+            service[t].reserve(1 << 16);
+            clock::time_point intended = rate > 0 ? start + next_gap() : start;
+            std::this_thread::sleep_until(start);
+            while (intended < end) {
+                clock::time_point now = clock::now();
+                if (now >= cutoff) {
+                    while (intended < end) {
+                        dropped[t]++;
+                        intended += next_gap();
+                    }
+                    break;
+                }
+                // Sleep through long gaps, yield through short ones: sleep_until overshoots by
+                // tens of microseconds, and that would count against the system under test.
+                if (intended - now > std::chrono::microseconds(200)) {
+                    std::this_thread::sleep_until(intended - std::chrono::microseconds(100));
+                }
+                while (clock::now() < intended) std::this_thread::yield();
+
+                clock::time_point sent = clock::now();
+                bench_admit(MAX_CONCURRENT_ACCESS);
+                Request request;
+                int roll = static_cast<int>(rng() % 100);
+                request.op = roll < 50 ? REQ_INQUIRY : roll < 75 ? REQ_BOOK : REQ_CANCEL;
+                request.request_id = 0;
+                request.train_num = static_cast<std::uint32_t>(rng() % num_trains);
+                request.seats = static_cast<std::uint16_t>(BOOK_MIN + rng() % (BOOK_MAX - BOOK_MIN + 1));
+                execute_request(request, engine_stats, stats);
+                bench_leave(MAX_CONCURRENT_ACCESS);
+                clock::time_point done = clock::now();
+
+                if (rate > 0) {
+                    latencies[t].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(done - intended).count());
+                    intended += next_gap();
+                } else {
+                    intended = done;
+                }
+                service[t].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(done - sent).count());
+            }
+        });
+    }
+    for (std::thread& generator : generators) generator.join();
+    double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+    OpenLoopRun run;
+    for (int t = 0; t < threads; t++) {
+        run.latencies.insert(run.latencies.end(), latencies[t].begin(), latencies[t].end());
+        run.service.insert(run.service.end(), service[t].begin(), service[t].end());
+        run.dropped += dropped[t];
+    }
+    std::sort(run.latencies.begin(), run.latencies.end());
+    std::sort(run.service.begin(), run.service.end());
+    run.achieved = run.service.size() / elapsed;
+    return run;
+}
+
+int bench_open_loop(int threads, int seconds, bool poisson) {
+    const EngineMode modes[] = {ENGINE_MUTEX, ENGINE_ATOMIC, ENGINE_OCC};
+    const int load_percents[] = {10, 25, 50, 70, 80, 90, 100, 110};
+    cout << "--- Open-loop benchmark: " << threads << " threads, " << (poisson ? "Poisson" : "constant-rate")
+         << " arrivals, " << seconds << " s per rate ---\n";
+    cout << std::fixed << std::setprecision(1);
+    for (EngineMode mode : modes) {
+        engine_mode = mode;
+        OpenLoopRun closed = run_open_loop(0, threads, seconds, poisson);
+        double capacity = closed.achieved;
+        cout << "  " << engine_name(mode) << ": closed-loop capacity " << capacity / 1000 << " kreq/s, "
+             << "p99 " << latency_percentile(closed.service, 0.99) / 1000.0 << " us" << endl;
+        cout << "    load\toffered kreq/s\tachieved kreq/s\tp50 us\tp99 us\tp99.9 us\tmax us\tservice p99 us\n";
+        for (int percent : load_percents) {
+            double rate = capacity * percent / 100;
+            OpenLoopRun run = run_open_loop(rate, threads, seconds, poisson);
+            cout << "    " << percent << "%\t" << rate / 1000 << "\t\t" << run.achieved / 1000 << "\t\t"
+                 << latency_percentile(run.latencies, 0.50) / 1000.0 << "\t"
+                 << latency_percentile(run.latencies, 0.99) / 1000.0 << "\t"
+                 << latency_percentile(run.latencies, 0.999) / 1000.0 << "\t\t"
+                 << (run.latencies.empty() ? 0 : run.latencies.back()) / 1000.0 << "\t"
+                 << latency_percentile(run.service, 0.99) / 1000.0;
+            if (run.dropped > 0) cout << "\t(" << run.dropped << " never sent)";
+            cout << endl;
+        }
+    }
+    return 0;
+}
+
+// --bench-scaling [seconds per configuration] [csv|json]: scaling curves without recompiling.
+// MAX_THREADS, MAX_CONCURRENT_ACCESS and DEFAULT_TRAINS fix the simulation's shape at build time;
+// this sweeps thread count, admission limit, train count and skew one at a time, the others
+// held at those defaults, for every engine. Clients run closed-loop through the same admission
+// gate and request mix as --bench-open-loop. One row per run goes to stdout (progress goes to
+// stderr), so the output can be fed straight to a plotting script.
+//
+// lock_wait_share is the fraction of request time spent blocked: waiting for an admission slot
+// plus, with the mutex engine, waiting for a contended train lock.
+struct ScalingConfig {
+    const char* sweep; // Which parameter this run varies
+    EngineMode mode;
+    int threads;
+    int admission_limit; // 0: no admission gate
+    int trains;
+    double skew;         // Zipf exponent of the train popularity; 0 is uniform
+};
+
+struct ScalingResult {
+    long long requests = 0;
+    double throughput = 0;
+    long long p50_ns = 0;
+    long long p99_ns = 0;
+    double lock_wait_share = 0;
+    EngineStats engine;
+};
+
+// Zipf over [0, n): train k is drawn with probability proportional to 1 / (k + 1)^skew, so at a
+// skew near 1 a handful of trains take most of the traffic.
+class ZipfSampler {
+public:
+    ZipfSampler(int n, double skew) : cdf(n) {
+        double total = 0;
+        for (int k = 0; k < n; k++) {
+            total += 1.0 / std::pow(k + 1.0, skew);
+            cdf[k] = total;
+        }
+        for (double& c : cdf) c /= total;
+    }
+    int operator()(std::mt19937& rng) {
+        double u = uniform(rng);
+        int k = static_cast<int>(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+        return std::min(k, static_cast<int>(cdf.size()) - 1);
+    }
+
+private:
+    std::vector<double> cdf;
+    std::uniform_real_distribution<double> uniform{0.0, 1.0};
+};
+
+ScalingResult run_scaling(const ScalingConfig& config, int seconds) {
+    engine_mode = config.mode;
+    for (int i = 0; i < num_trains; i++) {
+        train_state[i] = pack_state(CAPACITY / 2, 0);
+        held_seats[i] = 0;
+    }
+    recount_occupancy();
+    if (availability_tree_enabled) availability_tree.build(train_state, num_trains);
+    std::vector<std::vector<long long>> latencies(config.threads);
+    std::vector<EngineStats> engine_stats(config.threads);
+    std::vector<long long> admission_wait(config.threads, 0), busy(config.threads, 0);
+    std::vector<std::thread> clients;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    for (int t = 0; t < config.threads; t++) {
+        clients.emplace_back([&, t] {
+            std::mt19937 rng(t * 2654435761u + config.trains);
+            ZipfSampler pick_train(config.trains, config.skew);
+            ServerStats stats;
+            std::vector<long long>& samples = latencies[t];
+            samples.reserve(1 << 16);
+            while (true) {
+                auto start = std::chrono::steady_clock::now();
+                if (start >= deadline) break;
+                Request request;
+                int roll = static_cast<int>(rng() % 100);
+                request.op = roll < 50 ? REQ_INQUIRY : roll < 75 ? REQ_BOOK : REQ_CANCEL;
+                request.request_id = 0;
+                request.train_num = static_cast<std::uint32_t>(pick_train(rng));
+                request.seats = static_cast<std::uint16_t>(BOOK_MIN + rng() % (BOOK_MAX - BOOK_MIN + 1));
+                admission_wait[t] += bench_admit(config.admission_limit);
+                execute_request(request, engine_stats[t], stats);
+                bench_leave(config.admission_limit);
+                long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+                samples.push_back(ns);
+                busy[t] += ns;
+            }
+        });
+    }
+    for (std::thread& client : clients) client.join();
+
+    ScalingResult result;
+    std::vector<long long> all;
+    long long blocked = 0, total_busy = 0;
+    for (int t = 0; t < config.threads; t++) {
+        all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+        merge_engine_stats(result.engine, engine_stats[t]);
+        blocked += admission_wait[t];
+        total_busy += busy[t];
+    }
+    blocked += result.engine.lock_wait_ns;
+    std::sort(all.begin(), all.end());
+    result.requests = static_cast<long long>(all.size());
+    result.throughput = static_cast<double>(all.size()) / seconds;
+    result.p50_ns = latency_percentile(all, 0.50);
+    result.p99_ns = latency_percentile(all, 0.99);
+    result.lock_wait_share = total_busy > 0 ? static_cast<double>(blocked) / total_busy : 0;
+    return result;
+}
+
+int bench_scaling(int seconds, bool json) {
+    std::vector<ScalingConfig> configs;
+    const EngineMode modes[] = {ENGINE_MUTEX, ENGINE_ATOMIC, ENGINE_OCC};
+    for (EngineMode mode : modes) {
+        for (int threads : {1, 2, 4, 8, 16, 32, 64}) {
+            configs.push_back({"threads", mode, threads, MAX_CONCURRENT_ACCESS, num_trains, 0});
+        }
+        for (int limit : {1, 2, 5, 10, 20, 0}) {
+            configs.push_back({"admission_limit", mode, MAX_THREADS, limit, num_trains, 0});
+        }
+        for (int trains : {1, 2, 5, 10, 25, 50, 100, 1000, 100000, 1000000}) {
+            if (trains <= num_trains) configs.push_back({"trains", mode, MAX_THREADS, MAX_CONCURRENT_ACCESS, trains, 0});
+        }
+        for (double skew : {0.0, 0.5, 0.9, 0.99, 1.2, 1.5}) {
+            configs.push_back({"skew", mode, MAX_THREADS, MAX_CONCURRENT_ACCESS, num_trains, skew});
+        }
+    }
+
+    cerr << "--- Scaling sweep: " << configs.size() << " configurations, " << seconds << " s each ---\n";
+    if (json) {
+        cout << "[\n";
+    } else {
+        cout << "sweep,engine,threads,admission_limit,trains,skew,requests,throughput_rps,p50_us,p99_us,"
+                "lock_wait_share,conflicts,compensations\n";
+    }
+    for (std::size_t i = 0; i < configs.size(); i++) {
+        const ScalingConfig& c = configs[i];
+        ScalingResult r = run_scaling(c, seconds);
+        cerr << "  [" << i + 1 << "/" << configs.size() << "] " << engine_name(c.mode) << " " << c.sweep << ": "
+             << static_cast<long long>(r.throughput) << " req/s" << endl;
+        if (json) {
+            cout << "  {\"sweep\": \"" << c.sweep << "\", \"engine\": \"" << engine_name(c.mode)
+                 << "\", \"threads\": " << c.threads << ", \"admission_limit\": " << c.admission_limit
+                 << ", \"trains\": " << c.trains << ", \"skew\": " << c.skew << ", \"requests\": " << r.requests
+                 << ", \"throughput_rps\": " << static_cast<long long>(r.throughput)
+                 << ", \"p50_us\": " << r.p50_ns / 1000.0 << ", \"p99_us\": " << r.p99_ns / 1000.0
+                 << ", \"lock_wait_share\": " << r.lock_wait_share << ", \"conflicts\": " << r.engine.conflicts
+                 << ", \"compensations\": " << r.engine.compensations << "}"
+                 << (i + 1 < configs.size() ? "," : "") << "\n";
+        } else {
+            cout << c.sweep << "," << engine_name(c.mode) << "," << c.threads << "," << c.admission_limit << ","
+                 << c.trains << "," << c.skew << "," << r.requests << "," << static_cast<long long>(r.throughput)
+                 << "," << r.p50_ns / 1000.0 << "," << r.p99_ns / 1000.0 << "," << r.lock_wait_share << ","
+                 << r.engine.conflicts << "," << r.engine.compensations << "\n";
+        }
+    }
+    if (json) cout << "]\n";
+    return 0;
+}
+
+// --bench-trains [threads] [seconds per run]: memory per train and throughput as the table grows
+// to a million trains. Each size runs with one lock per train and with fewer, shared lock
+// stripes; clients inquire, book and cancel on uniformly random trains with the mutex and atomic
+// engines and no admission gate. Once the table outgrows the caches, a request misses on its
+// train's state word and, with a lock per train, on its lock as well.
+int bench_trains(int threads, int seconds) {
+    cout << "--- Train table benchmark: " << threads << " threads, " << seconds << " s per run ---\n";
+    cout << "trains\tstripes\tbytes/train\tmutex kreq/s\tp99 us\tatomic kreq/s\tp99 us\n";
+    for (int trains : {1000, 100000, 1000000}) {
+        for (int stripes : {trains, DEFAULT_MAX_LOCK_STRIPES, 64}) {
+            if (stripes >= trains && stripes != trains) continue;
+            allocate_train_table(trains, stripes);
+            ScalingResult mutex = run_scaling({"trains", ENGINE_MUTEX, threads, 0, trains, 0}, seconds);
+            ScalingResult atomic = run_scaling({"trains", ENGINE_ATOMIC, threads, 0, trains, 0}, seconds);
+            cout << trains << "\t" << lock_stripes << "\t" << std::fixed << std::setprecision(1)
+                 << static_cast<double>(train_table_bytes()) / trains << "\t\t"
+                 << mutex.throughput / 1000 << "\t\t" << mutex.p99_ns / 1000.0 << "\t"
+                 << atomic.throughput / 1000 << "\t\t" << atomic.p99_ns / 1000.0 << std::defaultfloat << endl;
+        }
+    }
+    allocate_train_table(DEFAULT_TRAINS, 0);
+    return 0;
+}
+
+// The simulation's engines behind the same interface: train_state, train_mutex and a run-time
+// switch on the engine mode, as execute_request uses them.
+template <EngineMode Mode>
+struct RuntimeEngine {
+    static constexpr int capacity = CAPACITY;
+    static constexpr bool shard_owned = false;
+
+    RuntimeEngine(int trains, int initial_seats) {
+        engine_mode = Mode;
+        for (int i = 0; i < trains; i++) {
+            train_state[i] = pack_state(initial_seats, 0);
+            held_seats[i] = 0;
+        }
+    }
+    template <typename Body>
+    int admitted(Body&& body) { return body(); }
+    int inquiry(int train_num) { return seats_available(train_num); }
+    bool book(int train_num, int seats) {
+        EngineStats local;
+        return engine_book(engine_mode, train_num, seats, local);
+    }
+    bool cancel(int train_num, int seats) {
+        EngineStats local;
+        return engine_cancel(engine_mode, train_num, seats, local);
+    }
+    std::size_t bytes(std::size_t trains) const {
+        return trains * sizeof(std::uint64_t) + (Mode == ENGINE_MUTEX ? lock_stripes * sizeof(RobustMutex) : 0) +
+               (Mode == ENGINE_ATOMIC ? trains * sizeof(std::atomic<int>) : 0); // booking_seats
+    }
+};
+
+template <typename Engine>
+void bench_policy(const char* name, int threads, int seconds) {
+    if (Engine::shard_owned && threads > num_trains) {
+        cout << "  " << std::left << std::setw(52) << name << std::right << "skipped: fewer trains than threads" << endl;
+        return;
+    }
+    std::unique_ptr<Engine> engine(new Engine(num_trains, Engine::capacity / 2));
+    std::vector<long long> requests(threads, 0);
+    std::vector<std::thread> clients;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    for (int t = 0; t < threads; t++) {
+        clients.emplace_back([&, t] {
+            std::mt19937 rng(t * 7919 + 17);
+            int owned = (num_trains - t + threads - 1) / threads; // Trains t, t + threads, ...
+            long long seen = 0;
+            while (std::chrono::steady_clock::now() < deadline) {
+                for (int batch = 0; batch < 64; batch++) {
+                    int train_num = Engine::shard_owned ? t + threads * static_cast<int>(rng() % owned)
+                                                        : static_cast<int>(rng() % num_trains);
+                    int seats = BOOK_MIN + static_cast<int>(rng() % (BOOK_MAX - BOOK_MIN + 1));
+                    int roll = static_cast<int>(rng() % 100);
+                    seen += engine->admitted([&] {
+                        if (roll < 50) return engine->inquiry(train_num);
+                        if (roll < 75) return static_cast<int>(engine->book(train_num, seats));
+                        return static_cast<int>(engine->cancel(train_num, seats));
+                    });
+                }
+                requests[t] += 64;
+            }
+            bench_sink.fetch_add(seen, std::memory_order_relaxed);
+        });
+    }
+    for (std::thread& client : clients) client.join();
+    long long total = 0;
+    for (long long count : requests) total += count;
+    cout << "  " << std::left << std::setw(52) << name << std::right << std::setw(10) << total / seconds / 1000
+         << " kreq/s" << std::setw(8) << std::fixed << std::setprecision(1)
+         << static_cast<double>(engine->bytes(num_trains)) / num_trains << " B/train" << std::defaultfloat << endl;
+}
+
+// --bench-policies [threads] [seconds per engine]: ReservationEngine instantiations side by
+// side, each with the inquiry/booking/cancellation mix of --bench-scaling on num_trains trains
+// starting half full. ShardOwned engines give every thread its own trains (train % threads);
+// the others spread requests uniformly. The last rows run the simulation's own engines, switched
+// at run time, through the same loop for comparison.
+int bench_policies(int threads, int seconds) {
+    const int WIDE_CAPACITY = 100000; // Needs uint32_t counters
+    cout << "--- Policy engine benchmark: " << threads << " threads, " << num_trains << " trains, " << seconds
+         << " s per engine ---\n";
+    bench_policy<ReservationEngine<VersionedWords, NoLocks, NoAdmission, CAPACITY>>(
+        "versioned words, CAS (occ)", threads, seconds);
+    bench_policy<ReservationEngine<AtomicCounters, NoLocks, NoAdmission, CAPACITY>>(
+        "atomic uint16_t counters, CAS", threads, seconds);
+    bench_policy<ReservationEngine<AtomicCounters, NoLocks, NoAdmission, WIDE_CAPACITY>>(
+        "atomic uint32_t counters, CAS", threads, seconds);
+    bench_policy<ReservationEngine<PlainCounters, StripedLocks<std::mutex>, NoAdmission, CAPACITY>>(
+        "plain uint16_t counters, striped std::mutex", threads, seconds);
+    bench_policy<ReservationEngine<PlainCounters, StripedLocks<RobustMutex>, NoAdmission, CAPACITY>>(
+        "plain uint16_t counters, striped RobustMutex", threads, seconds);
+    bench_policy<ReservationEngine<PlainCounters, ShardOwned, NoAdmission, CAPACITY>>(
+        "plain uint16_t counters, shard-owned (no locks)", threads, seconds);
+    bench_policy<ReservationEngine<VersionedWords, NoLocks, GateAdmission<MAX_CONCURRENT_ACCESS>, CAPACITY>>(
+        "versioned words, CAS, admission gate", threads, seconds);
+    bench_policy<ReservationEngine<VersionedWords, StripedLocks<RobustMutex>, GateAdmission<MAX_CONCURRENT_ACCESS>,
+                                   CAPACITY>>("versioned words, striped RobustMutex, admission gate", threads, seconds);
+
+    bench_policy<RuntimeEngine<ENGINE_MUTEX>>("runtime --engine=mutex (train_state, train_mutex)", threads, seconds);
+    bench_policy<RuntimeEngine<ENGINE_ATOMIC>>("runtime --engine=atomic (train_state, booking_seats)", threads, seconds);
+    bench_policy<RuntimeEngine<ENGINE_OCC>>("runtime --engine=occ (train_state)", threads, seconds);
+    return 0;
+}
+
+// --bench-coalescing [threads] [seconds per run] [service us]: flash sale. Every thread sends
+// inquiries (90%) and bookings or cancellations (10%) on a small hot set of trains through the
+// admission gate (MAX_CONCURRENT_ACCESS) and the train lock, as the mutex engine does, with and
+// without coalescing. Each admitted request also spends `service us` in the gate, standing in for
+// the simulation's logging, so requests queue there as they do in a sale. A coalesced inquiry
+// enters neither, so the counted gate entries and lock acquisitions drop by exactly the
+// coalesced inquiries.
+void bench_service(int service_us) {
+    auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(service_us);
+    while (std::chrono::steady_clock::now() < until) {
+    }
+}
+
+int bench_coalescing(int threads, int seconds, int service_us) {
+    cout << "--- Inquiry coalescing benchmark: " << threads << " threads, " << seconds << " s per run, "
+         << service_us << " us service ---\n";
+    cout << "hot\tcoalesce\tkreq/s\tinquiry p99 us\thit rate\tgate entries\ttrain locks\n";
+    engine_mode = ENGINE_MUTEX;
+    for (int hot_trains : {1, 10, 100}) {
+        if (hot_trains > num_trains) continue;
+        for (bool coalesce : {false, true}) {
+            for (int i = 0; i < num_trains; i++) {
+                train_state[i] = pack_state(CAPACITY / 2, 0);
+                held_seats[i] = 0;
+            }
+            recount_occupancy();
+            std::vector<std::vector<long long>> latencies(threads);
+            std::vector<long long> requests(threads, 0), inquiries(threads, 0), coalesced(threads, 0);
+            std::vector<long long> gate_entries(threads, 0), train_locks(threads, 0);
+            std::vector<std::thread> clients;
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+            for (int t = 0; t < threads; t++) {
+                clients.emplace_back([&, t] {
+                    std::mt19937 rng(t * 7919 + hot_trains);
+                    EngineStats stats;
+                    latencies[t].reserve(1 << 16);
+                    while (true) {
+                        auto start = std::chrono::steady_clock::now();
+                        if (start >= deadline) break;
+                        int train_num = static_cast<int>(rng() % hot_trains);
+                        int roll = static_cast<int>(rng() % 100);
+                        requests[t]++;
+                        if (roll >= 90) {
+                            int seats = BOOK_MIN + static_cast<int>(rng() % (BOOK_MAX - BOOK_MIN + 1));
+                            bench_admit(MAX_CONCURRENT_ACCESS);
+                            bench_service(service_us);
+                            if (roll < 95) engine_book(ENGINE_MUTEX, train_num, seats, stats);
+                            else engine_cancel(ENGINE_MUTEX, train_num, seats, stats);
+                            bench_leave(MAX_CONCURRENT_ACCESS);
+                            gate_entries[t]++;
+                            train_locks[t]++;
+                            continue;
+                        }
+                        inquiries[t]++;
+                        InquiryTicket inquiry;
+                        int seats;
+                        if (coalesce) inquiry = inquiry_flights.join(train_num);
+                        if (coalesce && !inquiry.leader) {
+                            seats = inquiry_flights.wait(inquiry);
+                            coalesced[t]++;
+                        } else {
+                            bench_admit(MAX_CONCURRENT_ACCESS);
+                            bench_service(service_us);
+                            {
+                                lock_guard<RobustMutex> train_lock(train_mutex_of(train_num));
+                                seats = read_for_inquiry(train_num, inquiry);
+                            }
+                            bench_leave(MAX_CONCURRENT_ACCESS);
+                            gate_entries[t]++;
+                            train_locks[t]++;
+                        }
+                        bench_sink.fetch_add(seats, std::memory_order_relaxed);
+                        latencies[t].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - start).count());
+                    }
+                });
+            }
+            for (std::thread& client : clients) client.join();
+
+            long long total = 0, asked = 0, shared = 0, gates = 0, locks = 0;
+            std::vector<long long> all;
+            for (int t = 0; t < threads; t++) {
+                total += requests[t];
+                asked += inquiries[t];
+                shared += coalesced[t];
+                gates += gate_entries[t];
+                locks += train_locks[t];
+                all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+            }
+            std::sort(all.begin(), all.end());
+            cout << hot_trains << "\t" << (coalesce ? "on " : "off") << "\t\t" << std::fixed << std::setprecision(1)
+                 << static_cast<double>(total) / seconds / 1000 << "\t" << latency_percentile(all, 0.99) / 1000.0
+                 << "\t\t" << (asked > 0 ? 100.0 * shared / asked : 0) << "%\t\t" << gates << "\t" << locks
+                 << std::defaultfloat << endl;
+        }
+    }
+    return 0;
+}
+
+// --bench-occupancy [threads] [seconds per run]: a dashboard polling system-wide occupancy as
+// fast as it can while `threads` clients book and cancel (OCC engine) on uniformly random trains.
+// The poller either sums the sharded aggregates or walks every train; afterwards, with the
+// clients gone, the aggregates must match a walk exactly.
+int bench_occupancy(int threads, int seconds) {
+    cout << "--- Occupancy aggregate benchmark: " << threads << " clients, " << seconds << " s per run ---\n";
+    cout << "trains\tpoller\t\tclient kreq/s\tpolls/s\t\tns/poll\n";
+    bool exact = true;
+    for (int trains : {1000, 1000000}) {
+        allocate_train_table(trains, 0);
+        for (int poller = 0; poller < 3; poller++) {
+            engine_mode = ENGINE_OCC;
+            for (int i = 0; i < num_trains; i++) train_state[i] = pack_state(CAPACITY / 2, 0);
+            recount_occupancy();
+            std::atomic<bool> running{true};
+            std::vector<long long> requests(threads, 0);
+            std::vector<std::thread> clients;
+            for (int t = 0; t < threads; t++) {
+                clients.emplace_back([&, t] {
+                    std::mt19937 rng(t * 7919 + trains);
+                    EngineStats stats;
+                    while (running.load(std::memory_order_relaxed)) {
+                        for (int batch = 0; batch < 64; batch++) {
+                            int train_num = static_cast<int>(rng() % num_trains);
+                            int seats = BOOK_MIN + static_cast<int>(rng() % (BOOK_MAX - BOOK_MIN + 1));
+                            if (rng() % 2 == 0) engine_book(ENGINE_OCC, train_num, seats, stats);
+                            else engine_cancel(ENGINE_OCC, train_num, seats, stats);
+                        }
+                        requests[t] += 64;
+                    }
+                });
+            }
+            long long polls = 0;
+            double load = 0;
+            auto start = std::chrono::steady_clock::now();
+            auto deadline = start + std::chrono::seconds(seconds);
+            if (poller == 0) {
+                std::this_thread::sleep_until(deadline);
+            } else {
+                while (std::chrono::steady_clock::now() < deadline) {
+                    load += (poller == 1 ? read_occupancy() : walk_occupancy()).load_factor;
+                    polls++;
+                }
+            }
+            double elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count() / 1e9;
+            running = false;
+            for (std::thread& client : clients) client.join();
+            bench_sink.fetch_add(static_cast<long long>(load), std::memory_order_relaxed);
+
+            long long total = 0;
+            for (long long count : requests) total += count;
+            OccupancySummary aggregated = read_occupancy(), walked = walk_occupancy();
+            bool same = aggregated.available == walked.available && aggregated.held == walked.held &&
+                        aggregated.sold_out == walked.sold_out;
+            exact &= same;
+            const char* names[] = {"none       ", "aggregates ", "walk       "};
+            cout << trains << "\t" << names[poller] << "\t" << std::fixed << std::setprecision(1)
+                 << total / elapsed / 1000 << "\t\t";
+            if (poller == 0) cout << "-\t\t-";
+            else cout << polls / elapsed << "\t" << (polls > 0 ? elapsed * 1e9 / polls : 0);
+            cout << std::defaultfloat << (same ? "" : "  MISMATCH") << endl;
+        }
+    }
+    allocate_train_table(DEFAULT_TRAINS, 0);
+    recount_occupancy();
+    return exact ? 0 : 1;
+}
+
+// --bench-availability-tree [threads] [seconds per run]: the max tree's queries against full
+// scans, then what keeping it current costs the booking path. The query tables are mostly
+// nearly sold out, with one train in 20000 empty, so a scan for space has to skip far.
+int bench_availability_tree(int threads, int seconds) {
+    typedef std::chrono::steady_clock clock;
+    auto us_since = [](clock::time_point start, int operations) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count() / 1e3 / operations;
+    };
+    cout << "--- Availability tree benchmark: " << threads << " threads, " << seconds << " s per run ---\n";
+    cout << "trains\ttree KiB\tnext-with-space us (scan)\ttop-10 us (scan)\n";
+    std::mt19937 rng(42);
+    bool agree = true;
+    for (int trains : {1000, 100000, 1000000}) {
+        allocate_train_table(trains, 0);
+        for (int i = 0; i < trains; i++) {
+            int seats = rng() % 20000 == 0 ? CAPACITY : static_cast<int>(rng() % 50);
+            train_state[i] = pack_state(seats, 0);
+        }
+        availability_tree.build(train_state, num_trains);
+        const int queries = 2000;
+        std::vector<std::size_t> starts(queries);
+        for (std::size_t& from : starts) from = rng() % trains;
+        const int wanted = CAPACITY / 5;
+
+        long found = 0;
+        clock::time_point start = clock::now();
+        for (std::size_t from : starts) found += availability_tree.next_with_space(from, wanted);
+        double tree_next_us = us_since(start, queries);
+        long scanned = 0;
+        start = clock::now();
+        for (std::size_t from : starts) {
+            long hit = -1;
+            for (int i = static_cast<int>(from); i < trains && hit < 0; i++) {
+                if (seats_available(i) >= wanted) hit = i;
+            }
+            scanned += hit;
+        }
+        double scan_next_us = us_since(start, queries);
+
+        const int top_queries = 200;
+        std::vector<std::pair<int, std::uint32_t>> top;
+        start = clock::now();
+        for (int q = 0; q < top_queries; q++) availability_tree.top_k(10, top);
+        double tree_top_us = us_since(start, top_queries);
+        std::vector<int> seats(trains);
+        start = clock::now();
+        for (int q = 0; q < top_queries; q++) {
+            for (int i = 0; i < trains; i++) seats[i] = seats_available(i);
+            std::partial_sort(seats.begin(), seats.begin() + std::min(10, trains), seats.end(), std::greater<int>());
+        }
+        double scan_top_us = us_since(start, top_queries);
+        bool same_top = top.size() == static_cast<std::size_t>(std::min(10, trains));
+        for (std::size_t i = 0; same_top && i < top.size(); i++) same_top = top[i].first == seats[i];
+        agree &= found == scanned && same_top;
+
+        cout << trains << "\t" << availability_tree.bytes() / 1024 << "\t\t" << std::fixed << std::setprecision(2)
+             << tree_next_us << " (" << scan_next_us << ")\t\t" << tree_top_us << " (" << scan_top_us << ")"
+             << std::defaultfloat << (found == scanned && same_top ? "" : "  MISMATCH") << endl;
+    }
+
+    cout << "\nBooking path, inquiry/book/cancel mix without admission gate (kreq/s, p99 us)\n";
+    cout << "trains\tengine\twithout tree\t\twith tree\n";
+    for (int trains : {1000, 1000000}) {
+        allocate_train_table(trains, 0);
+        for (EngineMode mode : {ENGINE_MUTEX, ENGINE_ATOMIC, ENGINE_OCC}) {
+            availability_tree_enabled = false;
+            ScalingResult plain = run_scaling({"trains", mode, threads, 0, trains, 0}, seconds);
+            availability_tree_enabled = true;
+            ScalingResult tree = run_scaling({"trains", mode, threads, 0, trains, 0}, seconds);
+            availability_tree_enabled = false;
+            cout << trains << "\t" << engine_name(mode) << "\t" << std::fixed << std::setprecision(1)
+                 << plain.throughput / 1000 << " (" << plain.p99_ns / 1000.0 << ")\t\t" << tree.throughput / 1000
+                 << " (" << tree.p99_ns / 1000.0 << ")" << std::defaultfloat << endl;
+        }
+    }
+    allocate_train_table(DEFAULT_TRAINS, 0);
+    return agree ? 0 : 1;
+}
+
+// --bench-inventory [trains] [days]: footprint and scan throughput of trains x days x
+// INVENTORY_CLASSES seat slots in three layouts holding the same availability:
+//   int, train-major   one 32-bit counter per slot, each train's days and classes together
+//   state words        train_state's 64-bit seats+version word per slot, one row per (day,
+//                      class) like the seat store's day-major slots
+//   packed uint16_t    PackedInventory: 16-bit rows plus bit-packed class/quota metadata
+// A pass answers "how many trains have n seats" for every (day, class) row, so it reads the
+// whole table once; passes repeat for about a second per layout.
+int bench_inventory(std::size_t trains, int days) {
+    typedef std::chrono::steady_clock clock;
+    const int classes = INVENTORY_CLASSES;
+    const std::size_t slots = trains * days * classes;
+    cout << "--- Inventory layout benchmark: " << trains << " trains x " << days << " days x " << classes
+         << " classes (" << slots / 1000000.0 << " M slots) ---\n";
+
+    PackedInventory packed;
+    if (!packed.allocate(trains, days, classes, CAPACITY)) {
+        cerr << "Cannot allocate the packed inventory" << endl;
+        return 1;
+    }
+    std::vector<int> wide(slots);
+    std::vector<std::uint64_t> words(slots);
+    std::mt19937 rng(42);
+    for (std::size_t train = 0; train < trains; train++) {
+        // Every 8th train has no first class and a few seats held for a quota
+        if (train % 8 == 0) {
+            packed.set_classes(train, (1u << classes) - 2);
+            packed.set_quota(train, 20);
+        }
+        for (int day = 0; day < days; day++) {
+            for (int cls = 0; cls < classes; cls++) {
+                int seats = packed.runs_class(train, cls) ? static_cast<int>(rng() % (CAPACITY + 1)) : 0;
+                packed.book(train, day, cls, packed.available(train, day, cls) - seats, true);
+                wide[(train * days + day) * classes + cls] = seats;
+                words[(static_cast<std::size_t>(day) * classes + cls) * trains + train] = pack_state(seats, 0);
+            }
+        }
+    }
+
+    std::vector<int> wanted(days * classes);
+    for (int& seats : wanted) seats = BOOK_MIN + static_cast<int>(rng() % (CAPACITY - BOOK_MIN));
+    auto run = [&](const char* name, std::size_t bytes, const std::function<std::size_t(int, int, int)>& count) {
+        std::size_t expected = 0;
+        for (int row = 0; row < days * classes; row++) expected += packed.count_at_least(row / classes, row % classes, wanted[row]);
+        long long passes = 0;
+        std::size_t found = 0;
+        bool mismatch = false;
+        auto start = clock::now();
+        auto deadline = start + std::chrono::seconds(1);
+        do {
+            std::size_t pass_found = 0;
+            for (int row = 0; row < days * classes; row++) pass_found += count(row / classes, row % classes, wanted[row]);
+            mismatch |= pass_found != expected;
+            found += pass_found;
+            passes++;
+        } while (clock::now() < deadline);
+        double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count() / 1e9;
+        bench_sink.fetch_add(static_cast<long long>(found), std::memory_order_relaxed);
+        cout << std::left << std::setw(18) << name << std::right << std::fixed << std::setprecision(1) << std::setw(9)
+             << bytes / (1024.0 * 1024.0) << " MiB" << std::setw(8) << static_cast<double>(bytes) / slots
+             << " B/slot" << std::setw(10) << seconds * 1000 / passes << " ms/pass" << std::setw(9)
+             << passes * slots / seconds / 1e9 << " G slots/s" << std::setw(8)
+             << passes * static_cast<double>(bytes) / seconds / 1e9 << " GB/s" << std::defaultfloat
+             << (mismatch ? "  MISMATCH" : "") << endl;
+        return !mismatch;
+    };
+
+    bool ok = run("int, train-major", wide.size() * sizeof(int), [&](int day, int cls, int seats) {
+        std::size_t count = 0;
+        for (std::size_t train = 0; train < trains; train++) count += wide[(train * days + day) * classes + cls] >= seats;
+        return count;
+    });
+    ok &= run("state words", words.size() * sizeof(std::uint64_t), [&](int day, int cls, int seats) {
+        const std::uint64_t* row = words.data() + (static_cast<std::size_t>(day) * classes + cls) * trains;
+        std::size_t count = 0;
+        for (std::size_t train = 0; train < trains; train++) count += state_seats(row[train]) >= seats;
+        return count;
+    });
+    ok &= run("packed uint16_t", packed.bytes(), [&](int day, int cls, int seats) {
+        return packed.count_at_least(day, cls, seats);
+    });
+    return ok ? 0 : 1;
+}
+
+// --bench-search [max entries]: the seat search kernels. Every implementation the CPU supports
+// is first cross-checked against the scalar loop on random sizes, offsets and thresholds, then
+// timed on arrays of up to `max entries` 16-bit counters and 64-bit state words at two
+// selectivities. The last table searches consistent reads of train_state (--trains=N).
+int bench_search(std::size_t max_entries) {
+    typedef std::chrono::steady_clock clock;
+    std::mt19937 rng(42);
+    std::vector<std::uint16_t> counters(max_entries + 64);
+    std::vector<std::uint64_t> words(max_entries + 64);
+    for (std::size_t i = 0; i < counters.size(); i++) {
+        counters[i] = static_cast<std::uint16_t>(rng() % (CAPACITY + 1));
+        words[i] = pack_state(static_cast<int>(rng() % (CAPACITY + 1)) - (i % 97 == 0 ? CAPACITY : 0), rng());
+    }
+    std::vector<std::uint32_t> expected(counters.size());
+    std::vector<std::uint32_t> got(counters.size());
+
+    SeatSearchImplementation best = seat_search_best_implementation();
+    cout << "--- Seat search benchmark (best: " << seat_search_implementation_name(best) << ") ---\n";
+    for (int impl = SEAT_SEARCH_AVX2; impl <= best; impl++) {
+        SeatSearchImplementation implementation = static_cast<SeatSearchImplementation>(impl);
+        for (int i = 0; i < 5000; i++) {
+            std::size_t offset = rng() % 64;
+            std::size_t count = rng() % std::min<std::size_t>(max_entries, i < 4900 ? 1000 : max_entries);
+            int min_seats = static_cast<int>(rng() % (CAPACITY + 2)) - 1;
+            bool wide = i % 2 == 1;
+            std::size_t want = wide ? seat_search_words_with(SEAT_SEARCH_SCALAR, &words[offset], count, min_seats, expected.data())
+                                    : seat_search_u16_with(SEAT_SEARCH_SCALAR, &counters[offset], count, min_seats, expected.data());
+            std::size_t have = wide ? seat_search_words_with(implementation, &words[offset], count, min_seats, got.data())
+                                    : seat_search_u16_with(implementation, &counters[offset], count, min_seats, got.data());
+            if (have != want || !std::equal(got.begin(), got.begin() + have, expected.begin())) {
+                cerr << seat_search_implementation_name(implementation) << " disagrees with the scalar loop on "
+                     << (wide ? "words" : "counters") << " at offset " << offset << ", count " << count
+                     << ", min_seats " << min_seats << endl;
+                return 1;
+            }
+        }
+    }
+
+    // Entries searched per second; each timed run repeats the search over ~256 MiB of input
+    auto time_search = [&](SeatSearchImplementation implementation, bool wide, std::size_t count, int min_seats) {
+        std::size_t entry_bytes = wide ? sizeof(std::uint64_t) : sizeof(std::uint16_t);
+        long long rounds = std::max<long long>(1, (std::size_t(256) << 20) / (count * entry_bytes));
+        std::size_t found = 0;
+        clock::time_point start = clock::now();
+        for (long long r = 0; r < rounds; r++) {
+            found += wide ? seat_search_words_with(implementation, words.data(), count, min_seats, got.data())
+                          : seat_search_u16_with(implementation, counters.data(), count, min_seats, got.data());
+        }
+        double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count() / 1e9;
+        bench_sink.fetch_add(static_cast<long long>(found), std::memory_order_relaxed);
+        return rounds * count / seconds;
+    };
+    for (int wide = 0; wide <= 1; wide++) {
+        cout << (wide ? "64-bit state words" : "16-bit counters") << " (G entries/s; GB/s = x"
+             << (wide ? 8 : 2) << ")\n";
+        cout << "Entries     Matching ";
+        for (int impl = SEAT_SEARCH_SCALAR; impl <= best; impl++) {
+            cout << std::setw(10) << seat_search_implementation_name(static_cast<SeatSearchImplementation>(impl));
+        }
+        cout << endl;
+        for (std::size_t count : {std::size_t(1000), std::size_t(65536), std::size_t(1) << 20, max_entries}) {
+            if (count > max_entries) continue;
+            // Thresholds near the top of the range match ~1%, the middle ~50%
+            for (int min_seats : {CAPACITY * 99 / 100, CAPACITY / 2}) {
+                cout << std::left << std::setw(12) << count << std::setw(9)
+                     << (min_seats > CAPACITY / 2 ? "~1%" : "~50%") << std::right << std::fixed << std::setprecision(2);
+                for (int impl = SEAT_SEARCH_SCALAR; impl <= best; impl++) {
+                    cout << std::setw(10)
+                         << time_search(static_cast<SeatSearchImplementation>(impl), wide, count, min_seats) / 1e9;
+                }
+                cout << std::defaultfloat << endl;
+            }
+        }
+    }
+
+    // The search API on the live table: consistent read of train_state, then search
+    for (int i = 0; i < num_trains; i++) train_state[i] = pack_state(static_cast<int>(rng() % (CAPACITY + 1)), 0);
+    std::vector<std::uint64_t> states;
+    std::vector<std::uint32_t> trains;
+    ConsistentReadStats stats;
+    const int searches = std::max(1, 20000000 / num_trains);
+    std::size_t matched = 0;
+    clock::time_point start = clock::now();
+    for (int s = 0; s < searches; s++) {
+        find_trains_with_seats(CAPACITY * 99 / 100, states, trains, stats);
+        matched += trains.size();
+    }
+    double us = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count() / 1e3 / searches;
+    cout << "find_trains_with_seats on " << num_trains << " trains: " << std::fixed << std::setprecision(1) << us
+         << " us per search (consistent read + search), " << matched / searches << " trains found" << std::defaultfloat
+         << endl;
+    return 0;
+}
+
+// --decode-events PATH: renders a binary event log as the lines the simulation would have
+// printed. The summary goes to stderr so stdout stays a clean transcript.
+int decode_events(const char* path) {
+    EventLogReader reader;
+    if (!reader.open(path)) {
+        cerr << "Cannot open event log " << path << ": " << std::strerror(errno) << endl;
+        return 1;
+    }
+    std::ios::sync_with_stdio(false);
+    auto start = std::chrono::steady_clock::now();
+    Event event;
+    while (reader.next(event)) {
+        render_event(cout, event);
+        cout << '\n';
+    }
+    cout.flush();
+    double seconds = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count() / 1e6;
+    cerr << "Decoded " << reader.events() << " events from " << reader.blocks() << " blocks ("
+         << reader.corrupt_blocks() << " corrupt) in " << seconds << " s" << endl;
+    return reader.corrupt_blocks() == 0 ? 0 : 1;
+}
+
+// Event log benchmark: encodes `count` synthetic events with the simulation's mix of kinds,
+// then decodes them with and without rendering, and compares the size with the text lines.
+int bench_event_log(const char* path, long long count) {
+    typedef std::chrono::steady_clock clock;
+    auto seconds_since = [](clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count() / 1e6;
+    };
+    std::mt19937 rng(42);
+    std::vector<Event> samples(4096);
+    for (Event& event : samples) {
+        event.kind = static_cast<std::uint8_t>(rng() % EVENT_NUM_KINDS);
+        event.actor = static_cast<int>(rng() % MAX_THREADS);
+        event.train_num = static_cast<int>(rng() % num_trains);
+        event.count = BOOK_MIN + static_cast<int>(rng() % (BOOK_MAX - BOOK_MIN + 1));
+        event.remaining = static_cast<int>(rng() % (CAPACITY + 1));
+        event.other = static_cast<int>(rng() % MAX_THREADS);
+        if (event.kind == EVENT_WAITING || event.kind == EVENT_GAINED) {
+            event.aux = static_cast<std::uint8_t>(1 + rng() % NUM_QUERY_TYPES);
+        } else if (event.kind == EVENT_ITINERARY_BOOKED) {
+            event.aux = static_cast<std::uint8_t>(2 + rng() % (ITINERARY_MAX_LEGS - 1));
+            for (int i = 0; i < event.aux; i++) {
+                event.legs[i][0] = static_cast<int>(rng() % num_trains);
+                event.legs[i][1] = static_cast<int>(rng() % (CAPACITY + 1));
+            }
+        }
+    }
+    long long text_bytes = 0;
+    for (const Event& event : samples) {
+        std::ostringstream line;
+        render_event(line, event);
+        text_bytes += static_cast<long long>(line.str().size()) + 1;
+    }
+
+    cout << "--- Event log benchmark: " << count << " events ---\n";
+    clock::time_point start = clock::now();
+    EventLogWriter writer;
+    if (!writer.open(path)) {
+        cerr << "Cannot create " << path << ": " << std::strerror(errno) << endl;
+        return 1;
+    }
+    std::uint64_t now_us = 0;
+    for (long long i = 0; i < count; i++) {
+        Event event = samples[static_cast<std::size_t>(i) & 4095];
+        now_us += rng() % 200;
+        event.time_us = now_us;
+        writer.append(event);
+    }
+    writer.close();
+    double encode_s = seconds_since(start);
+    double binary_per_event = static_cast<double>(writer.bytes()) / count;
+    cout << "Size:                  " << binary_per_event << " bytes/event binary vs "
+         << static_cast<double>(text_bytes) / samples.size() << " bytes/event as text ("
+         << writer.blocks() << " blocks)" << endl;
+    cout << "Encode:                " << count / encode_s / 1e6 << " M events/s" << endl;
+
+    start = clock::now();
+    EventLogReader reader;
+    reader.open(path);
+    Event event;
+    long long checksum = 0;
+    while (reader.next(event)) checksum += event.train_num;
+    double decode_s = seconds_since(start);
+    bool complete = reader.events() == count && reader.corrupt_blocks() == 0;
+    cout << "Decode:                " << count / decode_s / 1e6 << " M events/s"
+         << (complete ? "" : " (INCOMPLETE)") << endl;
+
+    start = clock::now();
+    EventLogReader render_reader;
+    render_reader.open(path);
+    std::ostringstream text;
+    long long rendered = 0;
+    while (render_reader.next(event)) {
+        render_event(text, event);
+        text << '\n';
+        if ((++rendered & 4095) == 0) text.str(string());
+    }
+    cout << "Decode + render:       " << count / seconds_since(start) / 1e6 << " M events/s" << endl;
+    bench_sink.fetch_add(checksum, std::memory_order_relaxed);
+    ::unlink(path);
+    return complete ? 0 : 1;
+}
+
+// --bench-shm [max processes] [seconds]: booking throughput against one shared-memory table from
+// 1, 2, 4 ... max single-threaded processes, each booking and cancelling through the mutex engine
+// inside a shared admission slot. A last run makes every other process die by SIGKILL while it
+// holds a train lock and an admission slot; the survivors have to take both over and finish.
+int bench_shm(int max_processes, int seconds) {
+    string name = "/rsv_bench_" + std::to_string(::getpid());
+    if (shared_table.open(name, num_trains, lock_stripes, MAX_CONCURRENT_ACCESS, pack_state(CAPACITY, 0)) !=
+        SharedTrainTable::SHM_CREATED) {
+        cerr << "Cannot create shared train table " << name << ": " << shared_table.last_error() << endl;
+        return 1;
+    }
+    train_state = shared_table.states();
+    held_seats = shared_table.held();
+    booking_seats = shared_table.booking();
+    train_mutex = shared_table.train_locks();
+    shared_enabled = true;
+
+    // Per child: operations and lock conflicts, written just before it exits
+    struct ChildResult {
+        long long operations;
+        long long conflicts;
+    };
+    void* shared = ::mmap(nullptr, max_processes * sizeof(ChildResult), PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) return 1;
+    ChildResult* results = static_cast<ChildResult*>(shared);
+
+    // Runs `processes` children; with `crash`, odd-numbered ones die holding locks mid-run.
+    // Returns false if a survivor did not finish within a grace period after the deadline.
+    auto run = [&](int processes, bool crash, long long& operations, long long& conflicts, int& killed) {
+        std::vector<pid_t> children;
+        for (int p = 0; p < processes; p++) {
+            results[p] = ChildResult{0, 0};
+            pid_t pid = ::fork();
+            if (pid == 0) {
+                std::mt19937 rng(static_cast<unsigned>(p * 7919 + processes));
+                EngineStats stats;
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+                auto crash_at = std::chrono::steady_clock::now() + std::chrono::milliseconds(seconds * 1000 / 4);
+                while (std::chrono::steady_clock::now() < deadline) {
+                    for (int k = 0; k < 64; k++) {
+                        int slot = shared_table.admit();
+                        int train_num = static_cast<int>(rng() % num_trains);
+                        int seats = BOOK_MIN + static_cast<int>(rng() % (BOOK_MAX - BOOK_MIN + 1));
+                        if (rng() % 2 == 0) engine_book(ENGINE_MUTEX, train_num, seats, stats);
+                        else engine_cancel(ENGINE_MUTEX, train_num, seats, stats);
+                        shared_table.leave(slot);
+                    }
+                    if (crash && p % 2 == 1 && std::chrono::steady_clock::now() >= crash_at) {
+                        shared_table.admit();
+                        train_mutex_of(static_cast<int>(rng() % num_trains)).lock();
+                        ::kill(::getpid(), SIGKILL);
+                    }
+                }
+                results[p] = ChildResult{stats.operations, stats.conflicts};
+                ::_exit(0);
+            }
+            if (pid < 0) break;
+            children.push_back(pid);
+        }
+
+        bool finished = true;
+        auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(seconds + 5);
+        operations = conflicts = 0;
+        killed = 0;
+        for (std::size_t p = 0; p < children.size(); p++) {
+            int status = 0;
+            while (true) {
+                pid_t done = ::waitpid(children[p], &status, WNOHANG);
+                if (done == children[p]) break;
+                if (std::chrono::steady_clock::now() > give_up) { // Wedged on a lock nobody will free
+                    ::kill(children[p], SIGKILL);
+                    ::waitpid(children[p], &status, 0);
+                    finished = false;
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            if (WIFSIGNALED(status)) killed++;
+            operations += results[p].operations;
+            conflicts += results[p].conflicts;
+        }
+        return finished;
+    };
+
+    cout << "--- Shared-memory engine: 1 to " << max_processes << " processes, " << seconds
+         << " s per run (" << shared_table.bytes() << " byte table " << name << ") ---\n";
+    cout << "processes\tops/s\t\tper process\tconflicts\n";
+    std::vector<int> process_counts;
+    for (int processes = 1; processes < max_processes; processes *= 2) process_counts.push_back(processes);
+    process_counts.push_back(max_processes);
+    for (int processes : process_counts) {
+        long long operations = 0, conflicts = 0;
+        int killed = 0;
+        run(processes, false, operations, conflicts, killed);
+        cout << processes << "\t\t" << operations / seconds << "\t\t" << operations / seconds / processes << "\t\t"
+             << 100.0 * conflicts / std::max(1LL, operations) << "%" << endl;
+    }
+
+    int processes = std::max(2, max_processes);
+    long long deaths_before = shared_table.owner_deaths();
+    long long operations = 0, conflicts = 0;
+    int killed = 0;
+    bool finished = run(processes, true, operations, conflicts, killed);
+    long long recovered = shared_table.owner_deaths() - deaths_before;
+    bool in_range = true;
+    for (int i = 0; i < num_trains; i++) {
+        int seats = seats_available(i);
+        if (seats < 0 || seats > CAPACITY) in_range = false;
+    }
+    cout << "crash run: " << processes << " processes, " << killed << " killed holding a train lock and a slot; "
+         << "survivors " << operations / seconds << " ops/s, " << recovered << " locks recovered, "
+         << (finished ? "none wedged" : "WEDGED") << ", seats " << (in_range ? "in range" : "OUT OF RANGE") << endl;
+
+    ::munmap(shared, max_processes * sizeof(ChildResult));
+    shared_table.close();
+    return finished && in_range ? 0 : 1;
+}
+
+// --bench-crc32c: checksum throughput of each CRC32C implementation the CPU supports, at the
+// sizes this project checksums (journal records up to store pages and snapshot images). Every
+// implementation is first cross-checked against the table at odd lengths and alignments.
+int bench_crc32c() {
+    typedef std::chrono::steady_clock clock;
+    const std::size_t max_size = std::size_t(1) << 20;
+    std::vector<unsigned char> buffer(max_size + 64);
+    std::mt19937 rng(42);
+    for (unsigned char& byte : buffer) byte = static_cast<unsigned char>(rng());
+
+    Crc32cImplementation best = crc32c_best_implementation();
+    cout << "--- CRC32C benchmark (best: " << crc32c_implementation_name(best) << ") ---\n";
+    for (int impl = CRC32C_SSE42; impl <= best; impl++) {
+        for (int i = 0; i < 20000; i++) {
+            std::size_t offset = rng() % 64;
+            std::size_t size = rng() % (i < 19000 ? 16384 : max_size);
+            std::uint32_t seed = rng();
+            std::uint32_t expected = crc32c_extend_with(CRC32C_TABLE, seed, &buffer[offset], size);
+            std::uint32_t got = crc32c_extend_with(static_cast<Crc32cImplementation>(impl), seed,
+                                                   &buffer[offset], size);
+            if (got != expected) {
+                cerr << crc32c_implementation_name(static_cast<Crc32cImplementation>(impl))
+                     << " disagrees with the table at offset " << offset << ", size " << size << endl;
+                return 1;
+            }
+        }
+    }
+
+    const std::size_t sizes[] = {32, 64, 1024, 4096, 65536, max_size};
+    cout << "Size        ";
+    for (int impl = CRC32C_TABLE; impl <= best; impl++) {
+        cout << std::setw(16) << crc32c_implementation_name(static_cast<Crc32cImplementation>(impl));
+    }
+    cout << "  (GB/s)" << endl;
+    for (std::size_t size : sizes) {
+        cout << std::left << std::setw(12) << size << std::right;
+        long long rounds = std::max<long long>(1, (std::size_t(256) << 20) / size);
+        for (int impl = CRC32C_TABLE; impl <= best; impl++) {
+            Crc32cImplementation implementation = static_cast<Crc32cImplementation>(impl);
+            std::uint32_t crc = 0;
+            clock::time_point start = clock::now();
+            for (long long r = 0; r < rounds; r++) {
+                // Chain the results so the calls cannot be overlapped or hoisted
+                crc = crc32c_extend_with(implementation, crc, buffer.data(), size);
+            }
+            double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                clock::now() - start).count() / 1e9;
+            bench_sink.fetch_add(crc, std::memory_order_relaxed);
+            cout << std::setw(16) << std::fixed << std::setprecision(2)
+                 << static_cast<double>(size) * rounds / seconds / 1e9;
+        }
+        cout << std::defaultfloat << endl;
+    }
+    return 0;
+}
+
+// --bench-primitives [contending threads]: what each building block of a request costs on its
+// own, so a regression in one shows up without the noise of the full simulation. Every
+// primitive runs in a tight loop on one train, first from a single thread and then from
+// `threads` threads at once, in batches timed with the cycle counter (cycle_timer.h). Reported
+// are reference cycles per operation: the median and 99th percentile over all batches of all
+// threads. print_query is timed with its output thrown away (text) or written to /dev/null
+// (binary event log), so only rendering / encoding and print_mutex are measured.
+struct PrimitiveTiming {
+    double median = 0; // Cycles per operation
+    double p99 = 0;
+};
+
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+template <typename Op>
+PrimitiveTiming time_primitive(int threads, Op op) {
+    const int warmup_batches = 10;
+    const int batches = 200;
+    const int batch_ops = 1000;
+    std::vector<double> samples(static_cast<std::size_t>(threads) * batches);
+    std::atomic<int> ready{0};
+    std::vector<std::thread> runners;
+    for (int t = 0; t < threads; t++) {
+        runners.emplace_back([&, t] {
+            ready.fetch_add(1);
+            while (ready.load() < threads) std::this_thread::yield(); // Start together
+            for (int b = -warmup_batches; b < batches; b++) {
+                std::uint64_t start = cycle_now();
+                for (int i = 0; i < batch_ops; i++) op(t);
+                std::uint64_t cycles = cycle_now() - start;
+                if (b >= 0) samples[static_cast<std::size_t>(t) * batches + b] = static_cast<double>(cycles) / batch_ops;
+            }
+        });
+    }
+    for (std::thread& runner : runners) runner.join();
+    std::sort(samples.begin(), samples.end());
+    PrimitiveTiming timing;
+    timing.median = samples[samples.size() / 2];
+    timing.p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    return timing;
+}
+
+int bench_primitives(int threads) {
+    for (int i = 0; i < num_trains; i++) {
+        train_state[i] = pack_state(CAPACITY / 2, 0);
+        held_seats[i] = 0;
+    }
+    static std::mutex plain_mutex;
+
+    cout << "--- Primitive microbenchmarks: reference cycles per operation (" << std::fixed << std::setprecision(2)
+         << cycles_per_ns() << " cycles/ns), single thread vs " << threads << " threads on one train ---\n";
+    string suffix = " x" + std::to_string(threads);
+    cout << std::left << std::setw(40) << "Primitive" << std::right << std::setw(10) << "median" << std::setw(10)
+         << "p99" << std::setw(10) << "ns" << std::setw(13) << "median" + suffix << std::setw(10) << "p99" + suffix
+         << endl;
+    cout << std::setprecision(1);
+    auto print_row = [&](const char* name, const PrimitiveTiming& single, const PrimitiveTiming& contended) {
+        cout << std::left << std::setw(40) << name << std::right << std::setw(10) << single.median << std::setw(10)
+             << single.p99 << std::setw(10) << single.median / cycles_per_ns() << std::setw(13) << contended.median
+             << std::setw(10) << contended.p99 << endl;
+    };
+    auto report = [&](const char* name, auto op) {
+        PrimitiveTiming single = time_primitive(1, op);
+        print_row(name, single, time_primitive(threads, op));
+    };
+
+    report("std::mutex lock/unlock", [](int) {
+        plain_mutex.lock();
+        plain_mutex.unlock();
+    });
+    report("train_mutex (RobustMutex) lock/unlock", [](int) {
+        train_mutex[0].lock();
+        train_mutex[0].unlock();
+    });
+    report("admission gate (limit 5) admit/leave", [](int) {
+        bench_admit(MAX_CONCURRENT_ACCESS);
+        bench_leave(MAX_CONCURRENT_ACCESS);
+    });
+    {
+        NullBuffer null_buffer;
+        std::streambuf* saved = cout.rdbuf(&null_buffer);
+        PrimitiveTiming single = time_primitive(1, [](int t) { print_query(t, 2, 0, EVENT_WAITING); });
+        PrimitiveTiming contended = time_primitive(threads, [](int t) { print_query(t, 2, 0, EVENT_WAITING); });
+        cout.rdbuf(saved);
+        print_row("print_query (text, discarded)", single, contended);
+    }
+    if (event_log.open("/dev/null")) {
+        report("print_query (binary event log)", [](int t) { print_query(t, 2, 0, EVENT_WAITING); });
+        event_log.close();
+    }
+    report("inquiry (seats_available)", [](int) {
+        bench_sink.fetch_add(seats_available(0), std::memory_order_relaxed);
+    });
+    const EngineMode modes[] = {ENGINE_MUTEX, ENGINE_ATOMIC, ENGINE_OCC};
+    const char* names[] = {"mutex engine book + cancel", "atomic engine book + cancel", "occ engine book + cancel"};
+    for (int m = 0; m < 3; m++) {
+        EngineMode mode = modes[m];
+        report(names[m], [mode](int) {
+            EngineStats stats;
+            engine_book(mode, 0, BOOK_MIN, stats);
+            engine_cancel(mode, 0, BOOK_MIN, stats);
+        });
+    }
+    report("consistent read of all trains", [](int) {
+        thread_local std::vector<std::uint64_t> local;
+        local.resize(num_trains);
+        ConsistentReadStats stats;
+        read_consistent_states(local.data(), num_trains, stats);
+        bench_sink.fetch_add(static_cast<long long>(local[0]), std::memory_order_relaxed);
+    });
+    cout << std::defaultfloat;
+    return 0;
+}
+
+// --- MAIN FUNCTION ---
+int main(int argc, char* argv[]) {
+    // --engine=mutex|atomic|occ selects how Inquiry, Booking and Cancellation are served
+    // --wal=PATH appends every state change to a durable journal at PATH
+    // --wal-io=write|pwritev|uring selects how the journal writer reaches the disk
+    // --store=PATH keeps train_state in a memory-mapped, checkpointed file at PATH
+    // --snapshot=PATH periodically writes a fork()ed point-in-time copy of train_state to PATH
+    // --live-report prints lock-free consistent availability totals while the simulation runs
+    // --event-log=PATH writes events in compact binary form to PATH instead of printing them
+    // --shm=NAME books against a train table in shared memory that other processes can join
+    // --serve=PORT answers binary-protocol requests on 127.0.0.1:PORT instead of simulating
+    // --reactors=N sets the server's reactor threads (default: one per core)
+    // --trains=N sizes the train table (default DEFAULT_TRAINS, at most MAX_TRAINS)
+    // --lock-stripes=N guards the trains with N locks instead of one per train
+    // --availability-tree maintains a max tree over the trains' seats for the live report
+    // --coalesce-inquiries lets concurrent inquiries on one train share a single read
+    const char* wal_path = nullptr;
+    int trains = DEFAULT_TRAINS;
+    int stripes = 0;
+    int serve_port = 0;
+    const char* shm_name = nullptr;
+    const char* store_path = nullptr;
+    const char* event_log_path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "--engine=", 9) == 0 && !parse_engine(argv[i] + 9, engine_mode)) {
+            cerr << "Unknown engine '" << argv[i] + 9 << "' (expected mutex, atomic or occ)" << endl;
+            return 1;
+        }
+        if (std::strncmp(argv[i], "--wal-io=", 9) == 0 && !parse_wal_io(argv[i] + 9, journal_io_mode)) {
+            cerr << "Unknown journal I/O '" << argv[i] + 9 << "' (expected write, pwritev or uring)" << endl;
+            return 1;
+        }
+        if (std::strncmp(argv[i], "--wal=", 6) == 0) wal_path = argv[i] + 6;
+        if (std::strncmp(argv[i], "--store=", 8) == 0) store_path = argv[i] + 8;
+        if (std::strncmp(argv[i], "--snapshot=", 11) == 0) snapshot_path = argv[i] + 11;
+        if (std::strcmp(argv[i], "--live-report") == 0) live_report_enabled = true;
+        if (std::strcmp(argv[i], "--availability-tree") == 0) availability_tree_enabled = true;
+        if (std::strcmp(argv[i], "--coalesce-inquiries") == 0) coalesce_inquiries = true;
+        if (std::strncmp(argv[i], "--event-log=", 12) == 0) event_log_path = argv[i] + 12;
+        if (std::strncmp(argv[i], "--shm=", 6) == 0) shm_name = argv[i] + 6;
+        if (std::strncmp(argv[i], "--serve=", 8) == 0) serve_port = std::atoi(argv[i] + 8);
+        if (std::strncmp(argv[i], "--reactors=", 11) == 0) server_reactors = std::atoi(argv[i] + 11);
+        if (std::strncmp(argv[i], "--trains=", 9) == 0) trains = std::atoi(argv[i] + 9);
+        if (std::strncmp(argv[i], "--lock-stripes=", 15) == 0) stripes = std::atoi(argv[i] + 15);
+    }
+    if (trains < 1 || trains > MAX_TRAINS || stripes < 0 || stripes > MAX_TRAINS) {
+        cerr << "--trains and --lock-stripes must be between 1 and " << MAX_TRAINS << endl;
+        return 1;
+    }
+    allocate_train_table(trains, stripes);
+
+    if (argc > 2 && std::strcmp(argv[1], "--show-snapshot") == 0) {
+        return show_snapshot(argv[2]);
+    }
+    if (argc > 2 && std::strcmp(argv[1], "--decode-events") == 0) {
+        return decode_events(argv[2]);
+    }
+    if (argc > 2 && std::strcmp(argv[1], "--shm-remove") == 0) {
+        // Usage: --shm-remove NAME, for a table a crashed process left behind
+        if (SharedTrainTable::remove(argv[2])) return 0;
+        cerr << "Cannot remove shared train table " << argv[2] << ": " << std::strerror(errno) << endl;
+        return 1;
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--bench-shm") == 0) {
+        // Usage: --bench-shm [max processes] [seconds per run]
+        int processes = argc > 2 ? std::atoi(argv[2]) : 8;
+        return bench_shm(std::max(1, processes), argc > 3 ? std::atoi(argv[3]) : 2);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--bench-primitives") == 0) {
+        // Usage: --bench-primitives [contending threads]
+        return bench_primitives(std::max(2, argc > 2 ? std::atoi(argv[2]) : 4));
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--bench-crc32c") == 0) {
+        return bench_crc32c();
+    }
+    if (argc > 2 && std::strcmp(argv[1], "--bench-event-log") == 0) {
+        // Usage: --bench-event-log PATH [events]
+        return bench_event_log(argv[2], argc > 3 ? std::atoll(argv[3]) : 10000000);
+    }
+    if (!snapshot_path.empty() && store_path != nullptr) {
+        // fork() only freezes private memory; the store's MAP_SHARED region would keep changing
+        cerr << "--snapshot needs train_state in private memory; --store already checkpoints it" << endl;
+        return 1;
+    }
+    if (shm_name != nullptr && (store_path != nullptr || wal_path != nullptr || !snapshot_path.empty())) {
+        // Each of these assumes one process owns train_state
+        cerr << "--shm cannot be combined with --store, --wal or --snapshot" << endl;
+        return 1;
+    }
+    if (shm_name != nullptr && availability_tree_enabled) {
+        // The tree is private; bookings of the other processes would never refresh it
+        cerr << "--shm cannot be combined with --availability-tree" << endl;
+        return 1;
+    }
+
+    if (argc > 2 && std::strcmp(argv[1], "--bench-store") == 0) {
+        // Usage: --bench-store PATH [trains] [days]
+        std::uint32_t trains = argc > 3 ? static_cast<std::uint32_t>(std::atol(argv[3])) : 1000000;
+        std::uint32_t days = argc > 4 ? static_cast<std::uint32_t>(std::atol(argv[4])) : 120;
+        return bench_store(argv[2], trains, days);
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--bench-engines") == 0) {
+        // Usage: --bench-engines [threads] [seconds per run]
+        int threads = argc > 2 ? std::atoi(argv[2]) : MAX_THREADS;
+        int seconds = argc > 3 ? std::atoi(argv[3]) : 2;
+        const EngineWorkload workloads[] = {
+            {"read-heavy ", num_trains, 90},
+            {"write-heavy", num_trains, 10},
+            {"hot-spot   ", 2, 10},
+        };
+        const EngineMode modes[] = {ENGINE_MUTEX, ENGINE_ATOMIC, ENGINE_OCC};
+        cout << "--- Engine benchmark: " << threads << " threads, " << seconds << " s per run ---\n";
+        bool seats_ok = true;
+        for (const EngineWorkload& workload : workloads) {
+            for (EngineMode mode : modes) seats_ok = bench_engine(mode, workload, threads, seconds) && seats_ok;
+        }
+        return seats_ok ? 0 : 1;
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--bench-live-report") == 0) {
+        // Usage: --bench-live-report [threads] [seconds per run]
+        int threads = argc > 2 ? std::atoi(argv[2]) : MAX_THREADS;
+        int seconds = argc > 3 ? std::atoi(argv[3]) : 2;
+        bench_live_report(threads, seconds, true);
+        bench_live_report(threads, seconds, false);
+        return 0;
+    }
+
+    if (argc > 2 && std::strcmp(argv[1], "--crash-torture") == 0) {
+        // Usage: --crash-torture DIR [rounds]
+        return crash_torture(argv[2], argc > 3 ? std::atoi(argv[3]) : 20);
+    }
+
+    if (argc > 2 && std::strcmp(argv[1], "--bench-wal") == 0) {
+        // Usage: --bench-wal PATH [threads] [seconds per mode]
+        int threads = argc > 3 ? std::atoi(argv[3]) : MAX_THREADS;
+        int seconds = argc > 4 ? std::atoi(argv[4]) : 2;
+        cout << "--- Journal writer benchmark: " << threads << " committers, " << seconds << " s per mode ---\n";
+        const WalWriter::IoMode modes[] = {WalWriter::IO_WRITE, WalWriter::IO_PWRITEV, WalWriter::IO_URING};
+        for (WalWriter::IoMode mode : modes) bench_wal(argv[2], mode, threads, seconds);
+        return 0;
+    }
+
+    if (argc > 2 && std::strcmp(argv[1], "--bench-compaction") == 0) {
+        // Usage: --bench-compaction DIR [threads] [seconds per run]
+        int threads = argc > 3 ? std::atoi(argv[3]) : MAX_THREADS;
+        int seconds = argc > 4 ? std::atoi(argv[4]) : 3;
+        return bench_compaction(argv[2], threads, seconds);
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--bench-open-loop") == 0) {
+        // Usage: --bench-open-loop [threads] [seconds per rate] [poisson|constant]
+        int threads = argc > 2 ? std::atoi(argv[2]) : MAX_THREADS;
+        int seconds = argc > 3 ? std::atoi(argv[3]) : 2;
+        bool poisson = argc <= 4 || std::strcmp(argv[4], "constant") != 0;
+        return bench_open_loop(std::max(1, threads), std::max(1, seconds), poisson);
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--bench-policies") == 0) {
+        // Usage: --bench-policies [threads] [seconds per engine]
+        int threads = argc > 2 ? std::atoi(argv[2]) : MAX_THREADS;
+        int seconds = argc > 3 ? std::atoi(argv[3]) : 1;
+        return bench_policies(std::max(1, threads), std::max(1, seconds));
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--bench-inventory") == 0) {
+        // Usage: --bench-inventory [trains] [days]
+        long long inventory_trains = argc > 2 ? std::atoll(argv[2]) : 100000;
+        int days = argc > 3 ? std::atoi(argv[3]) : 60;
+        return bench_inventory(static_cast<std::size_t>(std::max(1LL, inventory_trains)), std::max(1, days));
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--bench-search") == 0) {
+        // Usage: --bench-search [max entries]
+        long long entries = argc > 2 ? std::atoll(argv[2]) : 16 << 20;
+        return bench_search(static_cast<std::size_t>(std::max(1000LL, entries)));
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--bench-availability-tree") == 0) {
+        // Usage: --bench-availability-tree [threads] [seconds per run]
+        int threads = argc > 2 ? std::atoi(argv[2]) : MAX_THREADS;
+        int seconds = argc > 3 ? std::atoi(argv[3]) : 1;
+        return bench_availability_tree(std::max(1, threads), std::max(1, seconds));
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--bench-occupancy") == 0) {
+        // Usage: --bench-occupancy [client threads] [seconds per run]
+        int threads = argc > 2 ? std::atoi(argv[2]) : 4;
+        int seconds = argc > 3 ? std::atoi(argv[3]) : 1;
+        return bench_occupancy(std::max(1, threads), std::max(1, seconds));
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--bench-coalescing") == 0) {
+        // Usage: --bench-coalescing [threads] [seconds per run] [service us]
+        int threads = argc > 2 ? std::atoi(argv[2]) : 64;
+        int seconds = argc > 3 ? std::atoi(argv[3]) : 1;
+        int service_us = argc > 4 ? std::atoi(argv[4]) : 5;
+        return bench_coalescing(std::max(1, threads), std::max(1, seconds), std::max(0, service_us));
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--bench-trains") == 0) {
+        // Usage: --bench-trains [threads] [seconds per run]
+        int threads = argc > 2 ? std::atoi(argv[2]) : MAX_THREADS;
+        int seconds = argc > 3 ? std::atoi(argv[3]) : 1;
+        return bench_trains(std::max(1, threads), std::max(1, seconds));
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--bench-scaling") == 0) {
+        // Usage: --bench-scaling [seconds per configuration] [csv|json] > report
+        int seconds = argc > 2 ? std::atoi(argv[2]) : 1;
+        bool json = argc > 3 && std::strcmp(argv[3], "json") == 0;
+        return bench_scaling(std::max(1, seconds), json);
+    }
+
+    if (argc > 2 && std::strcmp(argv[1], "--bench-recovery") == 0) {
+        // Usage: --bench-recovery DIR [max records]
+        return bench_recovery(argv[2], argc > 3 ? std::atoll(argv[3]) : 10000000);
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--bench-itinerary") == 0) {
+        // Usage: --bench-itinerary [threads] [seconds per configuration]
+        int threads = argc > 2 ? std::atoi(argv[2]) : MAX_THREADS;
+        int seconds = argc > 3 ? std::atoi(argv[3]) : 2;
+        const int hot_sets[] = {3, 4, 8, 16, num_trains};
+        for (int hot_trains : hot_sets) bench_itinerary(threads, hot_trains, seconds);
+        return 0;
+    }
+
+    std::srand(std::time(nullptr));
+    std::vector<int> listen_fds;
+    if (serve_port > 0 && !open_server_sockets(serve_port, listen_fds)) return 1;
+    if (shm_name != nullptr && !open_shared_table(shm_name)) return 1;
+    if (!open_durable_state(store_path, wal_path)) return 1;
+    recount_occupancy();
+    if (availability_tree_enabled) availability_tree.build(train_state, num_trains);
+    if (event_log_path != nullptr && !event_log.open(event_log_path)) {
+        cerr << "Cannot create event log " << event_log_path << ": " << std::strerror(errno) << endl;
+        return 1;
+    }
+
+    auto run_start = std::chrono::steady_clock::now();
+    long long run_start_faults = fork_snapshot_detail::minor_faults();
+    if (!snapshot_path.empty()) {
+        crc32c(nullptr, 0); // Build the CRC tables here, never inside a forked child
+        snapshotter_running = true;
+        snapshotter_thread = std::thread(snapshotter_loop);
+    }
+    if (live_report_enabled) {
+        live_report_running = true;
+        live_report_thread = std::thread(live_report_loop);
+    }
+
+    // Start the hold expiry service before any worker can place a hold
+    hold_expiry_running = true;
+    hold_expiry_thread = std::thread(hold_expiry_loop);
+
+    if (serve_port > 0) {
+        // Network clients replace the simulated workers
+        run_server(serve_port, listen_fds);
+    } else {
+        // Creating and running the worker threads
+        for (int i = 0; i < MAX_THREADS; i++) {
+            threads[i] = std::thread(worker_thread, i);
+            num_threads++;
+        }
+
+        // Wait for all threads to finish
+        for (int i = 0; i < num_threads; i++) {
+            threads[i].join();
+        }
+    }
+
+    long long run_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - run_start).count();
+    long long run_faults = fork_snapshot_detail::minor_faults() - run_start_faults;
+    if (!snapshot_path.empty()) {
+        {
+            lock_guard<std::mutex> lock(snapshotter_mutex);
+            snapshotter_running = false;
+        }
+        snapshotter_cond.notify_one();
+        snapshotter_thread.join();
+    }
+    if (live_report_enabled) {
+        {
+            lock_guard<std::mutex> lock(live_report_mutex);
+            live_report_running = false;
+        }
+        live_report_cond.notify_one();
+        live_report_thread.join();
+    }
+
+    // No one is left to pay: stop the expiry service and release whatever is still held
+    hold_expiry_running = false;
+    hold_expiry_thread.join();
+    expire_holds_until(hold_current_tick() + HOLD_TTL_MS / HOLD_TICK_MS + 1);
+    if (journal_enabled) stop_compactor();
+    journal.close();
+    bool event_log_ok = event_log.close();
+
+    if (store_enabled) {
+        {
+            lock_guard<std::mutex> lock(checkpointer_mutex);
+            checkpointer_running = false;
+        }
+        checkpointer_cond.notify_one();
+        checkpointer_thread.join();
+        // All writers are gone: the final checkpoint also marks the live region reusable
+        if (!seat_store.checkpoint(true)) {
+            cerr << "Final checkpoint failed: " << seat_store.last_error() << endl;
+        }
+    }
+
+    cout << "\n--- Final Reservation Chart ---\n";
+    cout << "    Train number    Available Seats\n";
+    for(int i = 0; i < std::min(num_trains, DEFAULT_TRAINS); i++){
+        cout << "        " << i << "                " << seats_available(i) << endl;
+    }
+    OccupancySummary summary = read_occupancy();
+    if (num_trains > DEFAULT_TRAINS) {
+        cout << "    ... " << num_trains - DEFAULT_TRAINS << " more trains; " << summary.available
+             << " seats available on all " << num_trains << " trains" << endl;
+    }
+    cout << "Occupancy:             " << std::fixed << std::setprecision(1) << 100 * summary.load_factor << "% ("
+         << summary.booked << " seats booked, " << summary.held << " held, " << summary.sold_out
+         << " trains sold out)" << std::defaultfloat << endl;
+    print_waitlist_stats();
+    print_hold_stats();
+    if (coalesce_inquiries) print_coalescing_stats();
+    cout << "\n--- Engine Statistics (" << engine_name(engine_mode) << ") ---\n";
+    print_engine_stats(engine_totals);
+    if (serve_port > 0) print_server_stats(listen_fds.size(), run_ns);
+    if (journal_enabled) {
+        print_journal_stats();
+        print_compaction_stats(compaction_totals, journal.stats().bytes, journal_checkpoint);
+    }
+    if (event_log_path != nullptr) {
+        long long events = event_log.events() > 0 ? event_log.events() : 1;
+        cout << "\n--- Event Log Statistics ---\n";
+        cout << "Events:                " << event_log.events() << " in " << event_log.blocks() << " blocks -> "
+             << event_log_path << endl;
+        cout << "Size:                  " << event_log.bytes() << " bytes ("
+             << static_cast<double>(event_log.bytes()) / events << " bytes/event)" << endl;
+        if (!event_log_ok) cout << "WARNING: event log write FAILED" << endl;
+    }
+    if (!snapshot_path.empty()) print_snapshot_stats(run_ns, run_faults);
+    if (live_report_enabled) {
+        cout << "\n--- Live Report Statistics ---\n";
+        print_consistent_read_stats(consistent_read_totals);
+    }
+    if (store_enabled) {
+        cout << "\n--- Seat Store Statistics ---\n";
+        cout << "Periodic checkpoints:  " << checkpoints_taken.load() << " (max "
+             << checkpoint_ns_max.load() / 1000 << " us)" << endl;
+        cout << "Checkpoint sequence:   " << seat_store.checkpoint_sequence() << endl;
+    }
+    cout << "\n--- Itinerary Statistics ---\n";
+    print_itinerary_stats(itinerary_totals);
+    if (shared_enabled) {
+        print_shared_table_stats();
+        shared_table.close();
+    }
+    cout << "Thanks for using our services!!!\n";
+
+    return journal_enabled && journal.has_failed() ? 1 : 0;
 }
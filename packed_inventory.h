@@ -0,0 +1,167 @@
+#ifndef PACKED_INVENTORY_H
+#define PACKED_INVENTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include "seat_search.h"
+
+// Seat inventory for trains x days x classes, packed for scans.
+//
+// Counters are 16-bit (a train class holds at most 65535 seats) and stored as a structure of
+// arrays: one row per (day, class) holding that slot for every train, so "which trains have n
+// seats in class c on day d" streams one contiguous row at 2 bytes a train instead of striding
+// through per-train records. Rows start on a cache line and are padded to a whole number of
+// lines; padding counters are 0, so a scan may run over them.
+//
+// Per-train metadata is bit-packed into 16 bits next to the rows:
+//   bits 0-3   class mask: the classes the train runs (a class it does not run has 0 seats)
+//   bits 4-15  quota: seats per class held back from general sale (0-4095)
+//
+// The table does no locking. Writers of one train must be serialized by the caller (e.g. by the
+// train's lock), and scans see a consistent row only while no writer runs.
+class PackedInventory {
+public:
+    static constexpr int MAX_CLASSES = 4;
+    static constexpr int MAX_QUOTA = 0xFFF;
+    static constexpr std::size_t LINE_COUNTERS = 64 / sizeof(std::uint16_t);
+
+    PackedInventory() = default;
+    PackedInventory(const PackedInventory&) = delete;
+    PackedInventory& operator=(const PackedInventory&) = delete;
+    ~PackedInventory() { release(); }
+
+    // Sizes the table and fills every slot of a class the train runs with `capacity` seats.
+    // Every train starts out running all `classes` classes without a quota.
+    bool allocate(std::size_t trains, int days, int classes, int capacity) {
+        release();
+        if (classes < 1 || classes > MAX_CLASSES || days < 1 || capacity < 0 || capacity > 0xFFFF) return false;
+        num_trains = trains;
+        num_days = days;
+        num_classes = classes;
+        row_stride = (trains + LINE_COUNTERS - 1) / LINE_COUNTERS * LINE_COUNTERS;
+        std::size_t counter_bytes = row_stride * num_rows() * sizeof(std::uint16_t);
+        std::size_t meta_bytes = (trains * sizeof(std::uint16_t) + 63) / 64 * 64;
+        counters = static_cast<std::uint16_t*>(std::aligned_alloc(64, counter_bytes));
+        meta = static_cast<std::uint16_t*>(std::aligned_alloc(64, meta_bytes));
+        if (counters == nullptr || meta == nullptr) {
+            release();
+            return false;
+        }
+        std::uint16_t all_classes = static_cast<std::uint16_t>((1u << classes) - 1);
+        for (std::size_t train = 0; train < trains; train++) meta[train] = all_classes;
+        for (std::size_t r = 0; r < num_rows(); r++) {
+            std::uint16_t* line = counters + r * row_stride;
+            for (std::size_t train = 0; train < row_stride; train++) {
+                line[train] = train < trains ? static_cast<std::uint16_t>(capacity) : 0;
+            }
+        }
+        return true;
+    }
+
+    std::size_t trains() const { return num_trains; }
+    int days() const { return num_days; }
+    int classes() const { return num_classes; }
+
+    // The row of (day, cls): trains() counters, padded with zeros to row_counters().
+    const std::uint16_t* row(int day, int cls) const { return counters + row_index(day, cls) * row_stride; }
+    std::size_t row_counters() const { return row_stride; }
+
+    int available(std::size_t train, int day, int cls) const { return slot(train, day, cls); }
+
+    // Seats open to general sale: the available seats above the train's quota.
+    int general_available(std::size_t train, int day, int cls) const {
+        int open = slot(train, day, cls) - quota(train);
+        return open > 0 ? open : 0;
+    }
+
+    // Takes `seats` from the slot. General bookings may not dip into the quota.
+    bool book(std::size_t train, int day, int cls, int seats, bool from_quota) {
+        std::uint16_t& counter = slot(train, day, cls);
+        int floor = from_quota ? 0 : quota(train);
+        if (seats <= 0 || counter - seats < floor) return false;
+        counter = static_cast<std::uint16_t>(counter - seats);
+        return true;
+    }
+
+    // Returns `seats` to the slot, up to `capacity`.
+    bool cancel(std::size_t train, int day, int cls, int seats, int capacity) {
+        std::uint16_t& counter = slot(train, day, cls);
+        if (seats <= 0 || counter + seats > capacity) return false;
+        counter = static_cast<std::uint16_t>(counter + seats);
+        return true;
+    }
+
+    bool runs_class(std::size_t train, int cls) const { return (meta[train] >> cls) & 1; }
+    int quota(std::size_t train) const { return meta[train] >> 4; }
+
+    // Changes which classes the train runs; slots of classes it stops running drop to 0 seats.
+    void set_classes(std::size_t train, unsigned class_mask) {
+        class_mask &= (1u << num_classes) - 1;
+        meta[train] = static_cast<std::uint16_t>((meta[train] & ~0xFu) | class_mask);
+        for (int day = 0; day < num_days; day++) {
+            for (int cls = 0; cls < num_classes; cls++) {
+                if (!((class_mask >> cls) & 1)) slot(train, day, cls) = 0;
+            }
+        }
+    }
+
+    void set_quota(std::size_t train, int seats) {
+        if (seats < 0) seats = 0;
+        if (seats > MAX_QUOTA) seats = MAX_QUOTA;
+        meta[train] = static_cast<std::uint16_t>((meta[train] & 0xFu) | seats << 4);
+    }
+
+    // Number of trains with at least `seats` available in class `cls` on `day`. Counting a cache
+    // line at a time into a 16-bit total with a 16-bit threshold keeps every lane 16 bits wide,
+    // which is what lets the compiler vectorize the loop.
+    std::size_t count_at_least(int day, int cls, int seats) const {
+        if (seats <= 0) return num_trains;
+        if (seats > 0xFFFF) return 0;
+        const std::uint16_t* line = row(day, cls);
+        std::uint16_t threshold = static_cast<std::uint16_t>(seats);
+        std::size_t count = 0;
+        for (std::size_t first = 0; first < row_stride; first += LINE_COUNTERS) {
+            std::uint16_t in_line = 0;
+            for (std::size_t i = 0; i < LINE_COUNTERS; i++) in_line += line[first + i] >= threshold;
+            count += in_line;
+        }
+        return count; // Padding holds 0 seats, so it never counts
+    }
+
+    // Writes the trains with at least `seats` available in class `cls` on `day` to `out` (room for
+    // trains() entries) and returns how many there are.
+    std::size_t find_at_least(int day, int cls, int seats, std::uint32_t* out) const {
+        return seat_search_u16(row(day, cls), num_trains, seats, out);
+    }
+
+    std::size_t bytes() const {
+        return row_stride * num_rows() * sizeof(std::uint16_t) + (num_trains * sizeof(std::uint16_t) + 63) / 64 * 64;
+    }
+
+private:
+    std::size_t num_rows() const { return static_cast<std::size_t>(num_days) * num_classes; }
+    std::size_t row_index(int day, int cls) const { return static_cast<std::size_t>(day) * num_classes + cls; }
+    std::uint16_t& slot(std::size_t train, int day, int cls) { return counters[row_index(day, cls) * row_stride + train]; }
+    std::uint16_t slot(std::size_t train, int day, int cls) const {
+        return counters[row_index(day, cls) * row_stride + train];
+    }
+
+    void release() {
+        std::free(counters);
+        std::free(meta);
+        counters = nullptr;
+        meta = nullptr;
+        num_trains = 0;
+    }
+
+    std::uint16_t* counters = nullptr;
+    std::uint16_t* meta = nullptr;
+    std::size_t num_trains = 0;
+    std::size_t row_stride = 0;
+    int num_days = 0;
+    int num_classes = 0;
+};
+
+#endif // PACKED_INVENTORY_H
@@ -0,0 +1,127 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Wire protocol of the booking server (--serve) and its load generator.
+//
+// Every frame is a 16-bit little-endian body length followed by the body, so a reader can split
+// a byte stream into frames without understanding them and skip fields it does not know.
+// Requests may be pipelined: a client sends any number of frames without waiting, and the
+// server answers each connection's requests in order.
+//
+//   Request body (11 bytes):  op u8 | request_id u32 | train u32 | seats u16
+//   Response body (10 bytes): op u8 | status u8 | request_id u32 | seats_available i32
+//
+// request_id is chosen by the client and echoed back; seats_available is the train's
+// availability right after the request. Bodies longer than these are accepted and the extra
+// bytes ignored; shorter ones are malformed and end the connection.
+
+enum RequestOp : std::uint8_t {
+    REQ_INQUIRY = 1,
+    REQ_BOOK,
+    REQ_CANCEL
+};
+
+enum ResponseStatus : std::uint8_t {
+    RESP_OK = 0,
+    RESP_REJECTED,   // Not enough seats to book, or fewer booked seats than asked to cancel
+    RESP_BAD_REQUEST, // Unknown op, train or seat count
+    RESP_NOT_DURABLE  // Applied, but the journal failed, so it may not survive a restart
+};
+
+struct Request {
+    std::uint8_t op;
+    std::uint32_t request_id;
+    std::uint32_t train_num;
+    std::uint16_t seats;
+};
+
+struct Response {
+    std::uint8_t op;
+    std::uint8_t status;
+    std::uint32_t request_id;
+    std::int32_t seats_available;
+};
+
+const std::size_t FRAME_PREFIX_BYTES = 2;
+const std::size_t REQUEST_BODY_BYTES = 11;
+const std::size_t RESPONSE_BODY_BYTES = 10;
+const std::size_t REQUEST_FRAME_BYTES = FRAME_PREFIX_BYTES + REQUEST_BODY_BYTES;
+const std::size_t RESPONSE_FRAME_BYTES = FRAME_PREFIX_BYTES + RESPONSE_BODY_BYTES;
+
+namespace protocol_detail {
+
+inline void put_u16(unsigned char* p, std::uint16_t v) {
+    p[0] = static_cast<unsigned char>(v);
+    p[1] = static_cast<unsigned char>(v >> 8);
+}
+inline void put_u32(unsigned char* p, std::uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = static_cast<unsigned char>(v >> (8 * i));
+}
+inline std::uint16_t get_u16(const unsigned char* p) {
+    return static_cast<std::uint16_t>(p[0] | p[1] << 8);
+}
+inline std::uint32_t get_u32(const unsigned char* p) {
+    return std::uint32_t(p[0]) | std::uint32_t(p[1]) << 8 | std::uint32_t(p[2]) << 16 | std::uint32_t(p[3]) << 24;
+}
+
+// Length of the frame starting at data: 0 while incomplete, -1 if its body is shorter than
+// min_body.
+inline long frame_bytes(const unsigned char* data, std::size_t size, std::size_t min_body) {
+    if (size < FRAME_PREFIX_BYTES) return 0;
+    std::size_t body = get_u16(data);
+    if (body < min_body) return -1;
+    if (size < FRAME_PREFIX_BYTES + body) return 0;
+    return static_cast<long>(FRAME_PREFIX_BYTES + body);
+}
+
+} // namespace protocol_detail
+
+// Writes REQUEST_FRAME_BYTES bytes.
+inline void encode_request(const Request& request, unsigned char* out) {
+    using namespace protocol_detail;
+    put_u16(out, static_cast<std::uint16_t>(REQUEST_BODY_BYTES));
+    out[2] = request.op;
+    put_u32(out + 3, request.request_id);
+    put_u32(out + 7, request.train_num);
+    put_u16(out + 11, request.seats);
+}
+
+// Parses the frame at the front of [data, data + size). Returns the bytes it took, 0 if the
+// frame is not complete yet, or -1 if it is malformed.
+inline long decode_request(const unsigned char* data, std::size_t size, Request& request) {
+    using namespace protocol_detail;
+    long bytes = frame_bytes(data, size, REQUEST_BODY_BYTES);
+    if (bytes <= 0) return bytes;
+    request.op = data[2];
+    request.request_id = get_u32(data + 3);
+    request.train_num = get_u32(data + 7);
+    request.seats = get_u16(data + 11);
+    return bytes;
+}
+
+// Writes RESPONSE_FRAME_BYTES bytes.
+inline void encode_response(const Response& response, unsigned char* out) {
+    using namespace protocol_detail;
+    put_u16(out, static_cast<std::uint16_t>(RESPONSE_BODY_BYTES));
+    out[2] = response.op;
+    out[3] = response.status;
+    put_u32(out + 4, response.request_id);
+    put_u32(out + 8, static_cast<std::uint32_t>(response.seats_available));
+}
+
+// As decode_request.
+inline long decode_response(const unsigned char* data, std::size_t size, Response& response) {
+    using namespace protocol_detail;
+    long bytes = frame_bytes(data, size, RESPONSE_BODY_BYTES);
+    if (bytes <= 0) return bytes;
+    response.op = data[2];
+    response.status = data[3];
+    response.request_id = get_u32(data + 4);
+    response.seats_available = static_cast<std::int32_t>(get_u32(data + 8));
+    return bytes;
+}
+
+#endif // PROTOCOL_H
@@ -0,0 +1,254 @@
+#ifndef RESERVATION_ENGINE_H
+#define RESERVATION_ENGINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+// Reservation hot path (inquiry / book / cancel) assembled from compile-time policies:
+//
+//   ReservationEngine<Storage, LockPolicy, AdmissionPolicy, Capacity>
+//
+// Storage      template <typename Counter> holding one seat count per train:
+//                PlainCounters      plain integers; writers must be serialized
+//                AtomicCounters     std::atomic integers updated by CAS; safe without locks
+//                VersionedWords     seats and a version packed into one 64-bit word, as
+//                                   train_state does; safe without locks
+// LockPolicy   what serializes the writers of one train:
+//                StripedLocks<M>    a power-of-two array of M; train n takes lock n & (stripes - 1)
+//                NoLocks            nothing; only with storage that is safe without locks
+//                ShardOwned         nothing, because the caller guarantees each train is only
+//                                   touched by the one thread owning its shard
+// AdmissionPolicy  bounds the requests inside at once:
+//                GateAdmission<N>   mutex + condition variable, like worker_thread's access gate
+//                NoAdmission
+// Capacity     seats per train. It picks the narrowest counter that holds it: uint16_t up to
+//              65535 (32 trains per cache line), else uint32_t.
+//
+// Everything is resolved at compile time, so an engine built from NoLocks and NoAdmission carries
+// no trace of either, and a benchmark can instantiate every combination side by side.
+// Combinations that would race (plain counters without a lock or an owner) do not compile.
+
+template <int Capacity>
+using SeatCounter = typename std::conditional<(Capacity <= 0xFFFF), std::uint16_t, std::uint32_t>::type;
+
+// --- Storage ---
+
+template <typename Counter>
+class PlainCounters {
+public:
+    static constexpr bool needs_serialized_writers = true;
+    static constexpr std::size_t bytes_per_train = sizeof(Counter);
+
+    PlainCounters(std::size_t trains, int initial) : seats(new Counter[trains]) {
+        for (std::size_t i = 0; i < trains; i++) seats[i] = static_cast<Counter>(initial);
+    }
+    int available(std::size_t train) const { return seats[train]; }
+    bool take(std::size_t train, int n) {
+        if (seats[train] < n) return false;
+        seats[train] = static_cast<Counter>(seats[train] - n);
+        return true;
+    }
+    bool give(std::size_t train, int n, int limit) {
+        if (seats[train] + n > limit) return false;
+        seats[train] = static_cast<Counter>(seats[train] + n);
+        return true;
+    }
+
+private:
+    std::unique_ptr<Counter[]> seats;
+};
+
+template <typename Counter>
+class AtomicCounters {
+public:
+    static constexpr bool needs_serialized_writers = false;
+    static constexpr std::size_t bytes_per_train = sizeof(std::atomic<Counter>);
+
+    AtomicCounters(std::size_t trains, int initial) : seats(new std::atomic<Counter>[trains]) {
+        for (std::size_t i = 0; i < trains; i++) seats[i].store(static_cast<Counter>(initial), std::memory_order_relaxed);
+    }
+    int available(std::size_t train) const { return seats[train].load(std::memory_order_acquire); }
+    bool take(std::size_t train, int n) {
+        Counter current = seats[train].load(std::memory_order_acquire);
+        do {
+            if (static_cast<int>(current) < n) return false;
+        } while (!seats[train].compare_exchange_weak(current, static_cast<Counter>(current - n),
+                                                     std::memory_order_acq_rel, std::memory_order_acquire));
+        return true;
+    }
+    bool give(std::size_t train, int n, int limit) {
+        Counter current = seats[train].load(std::memory_order_acquire);
+        do {
+            if (static_cast<int>(current) + n > limit) return false;
+        } while (!seats[train].compare_exchange_weak(current, static_cast<Counter>(current + n),
+                                                     std::memory_order_acq_rel, std::memory_order_acquire));
+        return true;
+    }
+
+private:
+    std::unique_ptr<std::atomic<Counter>[]> seats;
+};
+
+// Seats in the high 32 bits, a version every change bumps in the low 32; the counter width is
+// fixed by the word, so Counter only has to be wide enough for the capacity.
+template <typename Counter>
+class VersionedWords {
+public:
+    static constexpr bool needs_serialized_writers = false;
+    static constexpr std::size_t bytes_per_train = sizeof(std::atomic<std::uint64_t>);
+
+    VersionedWords(std::size_t trains, int initial) : words(new std::atomic<std::uint64_t>[trains]) {
+        for (std::size_t i = 0; i < trains; i++) words[i].store(pack(initial, 0), std::memory_order_relaxed);
+    }
+    int available(std::size_t train) const { return seats_of(words[train].load(std::memory_order_acquire)); }
+    bool take(std::size_t train, int n) { return update(train, -n, 0, n); }
+    bool give(std::size_t train, int n, int limit) { return update(train, n, limit, 0); }
+
+private:
+    static std::uint64_t pack(int seats, std::uint32_t version) {
+        return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(seats)) << 32) | version;
+    }
+    static int seats_of(std::uint64_t word) { return static_cast<std::int32_t>(word >> 32); }
+
+    // Moves the seats by delta if they stay within [floor, limit] (limit 0: no upper bound).
+    bool update(std::size_t train, int delta, int limit, int floor) {
+        std::uint64_t word = words[train].load(std::memory_order_acquire);
+        while (true) {
+            int seats = seats_of(word);
+            if (seats < floor || (limit > 0 && seats + delta > limit)) return false;
+            std::uint64_t next = pack(seats + delta, static_cast<std::uint32_t>(word) + 1);
+            if (words[train].compare_exchange_weak(word, next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return true;
+            }
+        }
+    }
+
+    std::unique_ptr<std::atomic<std::uint64_t>[]> words;
+};
+
+// --- Lock policies ---
+
+template <typename Mutex>
+class StripedLocks {
+public:
+    static constexpr bool serializes_writers = true;
+    static constexpr bool shard_owned = false;
+    static constexpr std::size_t MAX_STRIPES = 4096;
+
+    explicit StripedLocks(std::size_t trains) {
+        while (stripes < trains && stripes < MAX_STRIPES) stripes <<= 1;
+        locks.reset(new Mutex[stripes]);
+    }
+    std::unique_lock<Mutex> guard(std::size_t train) { return std::unique_lock<Mutex>(locks[train & (stripes - 1)]); }
+    std::size_t bytes() const { return stripes * sizeof(Mutex); }
+
+private:
+    std::size_t stripes = 1;
+    std::unique_ptr<Mutex[]> locks;
+};
+
+struct NoGuard {};
+
+struct NoLocks {
+    static constexpr bool serializes_writers = false;
+    static constexpr bool shard_owned = false;
+    explicit NoLocks(std::size_t) {}
+    NoGuard guard(std::size_t) { return NoGuard(); }
+    std::size_t bytes() const { return 0; }
+};
+
+struct ShardOwned {
+    static constexpr bool serializes_writers = true;
+    static constexpr bool shard_owned = true;
+    explicit ShardOwned(std::size_t) {}
+    NoGuard guard(std::size_t) { return NoGuard(); }
+    std::size_t bytes() const { return 0; }
+};
+
+// --- Admission policies ---
+
+template <int Limit>
+class GateAdmission {
+public:
+    void enter() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this] { return active < Limit; });
+        active++;
+    }
+    void leave() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            active--;
+        }
+        cond.notify_one();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cond;
+    int active = 0;
+};
+
+struct NoAdmission {
+    void enter() {}
+    void leave() {}
+};
+
+// --- Engine ---
+
+template <template <typename> class Storage, typename LockPolicy, typename AdmissionPolicy, int Capacity>
+class ReservationEngine {
+public:
+    typedef SeatCounter<Capacity> Counter;
+    typedef Storage<Counter> StorageType;
+    static constexpr int capacity = Capacity;
+    static constexpr bool shard_owned = LockPolicy::shard_owned;
+
+    static_assert(Capacity > 0, "Capacity must be positive");
+    static_assert(!StorageType::needs_serialized_writers || LockPolicy::serializes_writers,
+                  "This storage is not thread-safe on its own: pair it with StripedLocks or ShardOwned");
+
+    ReservationEngine(std::size_t trains, int initial_seats) : storage(trains, initial_seats), locks(trains) {}
+
+    // Runs body() as one admitted request and returns its result.
+    template <typename Body>
+    auto admitted(Body&& body) -> decltype(body()) {
+        admission.enter();
+        auto result = body();
+        admission.leave();
+        return result;
+    }
+
+    int inquiry(std::size_t train) {
+        if (StorageType::needs_serialized_writers) {
+            auto guard = locks.guard(train);
+            (void)guard;
+            return storage.available(train);
+        }
+        return storage.available(train);
+    }
+    bool book(std::size_t train, int seats) {
+        auto guard = locks.guard(train);
+        (void)guard;
+        return storage.take(train, seats);
+    }
+    bool cancel(std::size_t train, int seats) {
+        auto guard = locks.guard(train);
+        (void)guard;
+        return storage.give(train, seats, Capacity);
+    }
+
+    std::size_t bytes(std::size_t trains) const { return trains * StorageType::bytes_per_train + locks.bytes(); }
+
+private:
+    StorageType storage;
+    LockPolicy locks;
+    AdmissionPolicy admission;
+};
+
+#endif // RESERVATION_ENGINE_H
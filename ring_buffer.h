@@ -0,0 +1,45 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-capacity FIFO ring.
+// Slots live inline in one contiguous array (no per-node allocation, unlike std::list),
+// so a whole per-train queue usually sits in a handful of cache lines.
+// Not thread-safe: callers protect it with the lock that owns the surrounding data.
+template <typename T, std::size_t N>
+class BoundedRing {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "BoundedRing capacity must be a power of two");
+
+public:
+    bool empty() const { return head == tail; }
+    bool full() const { return size() == N; }
+    std::size_t size() const { return static_cast<std::size_t>(tail - head); }
+    static constexpr std::size_t capacity() { return N; }
+
+    // Returns false (and leaves the ring untouched) when the ring is full.
+    bool push(const T& value) {
+        if (full()) return false;
+        slots[tail & MASK] = value;
+        tail++;
+        return true;
+    }
+
+    // Precondition: !empty()
+    T& front() { return slots[head & MASK]; }
+    const T& front() const { return slots[head & MASK]; }
+
+    // Precondition: !empty()
+    void pop() { head++; }
+
+private:
+    static constexpr std::uint32_t MASK = static_cast<std::uint32_t>(N - 1);
+
+    // Free-running counters; unsigned wrap-around keeps (tail - head) correct.
+    std::uint32_t head = 0;
+    std::uint32_t tail = 0;
+    T slots[N];
+};
+
+#endif // RING_BUFFER_H
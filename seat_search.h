@@ -0,0 +1,250 @@
+#ifndef SEAT_SEARCH_H
+#define SEAT_SEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SEAT_SEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+// "Which trains have at least N seats": scans an availability array and writes the indexes of
+// the matching entries, in order, to `out` (room for `count` entries). Returns how many matched.
+//
+// Two array shapes:
+//   seat_search_u16    16-bit counters, e.g. a PackedInventory row
+//   seat_search_words  train_state's 64-bit state words (signed seats in the high 32 bits)
+//
+// Three implementations, picked once at run time from CPUID like crc32c.h:
+//   SEAT_SEARCH_AVX512  AVX-512BW compares 32 counters (8 words) into a mask register and
+//                       vpcompressd packs the matching indexes
+//   SEAT_SEARCH_AVX2    AVX2 compares 16 counters (4 words), extracts a bit mask with movemask
+//                       and packs the matching indexes through a 256-entry permutation table
+//   SEAT_SEARCH_SCALAR  Portable loop
+// None of them branches per entry: a vector of indexes is compressed and stored whole, and only
+// the count of set bits advances the output, so a 50% match rate costs no more mispredictions
+// than 1%. Blocks without a match skip the store. The x86 paths are compiled through function
+// target attributes, so no -mavx2 is needed and the binary still runs without them.
+//
+// State words compare as signed 64-bit integers against min_seats << 32: the version in the low
+// half is below 2^32, so word >= min_seats << 32 exactly when the seats are >= min_seats.
+//
+// The kernels read plain memory. Searching a table that writers are changing gives no
+// consistency; search a snapshot (e.g. read_consistent_states) or a quiesced table.
+
+enum SeatSearchImplementation {
+    SEAT_SEARCH_SCALAR,
+    SEAT_SEARCH_AVX2,
+    SEAT_SEARCH_AVX512
+};
+
+namespace seat_search_detail {
+
+inline std::int64_t word_threshold(int min_seats) {
+    return static_cast<std::int64_t>(min_seats) * (std::int64_t(1) << 32);
+}
+
+// The scalar loops start at `first`, so the vector kernels can hand them their tails. Every
+// index is written and only the matches advance the output.
+inline std::size_t scalar_u16(const std::uint16_t* seats, std::size_t first, std::size_t count,
+                              std::uint16_t min_seats, std::uint32_t* out) {
+    std::size_t found = 0;
+    for (std::size_t i = first; i < count; i++) {
+        out[found] = static_cast<std::uint32_t>(i);
+        found += seats[i] >= min_seats;
+    }
+    return found;
+}
+
+inline std::size_t scalar_words(const std::uint64_t* words, std::size_t first, std::size_t count,
+                                std::int64_t threshold, std::uint32_t* out) {
+    std::size_t found = 0;
+    for (std::size_t i = first; i < count; i++) {
+        out[found] = static_cast<std::uint32_t>(i);
+        found += static_cast<std::int64_t>(words[i]) >= threshold;
+    }
+    return found;
+}
+
+#ifdef SEAT_SEARCH_X86
+
+// The kernels store a whole block of indexes at out + found. found never exceeds the block's
+// first index, so the store stays inside the `count` entries the caller provides.
+
+// For every 8-bit mask, the lanes of its set bits packed to the front: entry m holds lane
+// numbers as bytes, for _mm256_permutevar8x32_epi32.
+struct CompressTable {
+    std::uint64_t lanes[256];
+
+    CompressTable() {
+        for (int mask = 0; mask < 256; mask++) {
+            std::uint64_t packed = 0;
+            int out = 0;
+            for (int lane = 0; lane < 8; lane++) {
+                if ((mask >> lane) & 1) packed |= static_cast<std::uint64_t>(lane) << (8 * out++);
+            }
+            lanes[mask] = packed;
+        }
+    }
+};
+
+inline const CompressTable& compress_table() {
+    static const CompressTable instance;
+    return instance;
+}
+
+// Stores the indexes base + lane of the 8 lanes set in mask, packed, and returns how many.
+__attribute__((target("avx2,popcnt")))
+inline std::size_t avx2_store_lanes(std::uint32_t mask, std::size_t base, std::uint32_t* out) {
+    const __m256i iota = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i lanes = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(static_cast<long long>(compress_table().lanes[mask])));
+    __m256i indexes = _mm256_add_epi32(iota, _mm256_set1_epi32(static_cast<int>(base)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_permutevar8x32_epi32(indexes, lanes));
+    return static_cast<std::size_t>(__builtin_popcount(mask));
+}
+
+__attribute__((target("avx2,popcnt")))
+inline std::size_t avx2_u16(const std::uint16_t* seats, std::size_t count, std::uint16_t min_seats,
+                            std::uint32_t* out) {
+    // No unsigned 16-bit compare in AVX2: x >= n exactly when max(x, n) == x
+    const __m256i threshold = _mm256_set1_epi16(static_cast<short>(min_seats));
+    std::size_t found = 0;
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(seats + i));
+        __m256i match = _mm256_cmpeq_epi16(_mm256_max_epu16(v, threshold), v);
+        // Narrow the 16 lanes to bytes, in order, so movemask yields one bit per counter
+        __m256i narrow = _mm256_permute4x64_epi64(_mm256_packs_epi16(match, _mm256_setzero_si256()), 0xD8);
+        std::uint32_t mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(narrow));
+        if (mask == 0) continue;
+        found += avx2_store_lanes(mask & 0xFF, i, out + found);
+        found += avx2_store_lanes(mask >> 8, i + 8, out + found);
+    }
+    return found + scalar_u16(seats, i, count, min_seats, out + found);
+}
+
+__attribute__((target("avx2,popcnt")))
+inline std::size_t avx2_words(const std::uint64_t* words, std::size_t count, std::int64_t threshold,
+                              std::uint32_t* out) {
+    const __m256i below = _mm256_set1_epi64x(threshold - 1);
+    std::size_t found = 0;
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i low = _mm256_cmpgt_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i)), below);
+        __m256i high = _mm256_cmpgt_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i + 4)), below);
+        std::uint32_t mask = static_cast<std::uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(low)) |
+                                                        _mm256_movemask_pd(_mm256_castsi256_pd(high)) << 4);
+        if (mask != 0) found += avx2_store_lanes(mask, i, out + found);
+    }
+    return found + scalar_words(words, i, count, threshold, out + found);
+}
+
+// Stores the indexes base + lane of the 16 lanes set in mask, packed, and returns how many.
+__attribute__((target("avx512f,popcnt")))
+inline std::size_t avx512_store_lanes(__mmask16 mask, std::size_t base, std::uint32_t* out) {
+    const __m512i iota = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i indexes = _mm512_add_epi32(iota, _mm512_set1_epi32(static_cast<int>(base)));
+    _mm512_storeu_si512(out, _mm512_maskz_compress_epi32(mask, indexes));
+    return static_cast<std::size_t>(__builtin_popcount(mask));
+}
+
+__attribute__((target("avx512f,avx512bw,popcnt")))
+inline std::size_t avx512_u16(const std::uint16_t* seats, std::size_t count, std::uint16_t min_seats,
+                              std::uint32_t* out) {
+    const __m512i threshold = _mm512_set1_epi16(static_cast<short>(min_seats));
+    std::size_t found = 0;
+    std::size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __mmask32 mask = _mm512_cmpge_epu16_mask(_mm512_loadu_si512(seats + i), threshold);
+        if (mask == 0) continue;
+        found += avx512_store_lanes(static_cast<__mmask16>(mask), i, out + found);
+        found += avx512_store_lanes(static_cast<__mmask16>(mask >> 16), i + 16, out + found);
+    }
+    return found + scalar_u16(seats, i, count, min_seats, out + found);
+}
+
+__attribute__((target("avx512f,popcnt")))
+inline std::size_t avx512_words(const std::uint64_t* words, std::size_t count, std::int64_t threshold,
+                                std::uint32_t* out) {
+    const __m512i limit = _mm512_set1_epi64(threshold);
+    std::size_t found = 0;
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __mmask8 low = _mm512_cmpge_epi64_mask(_mm512_loadu_si512(words + i), limit);
+        __mmask8 high = _mm512_cmpge_epi64_mask(_mm512_loadu_si512(words + i + 8), limit);
+        __mmask16 mask = static_cast<__mmask16>(low | high << 8);
+        if (mask != 0) found += avx512_store_lanes(mask, i, out + found);
+    }
+    return found + scalar_words(words, i, count, threshold, out + found);
+}
+
+#endif // SEAT_SEARCH_X86
+
+inline SeatSearchImplementation detect() {
+#ifdef SEAT_SEARCH_X86
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("popcnt")) return SEAT_SEARCH_SCALAR;
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return SEAT_SEARCH_AVX512;
+    if (__builtin_cpu_supports("avx2")) return SEAT_SEARCH_AVX2;
+#endif
+    return SEAT_SEARCH_SCALAR;
+}
+
+} // namespace seat_search_detail
+
+// The fastest implementation this CPU supports.
+inline SeatSearchImplementation seat_search_best_implementation() {
+    static const SeatSearchImplementation best = seat_search_detail::detect();
+    return best;
+}
+
+inline const char* seat_search_implementation_name(SeatSearchImplementation implementation) {
+    switch (implementation) {
+        case SEAT_SEARCH_SCALAR: return "scalar";
+        case SEAT_SEARCH_AVX2: return "avx2";
+        case SEAT_SEARCH_AVX512: return "avx512";
+    }
+    return "?";
+}
+
+// seat_search_u16 with an explicit implementation; for benchmarks and cross-checks. Asking for
+// an implementation the CPU lacks falls back to the scalar loop.
+inline std::size_t seat_search_u16_with(SeatSearchImplementation implementation, const std::uint16_t* seats,
+                                        std::size_t count, int min_seats, std::uint32_t* out) {
+    if (min_seats > 0xFFFF) return 0;
+    if (min_seats < 0) min_seats = 0;
+    std::uint16_t threshold = static_cast<std::uint16_t>(min_seats);
+#ifdef SEAT_SEARCH_X86
+    if (implementation > seat_search_best_implementation()) implementation = SEAT_SEARCH_SCALAR;
+    if (implementation == SEAT_SEARCH_AVX512) return seat_search_detail::avx512_u16(seats, count, threshold, out);
+    if (implementation == SEAT_SEARCH_AVX2) return seat_search_detail::avx2_u16(seats, count, threshold, out);
+#else
+    (void)implementation;
+#endif
+    return seat_search_detail::scalar_u16(seats, 0, count, threshold, out);
+}
+
+inline std::size_t seat_search_words_with(SeatSearchImplementation implementation, const std::uint64_t* words,
+                                          std::size_t count, int min_seats, std::uint32_t* out) {
+    std::int64_t threshold = seat_search_detail::word_threshold(min_seats);
+#ifdef SEAT_SEARCH_X86
+    if (implementation > seat_search_best_implementation()) implementation = SEAT_SEARCH_SCALAR;
+    if (implementation == SEAT_SEARCH_AVX512) return seat_search_detail::avx512_words(words, count, threshold, out);
+    if (implementation == SEAT_SEARCH_AVX2) return seat_search_detail::avx2_words(words, count, threshold, out);
+#else
+    (void)implementation;
+#endif
+    return seat_search_detail::scalar_words(words, 0, count, threshold, out);
+}
+
+inline std::size_t seat_search_u16(const std::uint16_t* seats, std::size_t count, int min_seats, std::uint32_t* out) {
+    return seat_search_u16_with(seat_search_best_implementation(), seats, count, min_seats, out);
+}
+
+inline std::size_t seat_search_words(const std::uint64_t* words, std::size_t count, int min_seats,
+                                     std::uint32_t* out) {
+    return seat_search_words_with(seat_search_best_implementation(), words, count, min_seats, out);
+}
+
+#endif // SEAT_SEARCH_H
@@ -0,0 +1,224 @@
+#ifndef SEAT_STORE_H
+#define SEAT_STORE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "crc32c.h"
+
+// Memory-mapped per-train seat state with crash-consistent checkpoints.
+//
+// File layout (every region page aligned):
+//   [header 0][header 1][live slots][image 0][image 1]
+// The live region is what the engine reads and writes through std::atomic<uint64_t> words;
+// slot (day * num_trains + train) holds that train-day's packed state word.
+// checkpoint() copies the live region into the image the older header describes, checksums
+// and syncs it, and only then publishes that header with a higher sequence number. A crash at
+// any point therefore leaves at least one header whose image matches its CRC.
+// After a clean shutdown the live region itself is synced and flagged, so restart is one mmap
+// plus a header check; after a crash the newest valid image is copied back into the live region.
+class SeatStore {
+public:
+    enum OpenResult {
+        STORE_FAILED,
+        STORE_CREATED,   // New file, every slot set to the initial word
+        STORE_CLEAN,     // Live region reused as is (last run shut down cleanly)
+        STORE_RECOVERED  // Live region restored from the newest valid checkpoint image
+    };
+
+    SeatStore() = default;
+    SeatStore(const SeatStore&) = delete;
+    SeatStore& operator=(const SeatStore&) = delete;
+    ~SeatStore() { close(); }
+
+    OpenResult open(const std::string& path, std::uint32_t trains, std::uint32_t days, std::uint64_t initial_word) {
+        static_assert(sizeof(std::atomic<std::uint64_t>) == sizeof(std::uint64_t) &&
+                      std::atomic<std::uint64_t>::is_always_lock_free,
+                      "live slots are accessed in place as std::atomic<uint64_t>");
+        num_trains = trains;
+        num_days = days;
+        region_bytes = round_to_page(static_cast<std::size_t>(trains) * days * sizeof(std::uint64_t));
+        mapped_bytes = 2 * PAGE + 3 * region_bytes;
+
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) return fail("open", errno);
+        struct stat st;
+        if (::fstat(fd, &st) != 0) return fail_close(fd, "fstat", errno);
+        bool fresh = st.st_size == 0;
+        if (fresh && ::ftruncate(fd, static_cast<off_t>(mapped_bytes)) != 0) return fail_close(fd, "ftruncate", errno);
+        if (!fresh && static_cast<std::size_t>(st.st_size) != mapped_bytes) {
+            ::close(fd);
+            error = "store file has different dimensions";
+            return STORE_FAILED;
+        }
+
+        void* base = ::mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd); // The mapping keeps the file referenced
+        if (base == MAP_FAILED) return fail("mmap", errno);
+        mapping = static_cast<unsigned char*>(base);
+
+        if (fresh) {
+            std::atomic<std::uint64_t>* live = slots();
+            for (std::size_t i = 0; i < num_slots(); i++) live[i].store(initial_word, std::memory_order_relaxed);
+            if (!checkpoint(false)) return STORE_FAILED;
+            return STORE_CREATED;
+        }
+
+        // Newest header that is intact and describes this geometry
+        int newest = -1;
+        for (int i = 0; i < 2; i++) {
+            if (header_valid(i) && (newest < 0 || header(i)->sequence > header(newest)->sequence)) newest = i;
+        }
+        if (newest < 0) {
+            error = "no valid checkpoint header";
+            return STORE_FAILED;
+        }
+
+        if (header(newest)->live_clean) {
+            sequence = header(newest)->sequence;
+            // From now on the live region diverges from the image: clear the flag first.
+            if (!publish_header(newest, *header(newest), false)) return STORE_FAILED;
+            return STORE_CLEAN;
+        }
+
+        // Crash: fall back to the newest image whose checksum still matches
+        for (int attempt = 0; attempt < 2; attempt++) {
+            int candidate = attempt == 0 ? newest : 1 - newest;
+            if (!header_valid(candidate)) continue;
+            if (crc32c(image(candidate), region_bytes) != header(candidate)->image_crc) continue;
+            std::memcpy(static_cast<void*>(slots()), image(candidate), region_bytes);
+            sequence = header(candidate)->sequence;
+            return STORE_RECOVERED;
+        }
+        error = "no checkpoint image passed its checksum";
+        return STORE_FAILED;
+    }
+
+    // Writes a consistent checkpoint of the live region. Writers may keep running: every word is
+    // copied atomically, and per-train versions let journal replay finish the job.
+    // `source` (num_slots() words) replaces the live region as what gets imaged; a journaled
+    // caller passes its durable words so no image ever runs ahead of the journal.
+    // With clean_shutdown the caller guarantees that writers have stopped; the live region is
+    // then synced too and flagged as reusable for the next start.
+    bool checkpoint(bool clean_shutdown, const std::atomic<std::uint64_t>* source = nullptr) {
+        std::lock_guard<std::mutex> lock(checkpoint_mutex);
+        std::uint64_t next_sequence = sequence + 1;
+        int target = static_cast<int>(next_sequence % 2);
+
+        const std::atomic<std::uint64_t>* live = source != nullptr ? source : slots();
+        std::uint64_t* copy = reinterpret_cast<std::uint64_t*>(image(target));
+        for (std::size_t i = 0; i < num_slots(); i++) copy[i] = live[i].load(std::memory_order_relaxed);
+        std::memset(copy + num_slots(), 0, region_bytes - num_slots() * sizeof(std::uint64_t));
+
+        Header next;
+        std::memset(&next, 0, sizeof(next));
+        next.magic = MAGIC;
+        next.format = FORMAT;
+        next.num_trains = num_trains;
+        next.num_days = num_days;
+        next.sequence = next_sequence;
+        next.image_crc = crc32c(copy, region_bytes);
+
+        if (::msync(copy, region_bytes, MS_SYNC) != 0) return fail_bool("msync image", errno);
+        if (clean_shutdown && ::msync(static_cast<void*>(slots()), region_bytes, MS_SYNC) != 0) {
+            return fail_bool("msync live", errno);
+        }
+        if (!publish_header(target, next, clean_shutdown)) return false;
+        sequence = next_sequence;
+        return true;
+    }
+
+    void close() {
+        if (mapping == nullptr) return;
+        ::munmap(mapping, mapped_bytes);
+        mapping = nullptr;
+    }
+
+    std::atomic<std::uint64_t>* slots() {
+        return reinterpret_cast<std::atomic<std::uint64_t>*>(mapping + 2 * PAGE);
+    }
+    std::size_t num_slots() const { return static_cast<std::size_t>(num_trains) * num_days; }
+    std::size_t file_bytes() const { return mapped_bytes; }
+    std::uint64_t checkpoint_sequence() const { return sequence; }
+    const std::string& last_error() const { return error; }
+
+    // Reads the first `count` live words of a store file without opening (and so without
+    // recovering) it: after a kill -9 this is exactly what the dead process had in memory.
+    static bool peek_live(const std::string& path, std::uint64_t* words, std::size_t count) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        std::size_t bytes = count * sizeof(std::uint64_t);
+        ssize_t got = ::pread(fd, words, bytes, static_cast<off_t>(2 * PAGE));
+        ::close(fd);
+        return got == static_cast<ssize_t>(bytes);
+    }
+
+private:
+    static constexpr std::uint64_t MAGIC = 0x45524f5453565352ull; // "RSVSTORE"
+    static constexpr std::uint32_t FORMAT = 1;
+    static constexpr std::size_t PAGE = 4096;
+
+    struct Header {
+        std::uint64_t magic;
+        std::uint32_t format;
+        std::uint32_t num_trains;
+        std::uint32_t num_days;
+        std::uint32_t live_clean;   // 1: live region was synced after this checkpoint and is identical
+        std::uint64_t sequence;     // The valid header with the highest sequence wins
+        std::uint32_t image_crc;    // CRC32C of the matching image region
+        std::uint32_t header_crc;   // CRC32C of every field above
+    };
+
+    static std::size_t round_to_page(std::size_t bytes) { return (bytes + PAGE - 1) / PAGE * PAGE; }
+
+    Header* header(int index) { return reinterpret_cast<Header*>(mapping + index * PAGE); }
+    unsigned char* image(int index) { return mapping + 2 * PAGE + (1 + index) * region_bytes; }
+
+    bool header_valid(int index) {
+        const Header* h = header(index);
+        return h->magic == MAGIC && h->format == FORMAT && h->num_trains == num_trains &&
+               h->num_days == num_days && h->header_crc == crc32c(h, offsetof(Header, header_crc));
+    }
+
+    bool publish_header(int index, Header value, bool clean) {
+        value.live_clean = clean ? 1 : 0;
+        value.header_crc = crc32c(&value, offsetof(Header, header_crc));
+        std::memcpy(header(index), &value, sizeof(value));
+        if (::msync(header(index), PAGE, MS_SYNC) != 0) return fail_bool("msync header", errno);
+        return true;
+    }
+
+    OpenResult fail(const char* what, int err) {
+        error = std::string(what) + ": " + std::strerror(err);
+        return STORE_FAILED;
+    }
+    OpenResult fail_close(int fd, const char* what, int err) {
+        ::close(fd);
+        return fail(what, err);
+    }
+    bool fail_bool(const char* what, int err) {
+        fail(what, err);
+        return false;
+    }
+
+    unsigned char* mapping = nullptr;
+    std::size_t mapped_bytes = 0;
+    std::size_t region_bytes = 0;
+    std::uint32_t num_trains = 0;
+    std::uint32_t num_days = 0;
+    std::uint64_t sequence = 0;
+    std::mutex checkpoint_mutex;
+    std::string error;
+};
+
+#endif // SEAT_STORE_H
@@ -0,0 +1,67 @@
+#ifndef SHARDED_COUNTERS_H
+#define SHARDED_COUNTERS_H
+
+#include <atomic>
+#include <cstddef>
+
+// A small set of counters that many threads bump and a few readers sum.
+//
+//   ShardedCounters<Fields> counters;
+//   counters.add(field, delta);   // writers: a relaxed fetch_add on this thread's shard
+//   counters.sum(field);          // readers: adds up the shards
+//   counters.sum_all(totals);     // ... of every field in one pass
+//
+// Each thread is given a shard, round robin, the first time it adds. Shards sit on cache lines of
+// their own, so writers on different shards never contend or bounce a line between cores, and
+// a reader costs SHARDS loads no matter how many things are being counted. With more than SHARDS
+// threads some share a shard; the fetch_add keeps that correct, only slower.
+//
+// A sum is not a snapshot: it may combine one shard before an update with another after a
+// related one (a booking on one thread and its cancellation on another). Once writers are
+// quiet it is exact. Every field is summed separately, so fields are not consistent with each
+// other either.
+template <int Fields>
+class ShardedCounters {
+public:
+    static constexpr int SHARDS = 64;
+
+    void add(int field, long long delta) { my_shard().values[field].fetch_add(delta, std::memory_order_relaxed); }
+
+    long long sum(int field) const {
+        long long total = 0;
+        for (const Shard& shard : shards) total += shard.values[field].load(std::memory_order_relaxed);
+        return total;
+    }
+
+    // Every field in one pass over the shards.
+    void sum_all(long long* totals) const {
+        for (int field = 0; field < Fields; field++) totals[field] = 0;
+        for (const Shard& shard : shards) {
+            for (int field = 0; field < Fields; field++) totals[field] += shard.values[field].load(std::memory_order_relaxed);
+        }
+    }
+
+    // Sets every field to initial[field]. Not concurrent with add().
+    void reset(const long long* initial) {
+        for (Shard& shard : shards) {
+            for (int field = 0; field < Fields; field++) shard.values[field].store(0, std::memory_order_relaxed);
+        }
+        for (int field = 0; field < Fields; field++) shards[0].values[field].store(initial[field], std::memory_order_relaxed);
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<long long> values[Fields] = {};
+    };
+    static_assert(sizeof(long long) * Fields <= 64, "Keep a shard on one cache line");
+
+    Shard& my_shard() {
+        static std::atomic<unsigned> next_shard{0};
+        thread_local unsigned index = next_shard.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+        return shards[index];
+    }
+
+    Shard shards[SHARDS];
+};
+
+#endif // SHARDED_COUNTERS_H
@@ -0,0 +1,293 @@
+#ifndef SHM_TABLE_H
+#define SHM_TABLE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// pthread mutex usable in place of std::mutex (lock / try_lock / unlock), optionally shared
+// between processes and robust.
+//
+// glibc builds pthread mutexes on futexes. A robust one is also put on the owning thread's
+// robust list, which the kernel walks when the thread dies: the next locker then gets the lock
+// with EOWNERDEAD instead of waiting forever on a dead owner. Everything a train lock protects
+// is either a single atomic word or process-local, so there is never a half-done update to
+// repair; the lock is marked consistent again and the death counted.
+class RobustMutex {
+public:
+    RobustMutex() { init(false); }
+    RobustMutex(const RobustMutex&) = delete;
+    RobustMutex& operator=(const RobustMutex&) = delete;
+    ~RobustMutex() { pthread_mutex_destroy(&mutex); }
+
+    // (Re)initializes in place; process_shared also makes the lock robust. Only while no one
+    // can be using it: at construction, or by the creator of a shared segment.
+    void init(bool process_shared) {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        if (process_shared) {
+            pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+            pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        }
+        pthread_mutex_init(&mutex, &attr);
+        pthread_mutexattr_destroy(&attr);
+        deaths.store(0, std::memory_order_relaxed);
+    }
+
+    void lock() {
+        if (pthread_mutex_lock(&mutex) == EOWNERDEAD) recover();
+    }
+    bool try_lock() {
+        int rc = pthread_mutex_trylock(&mutex);
+        if (rc == EOWNERDEAD) recover();
+        return rc == 0 || rc == EOWNERDEAD;
+    }
+    void unlock() { pthread_mutex_unlock(&mutex); }
+
+    // Times this lock was taken over from an owner that died holding it.
+    std::uint32_t owner_deaths() const { return deaths.load(std::memory_order_relaxed); }
+
+private:
+    void recover() {
+        pthread_mutex_consistent(&mutex);
+        deaths.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    pthread_mutex_t mutex;
+    std::atomic<std::uint32_t> deaths{0}; // Lives next to the lock, so shared with it
+};
+
+// Train table in a POSIX shared-memory object, so several processes book against one inventory.
+//
+// Layout (regions 64-byte aligned):
+//   [header][state words][held seats][booking seats][train locks][admission slots]
+// State words are std::atomic<uint64_t> packed exactly as the engines pack them; the lock-free
+// engines' CAS loops therefore work across processes unchanged. Held seats (one
+// std::atomic<int32_t> per train) are shared too, so no process cancels seats another one holds;
+// the holds themselves stay with the process that placed them, and a process that dies with
+// holds outstanding leaves their seats held. Booking seats (std::atomic<int32_t> per train) are
+// the plain-atomic engine's takes that have not settled yet, shared for the same reason. Train
+// locks are robust process-shared RobustMutexes, lock_stripes of them, striped over the trains
+// exactly as the caller stripes its own.
+//
+// The admission limit (at most admission_slots requests inside at once) is a set of slot locks
+// rather than a counter: being admitted means holding one, so a process that dies mid-request
+// gives its slot back through the robust lock instead of leaking it.
+//
+// The first process creates and initializes the object; later ones wait until it is ready. The
+// last process to close() unlinks it. A process that crashes never detaches, so after a crash
+// the attach count stays above zero for good: no later run sees itself as the last one, and the
+// object (with its seats) persists until it is removed by hand with remove().
+class SharedTrainTable {
+public:
+    enum OpenResult {
+        SHM_FAILED,
+        SHM_CREATED,  // New object, every word set to the initial word
+        SHM_ATTACHED  // Joined a table another process created
+    };
+
+    SharedTrainTable() = default;
+    SharedTrainTable(const SharedTrainTable&) = delete;
+    SharedTrainTable& operator=(const SharedTrainTable&) = delete;
+    ~SharedTrainTable() { detach(); }
+
+    // `name` is a shm_open() name such as "/reservations".
+    OpenResult open(const std::string& name, std::uint32_t trains, std::uint32_t lock_stripes,
+                    std::uint32_t admission_slots, std::uint64_t initial_word) {
+        num_trains = trains;
+        num_locks = lock_stripes;
+        num_slots = admission_slots;
+        shm_name = name;
+        states_offset = round_up(sizeof(Header));
+        held_offset = round_up(states_offset + std::size_t(trains) * sizeof(std::uint64_t));
+        booking_offset = round_up(held_offset + std::size_t(trains) * sizeof(std::int32_t));
+        locks_offset = round_up(booking_offset + std::size_t(trains) * sizeof(std::int32_t));
+        slots_offset = round_up(locks_offset + lock_stripes * sizeof(RobustMutex));
+        mapped_bytes = round_up(slots_offset + admission_slots * sizeof(RobustMutex));
+
+        int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        bool created = fd >= 0;
+        if (!created) {
+            if (errno != EEXIST) return fail("shm_open", errno);
+            fd = ::shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+            if (fd < 0) return fail("shm_open", errno);
+        }
+        if (created && ::ftruncate(fd, static_cast<off_t>(mapped_bytes)) != 0) {
+            int err = errno;
+            ::close(fd);
+            ::shm_unlink(name.c_str());
+            return fail("ftruncate", err);
+        }
+        if (!created && !wait_for_size(fd)) {
+            ::close(fd);
+            error = "shared table has different dimensions";
+            return SHM_FAILED;
+        }
+        void* base = ::mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) return fail("mmap", errno);
+        mapping = static_cast<unsigned char*>(base);
+
+        Header* h = header();
+        if (created) {
+            new (h) Header();
+            std::memcpy(h->magic, MAGIC, sizeof(h->magic));
+            h->num_trains = trains;
+            h->lock_stripes = lock_stripes;
+            h->admission_slots = admission_slots;
+            for (std::uint32_t i = 0; i < trains; i++) {
+                new (&states()[i]) std::atomic<std::uint64_t>(initial_word);
+                new (&held()[i]) std::atomic<std::int32_t>(0);
+                new (&booking()[i]) std::atomic<std::int32_t>(0);
+            }
+            for (std::uint32_t i = 0; i < lock_stripes; i++) {
+                new (&train_locks()[i]) RobustMutex();
+                train_locks()[i].init(true);
+            }
+            for (std::uint32_t i = 0; i < admission_slots; i++) {
+                new (&slots()[i]) RobustMutex();
+                slots()[i].init(true);
+            }
+            h->ready.store(1, std::memory_order_release);
+        } else if (!wait_until_ready()) {
+            ::munmap(mapping, mapped_bytes);
+            mapping = nullptr;
+            return SHM_FAILED;
+        }
+        h->attached.fetch_add(1, std::memory_order_acq_rel);
+        return created ? SHM_CREATED : SHM_ATTACHED;
+    }
+
+    // Detaches; the last process out removes the object.
+    void close() {
+        if (mapping == nullptr) return;
+        bool last = header()->attached.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        if (last) ::shm_unlink(shm_name.c_str());
+        ::munmap(mapping, mapped_bytes);
+        mapping = nullptr;
+    }
+
+    // Drops the mapping without detaching, for forked children that inherited it.
+    void detach() {
+        if (mapping == nullptr) return;
+        ::munmap(mapping, mapped_bytes);
+        mapping = nullptr;
+    }
+
+    static bool remove(const std::string& name) { return ::shm_unlink(name.c_str()) == 0; }
+
+    std::atomic<std::uint64_t>* states() {
+        return reinterpret_cast<std::atomic<std::uint64_t>*>(mapping + states_offset);
+    }
+    std::atomic<std::int32_t>* held() {
+        return reinterpret_cast<std::atomic<std::int32_t>*>(mapping + held_offset);
+    }
+    std::atomic<std::int32_t>* booking() {
+        return reinterpret_cast<std::atomic<std::int32_t>*>(mapping + booking_offset);
+    }
+    RobustMutex* train_locks() { return reinterpret_cast<RobustMutex*>(mapping + locks_offset); }
+
+    // Blocks until this thread is admitted; returns the slot to pass to leave() from the same thread.
+    int admit() {
+        std::uint32_t start = header()->next_slot.fetch_add(1, std::memory_order_relaxed);
+        for (std::uint32_t i = 0; i < num_slots; i++) {
+            std::uint32_t slot = (start + i) % num_slots;
+            if (slots()[slot].try_lock()) return static_cast<int>(slot);
+        }
+        std::uint32_t slot = start % num_slots;
+        slots()[slot].lock();
+        return static_cast<int>(slot);
+    }
+    void leave(int slot) { slots()[slot].unlock(); }
+
+    // Locks (train or admission) taken over from a process that died holding them.
+    long long owner_deaths() {
+        long long total = 0;
+        for (std::uint32_t i = 0; i < num_locks; i++) total += train_locks()[i].owner_deaths();
+        for (std::uint32_t i = 0; i < num_slots; i++) total += slots()[i].owner_deaths();
+        return total;
+    }
+    std::uint32_t attached() { return header()->attached.load(std::memory_order_acquire); }
+    std::size_t bytes() const { return mapped_bytes; }
+    const std::string& last_error() const { return error; }
+
+private:
+    static constexpr char MAGIC[8] = {'R', 'S', 'V', 'S', 'H', 'M', '0', '3'};
+    static constexpr std::size_t ALIGN = 64;
+
+    struct Header {
+        char magic[8];
+        std::uint32_t num_trains;
+        std::uint32_t lock_stripes;
+        std::uint32_t admission_slots;
+        std::atomic<std::uint32_t> ready{0};     // Set by the creator once everything is initialized
+        std::atomic<std::uint32_t> attached{0};  // Processes between open() and close()
+        std::atomic<std::uint32_t> next_slot{0}; // Where the next admit() starts looking
+    };
+
+    Header* header() { return reinterpret_cast<Header*>(mapping); }
+    RobustMutex* slots() { return reinterpret_cast<RobustMutex*>(mapping + slots_offset); }
+
+    static std::size_t round_up(std::size_t bytes) { return (bytes + ALIGN - 1) / ALIGN * ALIGN; }
+
+    // The creator sizes the object right after creating it; give it a moment.
+    bool wait_for_size(int fd) {
+        for (int attempt = 0; attempt < 1000; attempt++) {
+            struct stat st;
+            if (::fstat(fd, &st) != 0) return false;
+            if (static_cast<std::size_t>(st.st_size) == mapped_bytes) return true;
+            if (st.st_size != 0) return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return false;
+    }
+
+    bool wait_until_ready() {
+        Header* h = header();
+        for (int attempt = 0; attempt < 1000; attempt++) {
+            if (h->ready.load(std::memory_order_acquire) == 1) {
+                if (std::memcmp(h->magic, MAGIC, sizeof(h->magic)) == 0 && h->num_trains == num_trains &&
+                    h->lock_stripes == num_locks && h->admission_slots == num_slots) {
+                    return true;
+                }
+                error = "shared table has a different format or dimensions";
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        error = "shared table was never initialized by its creator";
+        return false;
+    }
+
+    OpenResult fail(const char* what, int err) {
+        error = std::string(what) + ": " + std::strerror(err);
+        return SHM_FAILED;
+    }
+
+    unsigned char* mapping = nullptr;
+    std::size_t mapped_bytes = 0;
+    std::size_t states_offset = 0;
+    std::size_t held_offset = 0;
+    std::size_t booking_offset = 0;
+    std::size_t locks_offset = 0;
+    std::size_t slots_offset = 0;
+    std::uint32_t num_trains = 0;
+    std::uint32_t num_locks = 0;
+    std::uint32_t num_slots = 0;
+    std::string shm_name;
+    std::string error;
+};
+
+#endif // SHM_TABLE_H
@@ -0,0 +1,114 @@
+#ifndef SINGLE_FLIGHT_H
+#define SINGLE_FLIGHT_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Coalesces concurrent identical reads: callers asking for the same key while a read of it is
+// still pending share that one read and all receive its result.
+//
+//   SingleFlight<int>::Ticket ticket = flights.join(key);
+//   if (!ticket.leader) return flights.wait(ticket);  // a follower: no gate, no lock, no read
+//   ... get admitted, take the lock ...
+//   flights.seal(ticket);                             // right before reading
+//   int result = read();
+//   flights.publish(ticket, result);                  // wakes every follower
+//
+// A flight is joinable from join() until its leader seals it, and the leader seals right before
+// it reads. Every follower therefore joined before the read happened, so the result it gets
+// was read inside its own call: coalescing never hands out an answer older than the question.
+// Callers arriving after the seal start the next flight. The useful window is the leader's wait
+// for admission and for the lock, which is exactly where a flash sale piles up inquiries.
+//
+// Keys hash to STRIPES stripes, each a mutex and a map of open flights; a flight carries its own
+// condition variable, so publishing wakes only its followers.
+template <typename Result>
+class SingleFlight {
+    struct Flight {
+        std::condition_variable done_cond;
+        bool done = false;
+        int followers = 0;
+        Result result{};
+    };
+
+public:
+    static constexpr std::size_t STRIPES = 64;
+
+    struct Ticket {
+        std::uint64_t key = 0;
+        bool leader = false;
+        std::shared_ptr<Flight> flight;
+    };
+
+    // Joins the open flight for `key`, or opens one and makes the caller its leader.
+    Ticket join(std::uint64_t key) {
+        Stripe& stripe = stripe_of(key);
+        Ticket ticket;
+        ticket.key = key;
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        auto found = stripe.open.find(key);
+        if (found != stripe.open.end()) {
+            ticket.flight = found->second;
+            ticket.flight->followers++;
+        } else {
+            ticket.flight = std::make_shared<Flight>();
+            ticket.leader = true;
+            stripe.open.emplace(key, ticket.flight);
+        }
+        return ticket;
+    }
+
+    // Leader: closes the flight to new followers. Call right before the read.
+    void seal(const Ticket& ticket) {
+        Stripe& stripe = stripe_of(ticket.key);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        close(stripe, ticket);
+    }
+
+    // Leader: hands `result` to every follower. Returns how many there were.
+    int publish(const Ticket& ticket, const Result& result) {
+        Stripe& stripe = stripe_of(ticket.key);
+        int followers;
+        {
+            std::lock_guard<std::mutex> lock(stripe.mutex);
+            close(stripe, ticket); // In case the leader never sealed
+            ticket.flight->result = result;
+            ticket.flight->done = true;
+            followers = ticket.flight->followers;
+        }
+        ticket.flight->done_cond.notify_all();
+        return followers;
+    }
+
+    // Follower: blocks until the leader publishes and returns its result.
+    Result wait(const Ticket& ticket) {
+        Stripe& stripe = stripe_of(ticket.key);
+        std::unique_lock<std::mutex> lock(stripe.mutex);
+        Flight& flight = *ticket.flight;
+        flight.done_cond.wait(lock, [&flight] { return flight.done; });
+        return flight.result;
+    }
+
+private:
+    struct alignas(64) Stripe {
+        std::mutex mutex;
+        std::unordered_map<std::uint64_t, std::shared_ptr<Flight>> open;
+    };
+
+    // Fibonacci hashing: the top 6 bits of key * 2^64 / phi pick one of the 64 stripes
+    static_assert(STRIPES == 64, "stripe_of() takes 6 bits");
+    Stripe& stripe_of(std::uint64_t key) { return stripes[(key * 0x9E3779B97F4A7C15ull) >> 58]; }
+
+    static void close(Stripe& stripe, const Ticket& ticket) {
+        auto found = stripe.open.find(ticket.key);
+        if (found != stripe.open.end() && found->second == ticket.flight) stripe.open.erase(found);
+    }
+
+    Stripe stripes[STRIPES];
+};
+
+#endif // SINGLE_FLIGHT_H
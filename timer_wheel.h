@@ -0,0 +1,185 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical timing wheel (Varghese & Lauck, as used by the classic Linux timer code).
+//
+// Level 0 has 256 one-tick slots, levels 1-3 have 64 slots each covering 2^8, 2^14 and 2^20
+// ticks. A timer is linked into the slot of the coarsest level that still resolves its expiry
+// and is cascaded one level down whenever the finer level wraps. Schedule and cancel are O(1)
+// (intrusive doubly-linked lists over a node pool); advancing costs O(1) per tick plus the
+// timers that actually expire or cascade, never a scan of all outstanding timers.
+//
+// Not thread-safe: the owner serializes access with its own mutex.
+class TimerWheel {
+public:
+    typedef std::uint64_t TimerId;   // (generation << 32) | (node index + 1); 0 is never issued
+    static constexpr TimerId INVALID_TIMER = 0;
+
+    // Largest delay the wheel can represent; longer delays are clamped to it.
+    static constexpr std::uint64_t MAX_DELAY_TICKS = (std::uint64_t(1) << 26) - 1;
+
+    explicit TimerWheel(std::uint64_t start_tick = 0) : current_tick(start_tick) {
+        for (std::size_t i = 0; i < NUM_SLOTS; i++) slot_head[i] = NIL;
+    }
+
+    // Arms a timer firing `delay_ticks` after the current tick (0 = on the next advance).
+    TimerId schedule(std::uint64_t delay_ticks, std::uint64_t payload) {
+        if (delay_ticks > MAX_DELAY_TICKS) delay_ticks = MAX_DELAY_TICKS;
+        std::uint32_t index = allocate_node();
+        Node& node = nodes[index];
+        node.expires = current_tick + delay_ticks;
+        node.payload = payload;
+        link(index);
+        armed_count++;
+        return (std::uint64_t(node.generation) << 32) | (std::uint64_t(index) + 1);
+    }
+
+    // Disarms a pending timer. Returns false if it already fired or was cancelled.
+    bool cancel(TimerId id) {
+        std::uint32_t index = 0;
+        if (!resolve(id, index)) return false;
+        unlink(index);
+        release_node(index);
+        armed_count--;
+        return true;
+    }
+
+    // Fires every timer due at or before `target_tick`, calling on_expire(payload) for each.
+    template <typename OnExpire>
+    void advance(std::uint64_t target_tick, OnExpire&& on_expire) {
+        while (current_tick <= target_tick) {
+            std::uint32_t index = static_cast<std::uint32_t>(current_tick & LEVEL0_MASK);
+            if (index == 0 &&
+                cascade(1, level_index(1)) == 0 &&
+                cascade(2, level_index(2)) == 0) {
+                cascade(3, level_index(3));
+            }
+
+            // Detach the due list first so callbacks may schedule new timers safely.
+            std::uint32_t node_index = slot_head[index];
+            slot_head[index] = NIL;
+            current_tick++;
+
+            while (node_index != NIL) {
+                std::uint32_t next = nodes[node_index].next;
+                std::uint64_t payload = nodes[node_index].payload;
+                release_node(node_index);
+                armed_count--;
+                on_expire(payload);
+                node_index = next;
+            }
+        }
+    }
+
+    std::uint64_t now() const { return current_tick; }
+    std::size_t armed() const { return armed_count; }
+
+private:
+    static constexpr std::uint32_t NIL = 0xFFFFFFFFu;
+    static constexpr unsigned LEVEL0_BITS = 8;
+    static constexpr unsigned LEVELN_BITS = 6;
+    static constexpr std::uint64_t LEVEL0_SIZE = std::uint64_t(1) << LEVEL0_BITS;
+    static constexpr std::uint64_t LEVELN_SIZE = std::uint64_t(1) << LEVELN_BITS;
+    static constexpr std::uint64_t LEVEL0_MASK = LEVEL0_SIZE - 1;
+    static constexpr std::uint64_t LEVELN_MASK = LEVELN_SIZE - 1;
+    static constexpr std::size_t NUM_SLOTS = LEVEL0_SIZE + 3 * LEVELN_SIZE;
+
+    struct Node {
+        std::uint64_t expires;
+        std::uint64_t payload;
+        std::uint32_t prev;
+        std::uint32_t next;      // Doubles as the free-list link while the node is unused
+        std::uint32_t generation;
+        std::uint32_t slot;      // Index into slot_head, or NIL when not armed
+    };
+
+    // Slot of level `level` (1..3) that is due to cascade at the current tick.
+    std::uint32_t level_index(unsigned level) const {
+        unsigned shift = LEVEL0_BITS + (level - 1) * LEVELN_BITS;
+        return static_cast<std::uint32_t>((current_tick >> shift) & LEVELN_MASK);
+    }
+
+    // Re-links every timer of one coarse slot into finer levels. Returns the slot index,
+    // so the caller can stop cascading as soon as a level did not wrap.
+    std::uint32_t cascade(unsigned level, std::uint32_t index) {
+        std::size_t slot = LEVEL0_SIZE + (level - 1) * LEVELN_SIZE + index;
+        std::uint32_t node_index = slot_head[slot];
+        slot_head[slot] = NIL;
+        while (node_index != NIL) {
+            std::uint32_t next = nodes[node_index].next;
+            link(node_index);
+            node_index = next;
+        }
+        return index;
+    }
+
+    void link(std::uint32_t index) {
+        Node& node = nodes[index];
+        std::uint64_t delta = node.expires > current_tick ? node.expires - current_tick : 0;
+        std::size_t slot;
+        if (delta < LEVEL0_SIZE) {
+            // Already-due timers land in the current slot and fire on the next advance.
+            std::uint64_t expires = node.expires > current_tick ? node.expires : current_tick;
+            slot = static_cast<std::size_t>(expires & LEVEL0_MASK);
+        } else if (delta < (std::uint64_t(1) << (LEVEL0_BITS + LEVELN_BITS))) {
+            slot = LEVEL0_SIZE + ((node.expires >> LEVEL0_BITS) & LEVELN_MASK);
+        } else if (delta < (std::uint64_t(1) << (LEVEL0_BITS + 2 * LEVELN_BITS))) {
+            slot = LEVEL0_SIZE + LEVELN_SIZE + ((node.expires >> (LEVEL0_BITS + LEVELN_BITS)) & LEVELN_MASK);
+        } else {
+            slot = LEVEL0_SIZE + 2 * LEVELN_SIZE + ((node.expires >> (LEVEL0_BITS + 2 * LEVELN_BITS)) & LEVELN_MASK);
+        }
+
+        node.slot = static_cast<std::uint32_t>(slot);
+        node.prev = NIL;
+        node.next = slot_head[slot];
+        if (node.next != NIL) nodes[node.next].prev = index;
+        slot_head[slot] = index;
+    }
+
+    void unlink(std::uint32_t index) {
+        Node& node = nodes[index];
+        if (node.prev != NIL) nodes[node.prev].next = node.next;
+        else slot_head[node.slot] = node.next;
+        if (node.next != NIL) nodes[node.next].prev = node.prev;
+    }
+
+    bool resolve(TimerId id, std::uint32_t& index) const {
+        std::uint32_t low = static_cast<std::uint32_t>(id);
+        if (low == 0 || low > nodes.size()) return false;
+        index = low - 1;
+        const Node& node = nodes[index];
+        return node.slot != NIL && node.generation == static_cast<std::uint32_t>(id >> 32);
+    }
+
+    std::uint32_t allocate_node() {
+        std::uint32_t index;
+        if (free_head != NIL) {
+            index = free_head;
+            free_head = nodes[index].next;
+        } else {
+            index = static_cast<std::uint32_t>(nodes.size());
+            nodes.push_back(Node{0, 0, NIL, NIL, 0, NIL});
+        }
+        return index;
+    }
+
+    void release_node(std::uint32_t index) {
+        Node& node = nodes[index];
+        node.slot = NIL;
+        node.generation++;   // Stale TimerIds for this node stop resolving
+        node.next = free_head;
+        free_head = index;
+    }
+
+    std::uint64_t current_tick;   // Next tick to be processed
+    std::uint32_t slot_head[NUM_SLOTS];
+    std::vector<Node> nodes;
+    std::uint32_t free_head = NIL;
+    std::size_t armed_count = 0;
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,153 @@
+#ifndef URING_H
+#define URING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <cerrno>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Minimal io_uring driver on the raw system calls (no liburing): one submission queue, one
+// completion queue, fixed buffers. Enough for a single thread that submits a few linked SQEs
+// and waits for their completions.
+//
+// Ring memory is shared with the kernel: the SQ tail and CQ head are published with release
+// stores, the SQ head and CQ tail read with acquire loads, as in liburing.
+//
+// Not thread-safe: one owner submits and reaps.
+class IoUring {
+public:
+    IoUring() = default;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+    ~IoUring() { close(); }
+
+    // Sets up a ring with `entries` submission slots. Returns false with errno set when
+    // io_uring is unavailable (old kernel, seccomp, io_uring_disabled sysctl).
+    bool init(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) return false;
+        ring_fd = fd;
+
+        sq_ring_bytes = params.sq_off.array + params.sq_entries * sizeof(std::uint32_t);
+        cq_ring_bytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap && cq_ring_bytes > sq_ring_bytes) sq_ring_bytes = cq_ring_bytes;
+
+        sq_ring = map(sq_ring_bytes, IORING_OFF_SQ_RING);
+        if (sq_ring == nullptr) return fail_close();
+        cq_ring = single_mmap ? sq_ring : map(cq_ring_bytes, IORING_OFF_CQ_RING);
+        if (cq_ring == nullptr) return fail_close();
+        sqes = static_cast<io_uring_sqe*>(static_cast<void*>(
+            map(params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES)));
+        if (sqes == nullptr) return fail_close();
+        sqes_bytes = params.sq_entries * sizeof(io_uring_sqe);
+
+        sq_head = field(sq_ring, params.sq_off.head);
+        sq_tail = field(sq_ring, params.sq_off.tail);
+        sq_mask = *field(sq_ring, params.sq_off.ring_mask);
+        sq_array = field(sq_ring, params.sq_off.array);
+        cq_head = field(cq_ring, params.cq_off.head);
+        cq_tail = field(cq_ring, params.cq_off.tail);
+        cq_mask = *field(cq_ring, params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq_ring + params.cq_off.cqes);
+        sq_entries = params.sq_entries;
+        local_tail = *sq_tail;
+        return true;
+    }
+
+    void close() {
+        if (ring_fd < 0) return;
+        if (sqes != nullptr) ::munmap(sqes, sqes_bytes);
+        if (cq_ring != nullptr && cq_ring != sq_ring) ::munmap(cq_ring, cq_ring_bytes);
+        if (sq_ring != nullptr) ::munmap(sq_ring, sq_ring_bytes);
+        ::close(ring_fd);
+        ring_fd = -1;
+        sq_ring = cq_ring = nullptr;
+        sqes = nullptr;
+    }
+
+    // Pins `count` buffers for IORING_OP_READ_FIXED / WRITE_FIXED, indexed in that order.
+    bool register_buffers(const iovec* buffers, unsigned count) {
+        return ::syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+    }
+
+    // Next free submission slot, zeroed, or nullptr when the queue is full.
+    io_uring_sqe* get_sqe() {
+        std::uint32_t head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        if (local_tail - head >= sq_entries) return nullptr;
+        std::uint32_t index = local_tail & sq_mask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array[index] = index;
+        local_tail++;
+        return sqe;
+    }
+
+    // Publishes every SQE taken since the last call and blocks until `wait_for` completions are
+    // available. Returns the number submitted, or -errno.
+    int submit_and_wait(unsigned wait_for) {
+        std::uint32_t to_submit = local_tail - __atomic_load_n(sq_tail, __ATOMIC_RELAXED);
+        __atomic_store_n(sq_tail, local_tail, __ATOMIC_RELEASE);
+        while (true) {
+            long ret = ::syscall(__NR_io_uring_enter, ring_fd, to_submit, wait_for,
+                                 wait_for > 0 ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+            if (ret >= 0) return static_cast<int>(ret);
+            if (errno != EINTR) return -errno;
+            to_submit = 0; // Already consumed by the interrupted call
+        }
+    }
+
+    // Takes the oldest completion, if any.
+    bool pop_cqe(io_uring_cqe& out) {
+        std::uint32_t head = *cq_head;
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) return false;
+        out = cqes[head & cq_mask];
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    bool is_open() const { return ring_fd >= 0; }
+
+private:
+    unsigned char* map(std::size_t bytes, off_t offset) {
+        void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+        return p == MAP_FAILED ? nullptr : static_cast<unsigned char*>(p);
+    }
+    static std::uint32_t* field(unsigned char* ring, std::uint32_t offset) {
+        return reinterpret_cast<std::uint32_t*>(ring + offset);
+    }
+    bool fail_close() {
+        int err = errno;
+        close();
+        errno = err;
+        return false;
+    }
+
+    int ring_fd = -1;
+    unsigned char* sq_ring = nullptr;
+    unsigned char* cq_ring = nullptr;
+    io_uring_sqe* sqes = nullptr;
+    std::size_t sq_ring_bytes = 0;
+    std::size_t cq_ring_bytes = 0;
+    std::size_t sqes_bytes = 0;
+    std::uint32_t* sq_head = nullptr;
+    std::uint32_t* sq_tail = nullptr;
+    std::uint32_t* sq_array = nullptr;
+    std::uint32_t* cq_head = nullptr;
+    std::uint32_t* cq_tail = nullptr;
+    std::uint32_t sq_mask = 0;
+    std::uint32_t cq_mask = 0;
+    std::uint32_t sq_entries = 0;
+    std::uint32_t local_tail = 0;   // SQEs handed out; published to sq_tail on submit
+    io_uring_cqe* cqes = nullptr;
+};
+
+#endif // URING_H
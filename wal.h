@@ -0,0 +1,396 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "uring.h"
+
+// Append-only write-ahead log with group commit.
+//
+// append_in_place() reserves room in the pending buffer, lets the caller build its record right
+// there and returns the record's commit sequence number. A single writer thread swaps the pending
+// buffer out, writes it and makes it durable in one round, then publishes the last sequence
+// number of that batch. Committers wait on wait_durable(seq), so however many threads commit
+// while a flush is in flight, they all share the next one instead of paying for their own.
+// An optional durable hook sees every batch once it is on disk, before its committers wake.
+//
+// A failed write, sync or roll-over is final: a partial write leaves the file's tail misaligned,
+// so the writer appends nothing more, and wait_durable() returns false for every record that
+// was not durable before the failure.
+//
+// The two batch buffers are fixed and page aligned; with IO_URING they are registered with the
+// kernel, so a record goes from the committer's hands to the device without another user-space
+// copy or per-I/O page pinning. Committers block only if a whole buffer fills during one flush.
+//
+// With set_segments() the log rolls over to a new file once the active one is large enough: the
+// full file is renamed to "<path>.<number>" and never written again, so a compactor can fold and
+// delete closed segments while the writer keeps appending to <path>.
+class WalWriter {
+public:
+    enum IoMode {
+        IO_WRITE,   // write() on an O_APPEND descriptor, then fdatasync()
+        IO_PWRITEV, // pwritev() at the tracked end of file, then fdatasync()
+        IO_URING    // Linked WRITE_FIXED + FSYNC(DATASYNC) SQEs, one io_uring_enter per batch
+    };
+
+    static constexpr std::size_t BUFFER_BYTES = std::size_t(1) << 20;
+
+    struct Stats {
+        long long batches = 0;          // write + sync rounds
+        long long records = 0;
+        long long bytes = 0;
+        long long batch_records_max = 0;
+        long long flush_ns_total = 0;   // Writing a batch and making it durable
+        long long flush_ns_max = 0;
+        long long buffer_full_waits = 0; // Appends that waited for the writer to free a buffer
+        long long segments_closed = 0;
+    };
+
+    WalWriter() = default;
+    WalWriter(const WalWriter&) = delete;
+    WalWriter& operator=(const WalWriter&) = delete;
+    ~WalWriter() { close(); }
+
+    // Opens (or creates) `path` for appending and starts the writer thread. IO_URING falls back
+    // to IO_PWRITEV when the kernel refuses io_uring; io_mode() tells which one is in use.
+    bool open(const std::string& path, IoMode requested = IO_WRITE) {
+        mode = requested;
+        active_path = path;
+        open_flags = O_WRONLY | O_CREAT | O_CLOEXEC | (mode == IO_WRITE ? O_APPEND : 0);
+        fd = ::open(path.c_str(), open_flags, 0644);
+        if (fd < 0) return false;
+        off_t end = ::lseek(fd, 0, SEEK_END);
+        if (end < 0) return fail_open();
+        file_offset = end;
+        segment_written = static_cast<std::uint64_t>(end);
+
+        for (int i = 0; i < 2; i++) {
+            buffers[i] = static_cast<char*>(std::aligned_alloc(4096, BUFFER_BYTES));
+            if (buffers[i] == nullptr) return fail_open();
+        }
+        if (mode == IO_URING) {
+            iovec registered[2] = {{buffers[0], BUFFER_BYTES}, {buffers[1], BUFFER_BYTES}};
+            if (!ring.init(4) || !ring.register_buffers(registered, 2)) {
+                fallback_errno = errno;
+                ring.close();
+                mode = IO_PWRITEV;
+            }
+        }
+        pending_index = 0;
+        pending_size = 0;
+        stopping = false;
+        writer = std::thread(&WalWriter::writer_loop, this);
+        return true;
+    }
+
+    // Flushes everything appended so far and stops the writer thread.
+    void close() {
+        if (fd < 0) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_cond.notify_one();
+        writer.join();
+        release();
+    }
+
+    bool is_open() const { return fd >= 0; }
+    IoMode io_mode() const { return mode; }
+    int uring_fallback_errno() const { return fallback_errno; } // Why IO_URING was refused, or 0
+
+    // Called on the writer thread with each batch right after it became durable. Batches
+    // arrive one at a time in file order. Set before open().
+    void set_durable_hook(std::function<void(const char* data, std::size_t size)> hook) {
+        durable_hook = std::move(hook);
+    }
+
+    // Rolls the log over after the first batch that brings the active file to `bytes` or more.
+    // Closed segments are numbered upwards from `first_number`; the caller picks it above every
+    // number already used, including segments a compactor has deleted. Set before open().
+    void set_segments(std::uint64_t bytes, std::uint64_t first_number) {
+        segment_bytes = bytes;
+        next_segment = first_number;
+    }
+
+    // Where segment `number` of the log at `path` lives once closed.
+    static std::string segment_path(const std::string& path, std::uint64_t number) {
+        char suffix[24];
+        std::snprintf(suffix, sizeof(suffix), ".%08llu", static_cast<unsigned long long>(number));
+        return path + suffix;
+    }
+
+    // fsync()s the directory holding `path`, making renames and creations in it durable.
+    static bool sync_directory_of(const std::string& path) {
+        std::string::size_type slash = path.rfind('/');
+        std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+        int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd < 0) return false;
+        bool ok = ::fsync(dir_fd) == 0;
+        ::close(dir_fd);
+        return ok;
+    }
+
+    // Queues one record of `size` bytes (at most BUFFER_BYTES), built by fill(char* dst) directly
+    // in the batch buffer. Returns the sequence number to pass to wait_durable().
+    template <typename Fill>
+    std::uint64_t append_in_place(std::size_t size, Fill&& fill) {
+        std::uint64_t seq;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (pending_size + size > BUFFER_BYTES) {
+                counters.buffer_full_waits++;
+                space_cond.wait(lock, [&] { return pending_size + size <= BUFFER_BYTES; });
+            }
+            fill(buffers[pending_index] + pending_size);
+            pending_size += size;
+            seq = ++appended_seq;
+        }
+        work_cond.notify_one();
+        return seq;
+    }
+
+    // Queues a copy of an already built record.
+    std::uint64_t append(const void* data, std::size_t size) {
+        return append_in_place(size, [&](char* dst) { std::memcpy(dst, data, size); });
+    }
+
+    // Blocks until the record with sequence number `seq` is durable. False if the log failed
+    // first: the record may not be on disk and must not be acknowledged.
+    bool wait_durable(std::uint64_t seq) {
+        std::unique_lock<std::mutex> lock(mutex);
+        durable_cond.wait(lock, [&] { return durable_seq >= seq || failed; });
+        return durable_seq >= seq;
+    }
+
+    bool has_failed() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return failed;
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+
+    static const char* io_mode_name(IoMode m) {
+        switch (m) {
+            case IO_WRITE: return "write";
+            case IO_PWRITEV: return "pwritev";
+            case IO_URING: return "io_uring";
+        }
+        return "?";
+    }
+
+private:
+    void writer_loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            work_cond.wait(lock, [&] { return pending_size > 0 || stopping; });
+            if (pending_size == 0) break; // Stopping and fully drained
+
+            // Take the pending buffer; committers keep appending to the other one, which the
+            // previous round is done with.
+            int index = pending_index;
+            std::size_t size = pending_size;
+            pending_index = 1 - pending_index;
+            pending_size = 0;
+            std::uint64_t batch_last = appended_seq;
+            long long batch_records = static_cast<long long>(batch_last - durable_seq);
+            space_cond.notify_all();
+            if (failed) continue; // Dropped: waiters already see the failure
+            lock.unlock();
+
+            auto flush_start = std::chrono::steady_clock::now();
+            bool ok = flush(index, size);
+            long long flush_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - flush_start).count();
+            if (ok && durable_hook) durable_hook(buffers[index], size);
+            segment_written += size;
+            bool rolled = false;
+            if (ok && segment_bytes > 0 && segment_written >= segment_bytes) {
+                ok = roll_over();
+                rolled = ok;
+            }
+
+            lock.lock();
+            counters.batches++;
+            counters.records += batch_records;
+            counters.bytes += static_cast<long long>(size);
+            if (batch_records > counters.batch_records_max) counters.batch_records_max = batch_records;
+            counters.flush_ns_total += flush_ns;
+            if (flush_ns > counters.flush_ns_max) counters.flush_ns_max = flush_ns;
+            if (rolled) counters.segments_closed++;
+            if (ok) durable_seq = batch_last;
+            else failed = true; // Waiters are released and told the batch is not durable
+            durable_cond.notify_all();
+        }
+    }
+
+    // Writes buffers[index][0, size) at the end of the file and makes it durable.
+    bool flush(int index, std::size_t size) {
+        const char* data = buffers[index];
+        switch (mode) {
+            case IO_WRITE:
+                return write_all(data, size) && ::fdatasync(fd) == 0;
+            case IO_PWRITEV:
+                return pwrite_all(data, size) && ::fdatasync(fd) == 0;
+            case IO_URING:
+                return uring_flush(index, size);
+        }
+        return false;
+    }
+
+    // One submission: the write is linked to the fdatasync, so the kernel starts the sync only
+    // after the write completed in full and cancels it otherwise. Completions are told apart by
+    // their user_data, not by the order they arrive in.
+    static constexpr std::uint64_t URING_WRITE = 1;
+    static constexpr std::uint64_t URING_SYNC = 2;
+
+    bool uring_flush(int index, std::size_t size) {
+        io_uring_sqe* write_sqe = ring.get_sqe();
+        io_uring_sqe* sync_sqe = ring.get_sqe();
+        if (write_sqe == nullptr || sync_sqe == nullptr) return false;
+        write_sqe->opcode = IORING_OP_WRITE_FIXED;
+        write_sqe->fd = fd;
+        write_sqe->addr = reinterpret_cast<std::uint64_t>(buffers[index]);
+        write_sqe->len = static_cast<std::uint32_t>(size);
+        write_sqe->off = static_cast<std::uint64_t>(file_offset);
+        write_sqe->buf_index = static_cast<std::uint16_t>(index);
+        write_sqe->flags = IOSQE_IO_LINK;
+        write_sqe->user_data = URING_WRITE;
+        sync_sqe->opcode = IORING_OP_FSYNC;
+        sync_sqe->fd = fd;
+        sync_sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        sync_sqe->user_data = URING_SYNC;
+        if (ring.submit_and_wait(2) < 0) return false;
+
+        long long written = -1;
+        int sync_result = -1;
+        for (int reaped = 0; reaped < 2;) {
+            io_uring_cqe cqe;
+            if (!ring.pop_cqe(cqe)) {
+                if (ring.submit_and_wait(1) < 0) return false;
+                continue;
+            }
+            if (cqe.user_data == URING_WRITE) written = cqe.res;
+            else if (cqe.user_data == URING_SYNC) sync_result = cqe.res; // -ECANCELED after a short write
+            else return false; // Nothing else is ever submitted
+            reaped++;
+        }
+        if (written == static_cast<long long>(size) && sync_result == 0) {
+            file_offset += static_cast<off_t>(size);
+            return true;
+        }
+        // Short write (the linked sync was cancelled): finish the batch synchronously
+        if (written < 0) return false;
+        file_offset += static_cast<off_t>(written);
+        return pwrite_all(buffers[index] + written, size - static_cast<std::size_t>(written)) &&
+               ::fdatasync(fd) == 0;
+    }
+
+    // Writer thread, between batches: everything in the active file is durable. The rename and
+    // the new file's creation are synced through the directory before any record goes to it.
+    bool roll_over() {
+        std::string closed = segment_path(active_path, next_segment);
+        if (::rename(active_path.c_str(), closed.c_str()) != 0) return false;
+        int new_fd = ::open(active_path.c_str(), open_flags, 0644);
+        if (new_fd < 0) return false;
+        bool synced = sync_directory_of(active_path);
+        ::close(fd);
+        fd = new_fd;
+        file_offset = 0;
+        segment_written = 0;
+        next_segment++;
+        return synced;
+    }
+
+    bool write_all(const char* data, std::size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+        return true;
+    }
+
+    bool pwrite_all(const char* data, std::size_t size) {
+        while (size > 0) {
+            iovec iov = {const_cast<char*>(data), size};
+            ssize_t written = ::pwritev(fd, &iov, 1, file_offset);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+            file_offset += written;
+        }
+        return true;
+    }
+
+    bool fail_open() {
+        int err = errno;
+        release();
+        errno = err;
+        return false;
+    }
+
+    void release() {
+        ring.close();
+        for (char*& buffer : buffers) {
+            std::free(buffer);
+            buffer = nullptr;
+        }
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+
+    int fd = -1;
+    IoMode mode = IO_WRITE;
+    int fallback_errno = 0;
+    off_t file_offset = 0;     // End of file; writer thread only (IO_PWRITEV, IO_URING)
+    std::string active_path;
+    int open_flags = 0;
+    std::uint64_t segment_bytes = 0;   // 0: never roll over
+    std::uint64_t next_segment = 1;    // Writer thread only, like segment_written
+    std::uint64_t segment_written = 0; // Bytes in the active file
+    IoUring ring;
+    char* buffers[2] = {nullptr, nullptr};
+    std::thread writer;
+    std::function<void(const char*, std::size_t)> durable_hook;
+
+    mutable std::mutex mutex; // Protects everything below
+    std::condition_variable work_cond;    // Writer: records pending or stopping
+    std::condition_variable durable_cond; // Committers: durable_seq advanced
+    std::condition_variable space_cond;   // Committers: the writer swapped buffers
+    int pending_index = 0;                // Buffer committers append to
+    std::size_t pending_size = 0;
+    std::uint64_t appended_seq = 0;
+    std::uint64_t durable_seq = 0;
+    bool stopping = false;
+    bool failed = false;
+    Stats counters;
+};
+
+#endif // WAL_H